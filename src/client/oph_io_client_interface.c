@@ -23,11 +23,38 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <endian.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/shm.h>
+#include <poll.h>
 
 #include "oph_network.h"
 
 //TODO poll the tcp socket to discover if the connection was lost
 
+//Idle connections kept for reuse
+typedef struct _oph_io_client_pool_entry {
+	oph_io_client_connection *connection;
+	struct _oph_io_client_pool_entry *next;
+} oph_io_client_pool_entry;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static oph_io_client_pool_entry *pool = NULL;
+static unsigned int pool_size = 0;
+
+static void _oph_io_client_detach_ring(oph_io_client_connection * connection)
+{
+	if (!connection->ring)
+		return;
+	if (shmdt(connection->ring))
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to detach shared memory ring\n");
+	connection->ring = NULL;
+	connection->ring_size = 0;
+}
+
 int _oph_io_client_ping_connection(oph_io_client_connection * connection)
 {
 	if (!connection) {
@@ -94,6 +121,7 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while closing connection!\n");
 					return OPH_IO_CLIENT_INTERFACE_IO_ERR;
 				}
+				_oph_io_client_detach_ring(*connection);
 				free(*connection);
 			}
 		} else
@@ -102,7 +130,8 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connecting to %s:%s...\n", hostname, port);
 
-	if (oph_net_connect(hostname, port, &fd) != 0) {
+	//Servers on the same node can be reached through their Unix domain socket
+	if ((hostname[0] == '/' ? oph_net_connect_unix(hostname, &fd) : oph_net_connect(hostname, port, &fd)) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Connection error\n");
 		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
 	}
@@ -118,7 +147,15 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 	(*connection)->port[OPH_IO_CLIENT_PORT_LEN - 1] = 0;
 	(*connection)->host[OPH_IO_CLIENT_HOST_LEN - 1] = 0;
 	(*connection)->db_name[0] = 0;
+	(*connection)->device[0] = 0;
 	(*connection)->socket = fd;
+	(*connection)->protocol = 0;
+	(*connection)->next_tag = 0;
+	(*connection)->pending = 0;
+	(*connection)->reply_len = 0;
+	(*connection)->shm_id = -1;
+	(*connection)->ring = NULL;
+	(*connection)->ring_size = 0;
 
 	//Set default db
 	if (db_name) {
@@ -126,8 +163,6 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "Connection error\n");
 			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
 		}
-		strncpy((*connection)->db_name, db_name, OPH_IO_CLIENT_DB_LEN);
-		(*connection)->db_name[OPH_IO_CLIENT_DB_LEN - 1] = 0;
 	}
 
 	return OPH_IO_CLIENT_INTERFACE_OK;
@@ -151,6 +186,11 @@ int oph_io_client_use_db(const char *db_name, const char *device, oph_io_client_
 		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
 		return OPH_IO_CLIENT_INTERFACE_OK;
 	}
+	//The reply would be read in place of the pending ones
+	if (connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Pipelined queries are waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
 
 	//set default db
 	char *request = NULL;
@@ -174,6 +214,10 @@ int oph_io_client_use_db(const char *db_name, const char *device, oph_io_client_
 	m += sizeof(unsigned long long);
 	m += snprintf(request + m, strlen(device) + 1, "%s", device);
 
+	//The default database is unknown until the server confirms the new one
+	connection->db_name[0] = 0;
+	connection->device[0] = 0;
+
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
 	if (write(connection->socket, (void *) request, m) != m) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
@@ -200,6 +244,92 @@ int oph_io_client_use_db(const char *db_name, const char *device, oph_io_client_
 	}
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Default database %s on device %s set correctly\n", db_name, device);
 
+	//Keep the pool key in sync with the default database of the connection
+	strncpy(connection->db_name, db_name, OPH_IO_CLIENT_DB_LEN);
+	connection->db_name[OPH_IO_CLIENT_DB_LEN - 1] = 0;
+	strncpy(connection->device, device, OPH_IO_CLIENT_DEVICE_LEN);
+	connection->device[OPH_IO_CLIENT_DEVICE_LEN - 1] = 0;
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_set_protocol(unsigned int protocol, oph_io_client_connection * connection)
+{
+	if (!connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_OK;
+	}
+	//The reply would be read in place of the pending ones
+	if (connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Pipelined queries are waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//Build request packet TYPE|OPTIONS
+	char request[OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN];
+	unsigned int m = OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN;
+	memcpy(request, OPH_IO_CLIENT_MSG_PROTOCOL, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	//Result frames are used whenever the server supports them
+	unsigned int options = protocol | OPH_IO_CLIENT_PROTOCOL_RESULT_FRAMES;
+	memcpy(request + OPH_IO_CLIENT_MSG_TYPE_LEN, (void *) &options, OPH_IO_CLIENT_MSG_SHORT_LEN);
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
+	if (write(connection->socket, (void *) request, m) != m) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
+	//Decode response TYPE|ACCEPTED_OPTIONS
+	char reply[OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN + 1];
+	if (oph_net_readn(connection->socket, reply, OPH_IO_CLIENT_MSG_TYPE_LEN) != OPH_IO_CLIENT_MSG_TYPE_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	reply[OPH_IO_CLIENT_MSG_TYPE_LEN] = 0;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response received: %s\n", reply);
+
+	//Older servers do not know the message and reply with an error
+	if (STRCMP(OPH_IO_CLIENT_MSG_PROTOCOL, reply) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error setting protocol options\n");
+		connection->protocol = 0;
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+	if (oph_net_readn(connection->socket, reply, OPH_IO_CLIENT_MSG_SHORT_LEN) != OPH_IO_CLIENT_MSG_SHORT_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	memcpy(&(connection->protocol), reply, sizeof(unsigned int));
+
+	//The ring is described by SHM_ID|RING_SIZE and it is attached only once per connection
+	if (connection->protocol & OPH_IO_CLIENT_PROTOCOL_SHARED_MEMORY) {
+		char ring_info[OPH_IO_CLIENT_MSG_SHORT_LEN + OPH_IO_CLIENT_MSG_LONG_LEN];
+		int shm_id = 0;
+		if (oph_net_readn(connection->socket, ring_info, sizeof(ring_info)) != (ssize_t) sizeof(ring_info)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&shm_id, ring_info, OPH_IO_CLIENT_MSG_SHORT_LEN);
+		if (!connection->ring || connection->shm_id != shm_id) {
+			_oph_io_client_detach_ring(connection);
+			char *ring = (char *) shmat(shm_id, NULL, 0);
+			if (ring == (char *) -1) {
+				//Result frames will be sent through the socket
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to attach shared memory ring: %d\n", errno);
+				return oph_io_client_set_protocol(protocol & ~OPH_IO_CLIENT_PROTOCOL_SHARED_MEMORY, connection);
+			}
+			connection->ring = ring;
+			connection->shm_id = shm_id;
+			memcpy(&(connection->ring_size), ring_info + OPH_IO_CLIENT_MSG_SHORT_LEN, OPH_IO_CLIENT_MSG_LONG_LEN);
+		}
+	} else
+		_oph_io_client_detach_ring(connection);
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Protocol options set to %u\n", connection->protocol);
+
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
@@ -317,34 +447,13 @@ int oph_io_client_setup_query(oph_io_client_connection * connection, const char
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
-int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_client_query * query)
+//Fill the request buffer for the current run of the query
+static int _oph_io_client_build_query(oph_io_client_query * query, unsigned int *length)
 {
-
-	if (!connection || !query || !query->query) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
-		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
-	}
-
-	if (connection->socket) {
-		//Check connection state
-/*    if(_oph_io_client_ping_connection(connection)){
-      pmesg(LOG_DEBUG,__FILE__,__LINE__,"Connection was closed\n");
-      return OPH_IO_CLIENT_INTERFACE_DATA_ERR;    
-    }*/
-	} else {
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
-		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
-	}
-
 	unsigned int n = 0, m = 0;
-	int res = 0;
 
 	if (!query->args) {
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", query->fixed_length);
-		if (write(connection->socket, (void *) query->query, query->fixed_length) != query->fixed_length) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
-			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
-		}
+		*length = query->fixed_length;
 	} else {
 		//Re-calculate variable part length
 		unsigned long long arg_len = query->args_count * (strlen(OPH_IO_CLIENT_MSG_ARG_DATA_LONG) + 1 + sizeof(unsigned long long));
@@ -402,15 +511,17 @@ int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_cl
 			memcpy(query->query + m, (void *) (query->args[n]->arg), query->args[n]->arg_length);
 			m += query->args[n]->arg_length;
 		}
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
-		if (write(connection->socket, (void *) query->query, m) != m) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
-			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
-		}
-
-		query->curr_run++;
+		*length = m;
 	}
 
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+//Decode the reply to a query
+static int _oph_io_client_read_query_reply(oph_io_client_connection * connection)
+{
+	int res = 0;
+
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
 
 	//Decode response
@@ -432,6 +543,322 @@ int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_cl
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
+int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_client_query * query)
+{
+
+	if (!connection || !query || !query->query) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (connection->socket) {
+		//Check connection state
+/*    if(_oph_io_client_ping_connection(connection)){
+      pmesg(LOG_DEBUG,__FILE__,__LINE__,"Connection was closed\n");
+      return OPH_IO_CLIENT_INTERFACE_DATA_ERR;    
+    }*/
+	} else {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//The reply would be read in place of the pending ones
+	if (connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Pipelined queries are waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	unsigned int m = 0;
+	int res = 0;
+
+	if ((res = _oph_io_client_build_query(query, &m)))
+		return res;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
+	if (write(connection->socket, (void *) query->query, m) != m) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+	}
+	if (query->args)
+		query->curr_run++;
+
+	return _oph_io_client_read_query_reply(connection);
+}
+
+int oph_io_client_submit_query(oph_io_client_connection * connection, oph_io_client_query * query, unsigned int *tag)
+{
+	if (!connection || !query || !query->query) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//Replies not collected would fill socket buffers and block both sides
+	if (connection->pending >= OPH_IO_CLIENT_MAX_PENDING) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Too many requests waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	unsigned int m = 0;
+	int res = 0;
+
+	if ((res = _oph_io_client_build_query(query, &m)))
+		return res;
+
+	//Build request packet TAG|ID followed by the query in a single write
+	char request[OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN];
+	memcpy(request, OPH_IO_CLIENT_MSG_TAG, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	memcpy(request + OPH_IO_CLIENT_MSG_TYPE_LEN, (void *) &(connection->next_tag), OPH_IO_CLIENT_MSG_SHORT_LEN);
+	struct iovec iov[2];
+	iov[0].iov_base = request;
+	iov[0].iov_len = sizeof(request);
+	iov[1].iov_base = query->query;
+	iov[1].iov_len = m;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes with tag %u\n", m, connection->next_tag);
+	if (oph_net_writev(connection->socket, iov, 2, 0, NULL) != (ssize_t) (sizeof(request) + m)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+	}
+	if (query->args)
+		query->curr_run++;
+
+	if (tag)
+		*tag = connection->next_tag;
+	connection->next_tag++;
+	connection->pending++;
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_fd(oph_io_client_connection * connection)
+{
+	if (!connection || !connection->socket)
+		return -1;
+	return connection->socket;
+}
+
+int oph_io_client_poll_query(oph_io_client_connection * connection, int *ready)
+{
+	if (!connection || !ready) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	*ready = 0;
+	if (!connection->socket || !connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No request is waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//Gather the reply TAG|ID|TYPE without blocking
+	ssize_t res = 0;
+	while (connection->reply_len < OPH_IO_CLIENT_TAGGED_REPLY_LEN) {
+		res = recv(connection->socket, connection->reply + connection->reply_len, OPH_IO_CLIENT_TAGGED_REPLY_LEN - connection->reply_len, MSG_DONTWAIT);
+		if (res > 0)
+			connection->reply_len += res;
+		else if (!res) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Connection was closed by the server\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return OPH_IO_CLIENT_INTERFACE_OK;
+		else if (errno != EINTR) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while reading from socket\n");
+			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+		}
+	}
+	*ready = 1;
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_complete_query(oph_io_client_connection * connection, unsigned int *tag)
+{
+	if (!connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket || !connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No request is waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//Decode response TAG|ID|TYPE, part of which could have been already read by oph_io_client_poll_query
+	unsigned int missing = OPH_IO_CLIENT_TAGGED_REPLY_LEN - connection->reply_len;
+	if (missing) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
+		if (oph_net_readn(connection->socket, connection->reply + connection->reply_len, missing) != missing) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+	}
+	connection->reply_len = 0;
+	connection->pending--;
+
+	if (strncmp(OPH_IO_CLIENT_MSG_TAG, connection->reply, OPH_IO_CLIENT_MSG_TYPE_LEN) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Tag of the reply not found\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+	unsigned int id = 0;
+	memcpy(&id, connection->reply + OPH_IO_CLIENT_MSG_TYPE_LEN, sizeof(unsigned int));
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Reply received for tag %u\n", id);
+	if (tag)
+		*tag = id;
+
+	if (strncmp(OPH_IO_CLIENT_MSG_EXEC_QUERY, connection->reply + OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN, OPH_IO_CLIENT_MSG_TYPE_LEN) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error executing query\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query executed correctly\n");
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_wait_query(oph_io_client_connection * connection, unsigned int *tag)
+{
+	if (!connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket || !connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No request is waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	int ready = 0, res = 0;
+	struct pollfd pfd;
+	pfd.fd = connection->socket;
+	pfd.events = POLLIN;
+	for (;;) {
+		if ((res = oph_io_client_poll_query(connection, &ready)))
+			return res;
+		if (ready)
+			break;
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while polling socket\n");
+			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+		}
+	}
+
+	return oph_io_client_complete_query(connection, tag);
+}
+
+int oph_io_client_bulk_insert(oph_io_client_connection * connection, const char *frag_name, unsigned long long num_rows, unsigned int num_fields, const oph_io_client_column * column,
+			      char final_stmt)
+{
+	if (!connection || !frag_name || !num_fields || !column) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//The reply would be read in place of the pending ones
+	if (connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Pipelined queries are waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	unsigned long long i, frag_len = strlen(frag_name);
+	unsigned int n, final_flag = final_stmt ? 1 : 0;
+	int iovcnt = 0, k;
+
+	//Build request packet TYPE|NUM_ROWS|NUM_FIELDS|FINAL|FRAG_LEN|FRAG followed by TYPE|DATA_LEN|CELL_LENGTHS|DATA for each column
+	char request[OPH_IO_CLIENT_MSG_TYPE_LEN + 2 * OPH_IO_CLIENT_MSG_LONG_LEN + 2 * OPH_IO_CLIENT_MSG_SHORT_LEN];
+	char *column_header = (char *) malloc(num_fields * (1 + OPH_IO_CLIENT_MSG_LONG_LEN));
+	struct iovec *iov = (struct iovec *) malloc((2 + 3 * num_fields) * sizeof(struct iovec));
+	if (!column_header || !iov) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
+		free(column_header);
+		free(iov);
+		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+	}
+
+	memcpy(request, OPH_IO_CLIENT_MSG_BULK_INSERT, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	memcpy(request + OPH_IO_CLIENT_MSG_TYPE_LEN, (void *) &num_rows, OPH_IO_CLIENT_MSG_LONG_LEN);
+	memcpy(request + OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_LONG_LEN, (void *) &num_fields, OPH_IO_CLIENT_MSG_SHORT_LEN);
+	memcpy(request + OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_LONG_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN, (void *) &final_flag, OPH_IO_CLIENT_MSG_SHORT_LEN);
+	memcpy(request + OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_LONG_LEN + 2 * OPH_IO_CLIENT_MSG_SHORT_LEN, (void *) &frag_len, OPH_IO_CLIENT_MSG_LONG_LEN);
+	iov[iovcnt].iov_base = request;
+	iov[iovcnt++].iov_len = sizeof(request);
+	iov[iovcnt].iov_base = (void *) frag_name;
+	iov[iovcnt++].iov_len = frag_len;
+
+	unsigned long long data_len, m = sizeof(request) + frag_len;
+	for (n = 0; n < num_fields; n++) {
+		if (column[n].type == OPH_IO_CLIENT_FIELD_STRING) {
+			if (num_rows && (!column[n].length || !column[n].data))
+				break;
+			for (i = data_len = 0; i < num_rows; i++)
+				data_len += column[n].length[i];
+		} else if (column[n].type == OPH_IO_CLIENT_FIELD_LONG || column[n].type == OPH_IO_CLIENT_FIELD_REAL) {
+			if (num_rows && !column[n].data)
+				break;
+			data_len = num_rows * OPH_IO_CLIENT_MSG_LONG_LEN;
+		} else
+			break;
+
+		column_header[n * (1 + OPH_IO_CLIENT_MSG_LONG_LEN)] = column[n].type;
+		memcpy(column_header + n * (1 + OPH_IO_CLIENT_MSG_LONG_LEN) + 1, (void *) &data_len, OPH_IO_CLIENT_MSG_LONG_LEN);
+		iov[iovcnt].iov_base = column_header + n * (1 + OPH_IO_CLIENT_MSG_LONG_LEN);
+		iov[iovcnt++].iov_len = 1 + OPH_IO_CLIENT_MSG_LONG_LEN;
+		if (column[n].type == OPH_IO_CLIENT_FIELD_STRING && num_rows) {
+			iov[iovcnt].iov_base = (void *) column[n].length;
+			iov[iovcnt++].iov_len = num_rows * OPH_IO_CLIENT_MSG_LONG_LEN;
+			m += num_rows * OPH_IO_CLIENT_MSG_LONG_LEN;
+		}
+		if (data_len) {
+			iov[iovcnt].iov_base = (void *) column[n].data;
+			iov[iovcnt++].iov_len = data_len;
+		}
+		m += 1 + OPH_IO_CLIENT_MSG_LONG_LEN + data_len;
+	}
+	if (n < num_fields) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Column %u is not valid\n", n);
+		free(column_header);
+		free(iov);
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %llu bytes\n", m);
+	//Columns are sent from the memory of the caller, at most OPH_IO_CLIENT_BULK_IOV buffers at a time
+	for (k = 0; k < iovcnt; k += OPH_IO_CLIENT_BULK_IOV) {
+		n = iovcnt - k < OPH_IO_CLIENT_BULK_IOV ? iovcnt - k : OPH_IO_CLIENT_BULK_IOV;
+		for (i = data_len = 0; i < n; i++)
+			data_len += iov[k + i].iov_len;
+		if (oph_net_writev(connection->socket, iov + k, n, 0, NULL) != (ssize_t) data_len)
+			break;
+	}
+	free(column_header);
+	free(iov);
+	if (k < iovcnt) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
+	//Decode response
+	char reply[OPH_IO_CLIENT_MSG_TYPE_LEN + 1];
+	if (oph_net_readn(connection->socket, reply, OPH_IO_CLIENT_MSG_TYPE_LEN) != OPH_IO_CLIENT_MSG_TYPE_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	reply[OPH_IO_CLIENT_MSG_TYPE_LEN] = 0;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response received: %s\n", reply);
+
+	if (STRCMP(OPH_IO_CLIENT_MSG_BULK_INSERT, reply) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error executing bulk insert\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Bulk insert executed correctly\n");
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
 int oph_io_client_free_query(oph_io_client_query * query)
 {
 	if (!query) {
@@ -446,30 +873,90 @@ int oph_io_client_free_query(oph_io_client_query * query)
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
-int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_client_result ** result_set)
+//Reader of the frames FRAME_LEN|DATA (or FRAME_LEN|RING_POS with the shared memory ring) used to stream result sets.
+//The payload of a legacy RS reply is read as a single frame, which is not followed by an empty one
+typedef struct {
+	int socket;
+	unsigned long long left;
+	char *ring;
+	unsigned long long ring_size;
+	const char *frame;
+	unsigned long long end;
+	char single;
+} _oph_io_client_frame_reader;
+
+static void _oph_io_client_init_reader(_oph_io_client_frame_reader * reader, oph_io_client_connection * connection, char single, unsigned long long payload_len)
 {
-	if (!result_set || !connection) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
-		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
-	}
+	reader->socket = connection->socket;
+	reader->left = single ? payload_len : 0;
+	reader->ring = !single && (connection->protocol & OPH_IO_CLIENT_PROTOCOL_SHARED_MEMORY) ? connection->ring : NULL;
+	reader->ring_size = connection->ring_size;
+	reader->frame = NULL;
+	reader->end = 0;
+	reader->single = single;
+}
 
-	if (connection->socket) {
-		//Check connection state
-/*    if(_oph_io_client_ping_connection(connection)){
-      pmesg(LOG_DEBUG,__FILE__,__LINE__,"Connection was closed\n");
-      return OPH_IO_CLIENT_INTERFACE_OK;    
-    }*/
-	} else {
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
-		return OPH_IO_CLIENT_INTERFACE_OK;
+//Check that the whole result set has been consumed (frames are closed by an empty frame)
+static int _oph_io_client_end_frames(_oph_io_client_frame_reader * reader)
+{
+	unsigned long long length = 0;
+
+	if (reader->left)
+		return -1;
+	if (!reader->single && (oph_net_readn(reader->socket, &length, OPH_IO_CLIENT_MSG_LONG_LEN) != OPH_IO_CLIENT_MSG_LONG_LEN || length))
+		return -1;
+
+	return 0;
+}
+
+static int _oph_io_client_read_frames(_oph_io_client_frame_reader * reader, void *buffer, unsigned long long length)
+{
+	char *ptr = (char *) buffer;
+	unsigned long long chunk = 0, pos = 0;
+
+	while (length) {
+		if (!reader->left) {
+			if (reader->single || oph_net_readn(reader->socket, &reader->left, OPH_IO_CLIENT_MSG_LONG_LEN) != OPH_IO_CLIENT_MSG_LONG_LEN)
+				return -1;
+			//An empty frame before the end of data means a truncated result set
+			if (!reader->left)
+				return -1;
+			if (reader->ring) {
+				if (oph_net_readn(reader->socket, &pos, OPH_IO_CLIENT_MSG_LONG_LEN) != OPH_IO_CLIENT_MSG_LONG_LEN || pos % reader->ring_size + reader->left > reader->ring_size)
+					return -1;
+				__atomic_thread_fence(__ATOMIC_ACQUIRE);
+				reader->frame = reader->ring + OPH_IO_CLIENT_RING_HEADER_LEN + pos % reader->ring_size;
+				reader->end = pos + reader->left;
+			}
+		}
+		chunk = reader->left < length ? reader->left : length;
+		if (reader->ring) {
+			memcpy(ptr, reader->frame, chunk);
+			reader->frame += chunk;
+		} else if (oph_net_readn(reader->socket, ptr, chunk) != (ssize_t) chunk)
+			return -1;
+		reader->left -= chunk;
+		//The area of a consumed frame is given back to the server
+		if (reader->ring && !reader->left)
+			__atomic_store_n((unsigned long long *) reader->ring, reader->end, __ATOMIC_RELEASE);
+		ptr += chunk;
+		length -= chunk;
 	}
 
-	char request[strlen(OPH_IO_CLIENT_MSG_RESULT) + 1];
+	return 0;
+}
+
+//Ask for the last result set (streamed in frames only if the server accepted them) and read the header of the reply
+static int _oph_io_client_request_result(oph_io_client_connection * connection, unsigned long long *rows, unsigned int *fields, _oph_io_client_frame_reader * reader)
+{
+	char frames = (connection->protocol & OPH_IO_CLIENT_PROTOCOL_RESULT_FRAMES) ? 1 : 0;
+	const char *type = frames ? OPH_IO_CLIENT_MSG_RESULT_FRAMES : OPH_IO_CLIENT_MSG_RESULT;
+	char request[OPH_IO_CLIENT_MSG_TYPE_LEN + 1];
 	unsigned int m = 0;
 	int res = 0;
 
 	//Build request packet TYPE
-	m = snprintf(request, strlen(OPH_IO_CLIENT_MSG_RESULT) + 1, OPH_IO_CLIENT_MSG_RESULT);
+	m = snprintf(request, OPH_IO_CLIENT_MSG_TYPE_LEN + 1, "%s", type);
 
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
 	if (write(connection->socket, (void *) request, m) != m) {
@@ -480,35 +967,37 @@ int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_clien
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
 	//transfer result + build structure
 
-	char reply_type[strlen(OPH_IO_CLIENT_MSG_RESULT) + 1];
-	res = oph_net_readn(connection->socket, reply_type, strlen(OPH_IO_CLIENT_MSG_RESULT));
+	char reply_type[OPH_IO_CLIENT_MSG_TYPE_LEN + 1];
+	res = oph_net_readn(connection->socket, reply_type, OPH_IO_CLIENT_MSG_TYPE_LEN);
 	if (!res) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
 		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 	}
-	reply_type[strlen(OPH_IO_CLIENT_MSG_RESULT)] = 0;
+	reply_type[OPH_IO_CLIENT_MSG_TYPE_LEN] = 0;
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response received: %s\n", reply_type);
 
-	if (STRCMP(OPH_IO_CLIENT_MSG_RESULT, reply_type) != 0) {
+	if (STRCMP(type, reply_type) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error transfering result\n");
 		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
 	}
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Transfer executed\n");
 
-	//Read payload len
 	char reply_info[sizeof(unsigned long long)] = { 0 };
 	unsigned long long payload_len = 0;
-	res = oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN);
-	if (!res) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
-		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	//Legacy replies carry the length of the whole payload
+	if (!frames) {
+		res = oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN);
+		if (res != OPH_IO_CLIENT_MSG_LONG_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&payload_len, reply_info, sizeof(unsigned long long));
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response length: %llu\n", payload_len);
 	}
-	memcpy(&payload_len, reply_info, sizeof(unsigned long long));
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response length: %llu\n", payload_len);
 
 	unsigned long long num_rows = 0;
 	res = oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN);
-	if (!res) {
+	if (res != OPH_IO_CLIENT_MSG_LONG_LEN) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
 		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 	}
@@ -517,13 +1006,51 @@ int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_clien
 
 	unsigned int num_fields = 0;
 	res = oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_SHORT_LEN);
-	if (!res) {
+	if (res != OPH_IO_CLIENT_MSG_SHORT_LEN) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
 		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 	}
 	memcpy(&num_fields, reply_info, sizeof(unsigned int));
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Number of fields: %u\n", num_fields);
 
+	*rows = num_rows;
+	*fields = num_fields;
+	_oph_io_client_init_reader(reader, connection, !frames, payload_len);
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_client_result ** result_set)
+{
+	if (!result_set || !connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (connection->socket) {
+		//Check connection state
+/*    if(_oph_io_client_ping_connection(connection)){
+      pmesg(LOG_DEBUG,__FILE__,__LINE__,"Connection was closed\n");
+      return OPH_IO_CLIENT_INTERFACE_OK;    
+    }*/
+	} else {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_OK;
+	}
+	//The reply would be read in place of the pending ones
+	if (connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Pipelined queries are waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	unsigned long long num_rows = 0;
+	unsigned int num_fields = 0;
+	int res = 0;
+
+	_oph_io_client_frame_reader reader;
+	if ((res = _oph_io_client_request_result(connection, &num_rows, &num_fields, &reader)))
+		return res;
+
 	//Rebuild result set struct
 	*result_set = (oph_io_client_result *) calloc(1, sizeof(oph_io_client_result));
 	if (!(*result_set)) {
@@ -551,91 +1078,103 @@ int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_clien
 		*result_set = NULL;
 		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
 	}
-	unsigned long long i = 0, j = 0;
-
-	//If result set does contain rows
-	if (num_rows > 0) {
-		//Read payload (binary format)
-		char *reply = (char *) calloc(payload_len, sizeof(char));
-		if (!reply) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
+	unsigned long long i = 0, j = 0, field_length = 0;
+
+	//Field types are sent only when numeric cells are binary
+	if (!reader.single && (connection->protocol & OPH_IO_CLIENT_PROTOCOL_BINARY_NUMERIC) && num_fields) {
+		(*result_set)->field_type = (char *) calloc(num_fields, sizeof(char));
+		if (!((*result_set)->field_type)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			oph_io_client_free_result(*result_set);
+			*result_set = NULL;
 			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
 		}
-		res = oph_net_readn(connection->socket, reply, payload_len);
-		if (!res) {
+		if (oph_net_readn(connection->socket, (*result_set)->field_type, num_fields) != num_fields) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
-			free(reply);
+			oph_io_client_free_result(*result_set);
+			*result_set = NULL;
 			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 		}
+	}
+	//Cells are read frame by frame directly into the result set
+
+	//Setup each row
+	for (i = 0; i < num_rows; i++) {
+		(*result_set)->result_set[i] = (oph_io_client_record *) calloc(1, sizeof(oph_io_client_record));
+		if (!((*result_set)->result_set[i])) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			oph_io_client_free_result(*result_set);
+			*result_set = NULL;
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
 
-		char *sub_reply = (char *) calloc(payload_len, sizeof(char));
-		if (!sub_reply) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
-			free(reply);
+		(*result_set)->result_set[i]->field_length = (unsigned long *) calloc(num_fields, sizeof(unsigned long));
+		if (!((*result_set)->result_set[i]->field_length)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			oph_io_client_free_result(*result_set);
+			*result_set = NULL;
 			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
 		}
-		unsigned long long string_head = 0;
 
-		//Setup each row
-		for (i = 0; i < num_rows; i++) {
-			(*result_set)->result_set[i] = (oph_io_client_record *) calloc(1, sizeof(oph_io_client_record));
-			if (!((*result_set)->result_set[i])) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-				free(reply);
-				free(sub_reply);
+		(*result_set)->result_set[i]->field = (char **) calloc(num_fields + 1, sizeof(char *));
+		if (!((*result_set)->result_set[i]->field)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			oph_io_client_free_result(*result_set);
+			*result_set = NULL;
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+
+		for (j = 0; j < num_fields; j++) {
+			//Setup each field
+
+			//Extract field length
+			if (_oph_io_client_read_frames(&reader, &field_length, OPH_IO_CLIENT_MSG_LONG_LEN)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while reading result frames\n");
 				oph_io_client_free_result(*result_set);
 				*result_set = NULL;
-				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+				return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 			}
+			(*result_set)->result_set[i]->field_length[j] = field_length;
+			pmesg(LOG_DEBUG, __FILE__, __LINE__, "Field %llu, row %llu length is: %lu\n", j, i, (*result_set)->result_set[i]->field_length[j]);
 
-			(*result_set)->result_set[i]->field_length = (unsigned long *) calloc(num_fields, sizeof(unsigned long));
-			if (!((*result_set)->result_set[i]->field_length)) {
+			(*result_set)->result_set[i]->field[j] = (char *) calloc((*result_set)->result_set[i]->field_length[j], sizeof(char));
+			if (!((*result_set)->result_set[i]->field[j])) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-				free(reply);
-				free(sub_reply);
 				oph_io_client_free_result(*result_set);
 				*result_set = NULL;
 				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
 			}
-
-			(*result_set)->result_set[i]->field = (char **) calloc(num_fields + 1, sizeof(char *));
-			if (!((*result_set)->result_set[i]->field)) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-				free(reply);
-				free(sub_reply);
+			if (_oph_io_client_read_frames(&reader, (*result_set)->result_set[i]->field[j], field_length)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while reading result frames\n");
 				oph_io_client_free_result(*result_set);
 				*result_set = NULL;
-				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+				return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 			}
-
-			for (j = 0; j < num_fields; j++) {
-				//Setup each field
-
-				//Extract field length
-				memcpy(sub_reply, reply + string_head, sizeof(unsigned long));
-				(*result_set)->result_set[i]->field_length[j] = *((unsigned long *) sub_reply);
-				string_head += sizeof(unsigned long);
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Field %llu, row %llu length is: %lu\n", j, i, (*result_set)->result_set[i]->field_length[j]);
-
-				(*result_set)->result_set[i]->field[j] = (char *) calloc((*result_set)->result_set[i]->field_length[j], sizeof(char));
-				if (!((*result_set)->result_set[i]->field[j])) {
-					pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-					free(reply);
-					free(sub_reply);
+			//Convert little-endian numbers to host order
+			if ((*result_set)->field_type && (*result_set)->field_type[j] != OPH_IO_CLIENT_FIELD_STRING) {
+				if (field_length != sizeof(uint64_t)) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Wrong length of numeric field\n");
 					oph_io_client_free_result(*result_set);
 					*result_set = NULL;
-					return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+					return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
 				}
-				memcpy((*result_set)->result_set[i]->field[j], reply + string_head, (*result_set)->result_set[i]->field_length[j]);
-				string_head += (*result_set)->result_set[i]->field_length[j];
-
-				//Set max field length
-				if ((*result_set)->max_field_length[j] < (*result_set)->result_set[i]->field_length[j])
-					(*result_set)->max_field_length[j] = (*result_set)->result_set[i]->field_length[j];
+				uint64_t number;
+				memcpy(&number, (*result_set)->result_set[i]->field[j], sizeof(uint64_t));
+				number = le64toh(number);
+				memcpy((*result_set)->result_set[i]->field[j], &number, sizeof(uint64_t));
 			}
+			//Set max field length
+			if ((*result_set)->max_field_length[j] < (*result_set)->result_set[i]->field_length[j])
+				(*result_set)->max_field_length[j] = (*result_set)->result_set[i]->field_length[j];
 		}
-		free(sub_reply);
-		free(reply);
+	}
+
+	//The result set is closed by an empty frame
+	if (_oph_io_client_end_frames(&reader)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Result set is not terminated correctly\n");
+		oph_io_client_free_result(*result_set);
+		*result_set = NULL;
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 	}
 
 	return OPH_IO_CLIENT_INTERFACE_OK;
@@ -669,6 +1208,8 @@ int oph_io_client_free_result(oph_io_client_result * result)
 
 	if (result->max_field_length)
 		free(result->max_field_length);
+	if (result->field_type)
+		free(result->field_type);
 
 	unsigned long long i, j;
 
@@ -694,6 +1235,195 @@ int oph_io_client_free_result(oph_io_client_result * result)
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
+int oph_io_client_get_raw_result(oph_io_client_connection * connection, oph_io_client_raw_result ** result_set)
+{
+	if (!result_set || !connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	*result_set = NULL;
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_OK;
+	}
+	//The reply would be read in place of the pending ones
+	if (connection->pending) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Pipelined queries are waiting for a reply\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	unsigned long long num_rows = 0, i = 0, field_length = 0;
+	unsigned int num_fields = 0, j = 0;
+	int res = 0;
+
+	_oph_io_client_frame_reader reader;
+	if ((res = _oph_io_client_request_result(connection, &num_rows, &num_fields, &reader)))
+		return res;
+
+	oph_io_client_raw_result *raw = (oph_io_client_raw_result *) calloc(1, sizeof(oph_io_client_raw_result));
+	if (!raw) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+	}
+	raw->num_rows = num_rows;
+	raw->num_fields = num_fields;
+	raw->column = (char **) calloc(num_fields + 1, sizeof(char *));
+	raw->row.field = (char **) calloc(num_fields + 1, sizeof(char *));
+	raw->row.field_length = (unsigned long *) calloc(num_fields + 1, sizeof(unsigned long));
+	if (!raw->column || !raw->row.field || !raw->row.field_length) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+		oph_io_client_free_raw_result(raw);
+		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+	}
+	//Numeric fields are fixed-width only when sent in binary form
+	if (!reader.single && (connection->protocol & OPH_IO_CLIENT_PROTOCOL_BINARY_NUMERIC) && num_fields) {
+		raw->field_type = (char *) calloc(num_fields, sizeof(char));
+		if (!raw->field_type) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			oph_io_client_free_raw_result(raw);
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+		if (oph_net_readn(connection->socket, raw->field_type, num_fields) != num_fields) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			oph_io_client_free_raw_result(raw);
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		for (j = 0; j < num_fields; j++) {
+			if (raw->field_type[j] == OPH_IO_CLIENT_FIELD_STRING)
+				continue;
+			raw->column[j] = (char *) malloc((num_rows ? num_rows : 1) * sizeof(uint64_t));
+			if (!raw->column[j]) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+				oph_io_client_free_raw_result(raw);
+				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+			}
+		}
+	}
+
+	char *tmp = NULL;
+	uint64_t number = 0;
+	for (i = 0; i < num_rows; i++) {
+		for (j = 0; j < num_fields; j++) {
+			if (_oph_io_client_read_frames(&reader, &field_length, OPH_IO_CLIENT_MSG_LONG_LEN)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while reading result frames\n");
+				oph_io_client_free_raw_result(raw);
+				return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+			}
+			if (raw->column[j]) {
+				//Fixed-width cells are stored by column in host order
+				if (field_length != sizeof(uint64_t) || _oph_io_client_read_frames(&reader, &number, sizeof(uint64_t))) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while reading result frames\n");
+					oph_io_client_free_raw_result(raw);
+					return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+				}
+				number = le64toh(number);
+				memcpy(raw->column[j] + i * sizeof(uint64_t), &number, sizeof(uint64_t));
+				continue;
+			}
+			//Other cells are appended to the payload as received
+			if (raw->payload_len + OPH_IO_CLIENT_MSG_LONG_LEN + field_length > raw->payload_size) {
+				unsigned long long size = raw->payload_size ? raw->payload_size : OPH_IO_CLIENT_RAW_RESULT_SIZE;
+				while (raw->payload_len + OPH_IO_CLIENT_MSG_LONG_LEN + field_length > size)
+					size *= 2;
+				tmp = (char *) realloc(raw->payload, size);
+				if (!tmp) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+					oph_io_client_free_raw_result(raw);
+					return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+				}
+				raw->payload = tmp;
+				raw->payload_size = size;
+			}
+			memcpy(raw->payload + raw->payload_len, &field_length, OPH_IO_CLIENT_MSG_LONG_LEN);
+			raw->payload_len += OPH_IO_CLIENT_MSG_LONG_LEN;
+			if (_oph_io_client_read_frames(&reader, raw->payload + raw->payload_len, field_length)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while reading result frames\n");
+				oph_io_client_free_raw_result(raw);
+				return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+			}
+			raw->payload_len += field_length;
+		}
+	}
+
+	//The result set is closed by an empty frame
+	if (_oph_io_client_end_frames(&reader)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Result set is not terminated correctly\n");
+		oph_io_client_free_raw_result(raw);
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+
+	*result_set = raw;
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_fetch_raw_row(oph_io_client_raw_result * result_set, oph_io_client_record ** current_row)
+{
+	if (!result_set || !current_row) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (result_set->current_row >= result_set->num_rows) {
+		*current_row = NULL;
+		return OPH_IO_CLIENT_INTERFACE_OK;
+	}
+
+	unsigned int j;
+	unsigned long long field_length = 0;
+	for (j = 0; j < result_set->num_fields; j++) {
+		if (result_set->column[j]) {
+			result_set->row.field[j] = result_set->column[j] + result_set->current_row * sizeof(uint64_t);
+			result_set->row.field_length[j] = sizeof(uint64_t);
+		} else {
+			memcpy(&field_length, result_set->payload + result_set->offset, OPH_IO_CLIENT_MSG_LONG_LEN);
+			result_set->offset += OPH_IO_CLIENT_MSG_LONG_LEN;
+			result_set->row.field[j] = result_set->payload + result_set->offset;
+			result_set->row.field_length[j] = field_length;
+			result_set->offset += field_length;
+		}
+	}
+	result_set->current_row++;
+	*current_row = &(result_set->row);
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+const void *oph_io_client_get_raw_column(oph_io_client_raw_result * result_set, unsigned int field)
+{
+	if (!result_set || field >= result_set->num_fields)
+		return NULL;
+	return result_set->column[field];
+}
+
+int oph_io_client_free_raw_result(oph_io_client_raw_result * result)
+{
+	if (!result) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	unsigned int j;
+	if (result->column) {
+		for (j = 0; j < result->num_fields; j++)
+			if (result->column[j])
+				free(result->column[j]);
+		free(result->column);
+	}
+	if (result->field_type)
+		free(result->field_type);
+	if (result->payload)
+		free(result->payload);
+	if (result->row.field)
+		free(result->row.field);
+	if (result->row.field_length)
+		free(result->row.field_length);
+	free(result);
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
 int oph_io_client_close(oph_io_client_connection * connection)
 {
 	if (!connection) {
@@ -707,12 +1437,104 @@ int oph_io_client_close(oph_io_client_connection * connection)
 	}
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection closed\n");
 
+	_oph_io_client_detach_ring(connection);
 	free(connection);
 
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
+int oph_io_client_pool_get(const char *hostname, const char *port, const char *db_name, const char *device, oph_io_client_connection ** connection)
+{
+	if (!hostname || !port || !connection || (db_name && !device)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	oph_io_client_pool_entry *entry = NULL, *prev = NULL;
+	oph_io_client_connection *candidate = NULL;
+
+	*connection = NULL;
+	for (;;) {
+		//Take the first idle connection matching the key out of the pool
+		pthread_mutex_lock(&pool_lock);
+		for (prev = NULL, entry = pool; entry; prev = entry, entry = entry->next) {
+			candidate = entry->connection;
+			if (!strcmp(candidate->host, hostname) && !strcmp(candidate->port, port) && !strcmp(candidate->db_name, db_name ? db_name : "")
+			    && !strcmp(candidate->device, db_name ? device : ""))
+				break;
+		}
+		if (entry) {
+			if (prev)
+				prev->next = entry->next;
+			else
+				pool = entry->next;
+			pool_size--;
+		}
+		pthread_mutex_unlock(&pool_lock);
+
+		if (!entry)
+			break;
+		free(entry);
+
+		//The server could have closed the connection in the meantime
+		if (!_oph_io_client_ping_connection(candidate)) {
+			pmesg(LOG_DEBUG, __FILE__, __LINE__, "Reusing pooled connection to %s:%s\n", hostname, port);
+			*connection = candidate;
+			return OPH_IO_CLIENT_INTERFACE_OK;
+		}
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Pooled connection to %s:%s is no longer valid\n", hostname, port);
+		oph_io_client_close(candidate);
+	}
+
+	return oph_io_client_connect(hostname, port, db_name, device, connection);
+}
+
+int oph_io_client_pool_release(oph_io_client_connection * connection)
+{
+	if (!connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//Connections with replies still to be read cannot be shared
+	if (!connection->socket || connection->pending)
+		return oph_io_client_close(connection);
+
+	//Next users expect default protocol options
+	if ((connection->protocol & ~OPH_IO_CLIENT_PROTOCOL_RESULT_FRAMES) && oph_io_client_set_protocol(0, connection))
+		return oph_io_client_close(connection);
+
+	oph_io_client_pool_entry *entry = (oph_io_client_pool_entry *) malloc(sizeof(oph_io_client_pool_entry));
+	if (!entry)
+		return oph_io_client_close(connection);
+	entry->connection = connection;
+
+	pthread_mutex_lock(&pool_lock);
+	if (pool_size >= OPH_IO_CLIENT_POOL_SIZE) {
+		pthread_mutex_unlock(&pool_lock);
+		free(entry);
+		return oph_io_client_close(connection);
+	}
+	entry->next = pool;
+	pool = entry;
+	pool_size++;
+	pthread_mutex_unlock(&pool_lock);
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
 int oph_io_client_cleanup()
 {
+	oph_io_client_pool_entry *entry = NULL;
+
+	pthread_mutex_lock(&pool_lock);
+	while (pool) {
+		entry = pool;
+		pool = entry->next;
+		oph_io_client_close(entry->connection);
+		free(entry);
+	}
+	pool_size = 0;
+	pthread_mutex_unlock(&pool_lock);
+
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
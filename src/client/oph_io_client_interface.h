@@ -30,6 +30,13 @@
 #define OPH_IO_CLIENT_PORT_LEN 10
 #define OPH_IO_CLIENT_HOST_LEN 512
 #define OPH_IO_CLIENT_DB_LEN 1024
+#define OPH_IO_CLIENT_DEVICE_LEN 256
+
+//Initial size of the payload of raw result sets
+#define OPH_IO_CLIENT_RAW_RESULT_SIZE 65536
+
+//Max number of idle connections kept by the pool
+#define OPH_IO_CLIENT_POOL_SIZE 64
 
 //Packet format
 /*
@@ -46,6 +53,27 @@
 ----------------------------------------------------------------------------------------------------------
 */
 
+//Streamed result set packet format, used once OPH_IO_CLIENT_PROTOCOL_RESULT_FRAMES is negotiated (cells are split in frames ended by an empty frame)
+/*
+---------------------------------------------------------------------------------------------------------------
+| uint64 nrows| uint32 nfields| uint64 frame1_len| char *frame1| ...| uint64 frameN_len| char *frameN| uint64 0|
+---------------------------------------------------------------------------------------------------------------
+*/
+
+//With the shared memory ring, frames are written in the ring and the socket carries only their length and position in the ring
+/*
+-----------------------------------------------------------------------------------------------------------------------
+| uint64 nrows| uint32 nfields| uint64 frame1_len| uint64 frame1_pos| ...| uint64 frameN_len| uint64 frameN_pos| uint64 0|
+-----------------------------------------------------------------------------------------------------------------------
+*/
+
+//Bulk insert packet format (lengths are sent only for string columns, numeric columns carry nrows 8-byte values)
+/*
+-------------------------------------------------------------------------------------------------------------------------------------------------------------
+| uint64 nrows| uint32 nfields| uint32 final| uint64 frag_len| char *frag| char type1| uint64 data1_len| uint64 *cell1_len| char *data1| ...| char *dataN|
+-------------------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+
 //Header type messages
 #define OPH_IO_CLIENT_MSG_TYPE_LEN 2
 #define OPH_IO_CLIENT_MSG_LONG_LEN sizeof(unsigned long long)
@@ -53,12 +81,38 @@
 
 #define OPH_IO_CLIENT_MSG_PING "PG"
 #define OPH_IO_CLIENT_MSG_RESULT "RS"
+#define OPH_IO_CLIENT_MSG_RESULT_FRAMES "RF"
 #define OPH_IO_CLIENT_MSG_USE_DB "UD"
 #define OPH_IO_CLIENT_MSG_SET_QUERY "SQ"
 #define OPH_IO_CLIENT_MSG_EXEC_QUERY "EQ"
+#define OPH_IO_CLIENT_MSG_PROTOCOL "PO"
+#define OPH_IO_CLIENT_MSG_TAG "TG"
+#define OPH_IO_CLIENT_MSG_BULK_INSERT "BI"
+
+//Reply to a pipelined query TAG|ID|TYPE
+#define OPH_IO_CLIENT_TAGGED_REPLY_LEN (2 * OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN)
 
 #define OPH_IO_CLIENT_REQ_ERROR   "ER"
 
+//Max number of pipelined requests waiting for a reply
+#define OPH_IO_CLIENT_MAX_PENDING 1024
+
+//Max number of buffers sent with a single writev by bulk inserts (IOV_MAX on Linux)
+#define OPH_IO_CLIENT_BULK_IOV 1024
+
+//Protocol options
+#define OPH_IO_CLIENT_PROTOCOL_BINARY_NUMERIC 0x1
+#define OPH_IO_CLIENT_PROTOCOL_SHARED_MEMORY 0x2
+#define OPH_IO_CLIENT_PROTOCOL_RESULT_FRAMES 0x4
+
+//The shared memory ring starts with a header holding the position consumed by the client
+#define OPH_IO_CLIENT_RING_HEADER_LEN 64
+
+//Field type codes sent with binary numeric result sets
+#define OPH_IO_CLIENT_FIELD_LONG 'L'
+#define OPH_IO_CLIENT_FIELD_REAL 'R'
+#define OPH_IO_CLIENT_FIELD_STRING 'S'
+
 #define OPH_IO_CLIENT_MSG_ARG_DATA_LONG "DL"
 #define OPH_IO_CLIENT_MSG_ARG_DATA_DOUBLE "DD"
 #define OPH_IO_CLIENT_MSG_ARG_DATA_NULL "DN"
@@ -70,13 +124,31 @@
  * \param host   String with hostname or IP address of server
  * \param port   Port of the server
  * \param db   	DB to be used on the server
+ * \param device Device of the DB
  * \param socket Id of file descriptor of socket associated to connection
+ * \param protocol Protocol options accepted by the server
+ * \param next_tag Tag of the next pipelined request
+ * \param pending  Number of pipelined requests waiting for a reply
+ * \param reply    Part of the next pipelined reply already read
+ * \param reply_len Length of the part of the reply already read
+ * \param shm_id   Id of the shared memory ring of the connection
+ * \param ring     Address of the shared memory ring (NULL if not attached)
+ * \param ring_size Size of the data area of the ring
  */
 typedef struct {
 	char host[OPH_IO_CLIENT_HOST_LEN];
 	char port[OPH_IO_CLIENT_PORT_LEN];
 	char db_name[OPH_IO_CLIENT_DB_LEN];
+	char device[OPH_IO_CLIENT_DEVICE_LEN];
 	int socket;
+	unsigned int protocol;
+	unsigned int next_tag;
+	unsigned int pending;
+	char reply[OPH_IO_CLIENT_TAGGED_REPLY_LEN];
+	unsigned int reply_len;
+	int shm_id;
+	char *ring;
+	unsigned long long ring_size;
 } oph_io_client_connection;
 
 /**
@@ -96,6 +168,7 @@ typedef struct {
  * \param max_field_length 	Array containing the maximum width of the field
  * \param current_row		Index of current row
  * \param result_set		Pointer to NULL terminated result set
+ * \param field_type		Array of field type codes (OPH_IO_CLIENT_FIELD_*), set only with binary numeric protocol
  */
 typedef struct {
 	unsigned long long num_rows;
@@ -103,8 +176,47 @@ typedef struct {
 	unsigned long long *max_field_length;
 	unsigned long long current_row;
 	oph_io_client_record **result_set;
+	char *field_type;
 } oph_io_client_result;
 
+/**
+ * \brief			Structure for a result set kept in the buffers it was received in (no per-row allocation)
+ * \param num_rows		Number of rows of the result set
+ * \param num_fields		Number of fields (columns) of the result set
+ * \param field_type		Array of field type codes (OPH_IO_CLIENT_FIELD_*), set only with binary numeric protocol
+ * \param column		Array of fixed-width columns (8-byte values in host order); NULL for variable-width fields
+ * \param payload		Buffer with the variable-width cells FIELD_LEN|FIELD of all rows
+ * \param payload_len		Length of the payload
+ * \param payload_size	Size of the payload buffer
+ * \param current_row		Index of current row
+ * \param offset		Offset of the current row in the payload
+ * \param row			Record returned by oph_io_client_fetch_raw_row: its cells point into the buffers of the result set
+ */
+typedef struct {
+	unsigned long long num_rows;
+	unsigned int num_fields;
+	char *field_type;
+	char **column;
+	char *payload;
+	unsigned long long payload_len;
+	unsigned long long payload_size;
+	unsigned long long current_row;
+	unsigned long long offset;
+	oph_io_client_record row;
+} oph_io_client_raw_result;
+
+/**
+ * \brief           Structure describing a column of a bulk insert
+ * \param type      Field type code (OPH_IO_CLIENT_FIELD_LONG, OPH_IO_CLIENT_FIELD_REAL or OPH_IO_CLIENT_FIELD_STRING); it must match the type of the field
+ * \param length    Array with the length of each cell (only for OPH_IO_CLIENT_FIELD_STRING columns)
+ * \param data      Cells of the column: 8-byte values in host order for numeric columns, concatenated cells for string columns
+ */
+typedef struct {
+	char type;
+	const unsigned long long *length;
+	const void *data;
+} oph_io_client_column;
+
 /**
  * \brief           Enum with admissible argument types
  */
@@ -159,7 +271,7 @@ int oph_io_client_setup();
 
 /**
  * \brief               Function to connect or reconnect to IO server.
- * \param hostname      Hostname of server
+ * \param hostname      Hostname of server or path of its Unix domain socket (if it starts with '/', port is ignored)
  * \param port          Port of server
  * \param db_name       DB to be used (can be NULL)
  * \param device        Name of device where data is stored
@@ -172,19 +284,87 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
  * \brief               Function to set default database for specified server.
  * \param db_name       Name of database to be used
  * \param device        Name of device where data is stored
- * \param connection    Pointer to IO server connection structure
+ * \param connection    Pointer to IO server connection structure (no pipelined query can be waiting for a reply)
  * \return              0 if successfull, non-0 otherwise
  */
 int oph_io_client_use_db(const char *db_name, const char *device, oph_io_client_connection * connection);
 
+/**
+ * \brief               Function to negotiate protocol options with the server. With OPH_IO_CLIENT_PROTOCOL_BINARY_NUMERIC
+ *                      LONG and REAL cells of result sets are returned as 8-byte values in host order instead of strings.
+ *                      OPH_IO_CLIENT_PROTOCOL_SHARED_MEMORY is granted only on Unix domain socket connections: result frames are then
+ *                      read from a shared memory ring; if the ring cannot be attached, the option is dropped.
+ *                      OPH_IO_CLIENT_PROTOCOL_RESULT_FRAMES is always requested: result sets are streamed in frames only if the server
+ *                      accepts it, otherwise (and before any negotiation) they are transferred with the legacy RS message
+ * \param protocol      Bitmask of requested options
+ * \param connection    Pointer to IO server connection structure (options accepted by the server are stored in it; no pipelined query can be waiting for a reply)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_set_protocol(unsigned int protocol, oph_io_client_connection * connection);
+
 /**
  * \brief               Function to execute an operation on data stored into server.
- * \param connection    Pointer to server-specific connection structure
+ * \param connection    Pointer to server-specific connection structure (no pipelined query can be waiting for a reply)
  * \param query         Pointer to query to be executed
  * \return              0 if successfull, non-0 otherwise
  */
 int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_client_query * query);
 
+/**
+ * \brief               Function to send a query without waiting for the reply. Replies are collected in submission order with
+ *                      oph_io_client_complete_query; at most OPH_IO_CLIENT_MAX_PENDING queries can wait for a reply at the same time
+ * \param connection    Pointer to IO server connection structure
+ * \param query         Pointer to query to be executed
+ * \param tag           Tag assigned to the request (it can be NULL)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_submit_query(oph_io_client_connection * connection, oph_io_client_query * query, unsigned int *tag);
+
+/**
+ * \brief               Function to get the descriptor to be watched (for readability) by an event loop driving the connection
+ * \param connection    Pointer to IO server connection structure
+ * \return              descriptor of the connection if open, -1 otherwise
+ */
+int oph_io_client_fd(oph_io_client_connection * connection);
+
+/**
+ * \brief               Function to check, without blocking, if the reply to the oldest query sent with oph_io_client_submit_query has arrived
+ * \param connection    Pointer to IO server connection structure
+ * \param ready         Set to 1 if oph_io_client_complete_query can be called without blocking, 0 otherwise
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_poll_query(oph_io_client_connection * connection, int *ready);
+
+/**
+ * \brief               Function to get the reply to the oldest query sent with oph_io_client_submit_query; it blocks only if the reply has not arrived yet
+ * \param connection    Pointer to IO server connection structure
+ * \param tag           Tag of the request the reply refers to (it can be NULL)
+ * \return              0 if the query was executed correctly, non-0 otherwise
+ */
+int oph_io_client_complete_query(oph_io_client_connection * connection, unsigned int *tag);
+
+/**
+ * \brief               Function to wait for the reply to the oldest query sent with oph_io_client_submit_query (it polls the connection without timeout and completes the query)
+ * \param connection    Pointer to IO server connection structure
+ * \param tag           Tag of the request the reply refers to (it can be NULL)
+ * \return              0 if the query was executed correctly, non-0 otherwise
+ */
+int oph_io_client_wait_query(oph_io_client_connection * connection, unsigned int *tag);
+
+/**
+ * \brief               Function to append a batch of rows, given as columns, to the fragment created by the last create fragment query on the connection.
+ *                      Cells are sent without any encoding and copied by the server straight into the fragment columns
+ * \param connection    Pointer to IO server connection structure (no pipelined query can be waiting for a reply)
+ * \param frag_name     Name of the fragment
+ * \param num_rows      Number of rows in the batch
+ * \param num_fields    Number of columns (it must be equal to the number of fields of the fragment)
+ * \param column        Array of num_fields columns
+ * \param final_stmt    Set to 1 for the last batch: the fragment is then stored by the server
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_bulk_insert(oph_io_client_connection * connection, const char *frag_name, unsigned long long num_rows, unsigned int num_fields, const oph_io_client_column * column,
+			      char final_stmt);
+
 /**
  * \brief               Function to setup the query structure with given operation and array argument
  * \param connection    Pointer to server-specific connection structure
@@ -213,14 +393,33 @@ int oph_io_client_free_query(oph_io_client_query * query);
 int oph_io_client_close(oph_io_client_connection * connection);
 
 /**
- * \brief               Function to finalize library of IO server and release all dynamic loading resources.
+ * \brief               Function to get a connection from the pool (thread-safe). An idle connection with the same host, port, db and device
+ *                      is reused if it answers to a ping, otherwise a new connection is opened as with oph_io_client_connect
+ * \param hostname      Hostname of server
+ * \param port          Port of server
+ * \param db_name       Name of default database to be used (it can be NULL)
+ * \param device        Name of device where data is stored
+ * \param connection    Pointer to IO server connection structure to be filled
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_pool_get(const char *hostname, const char *port, const char *db_name, const char *device, oph_io_client_connection ** connection);
+
+/**
+ * \brief               Function to give a connection back to the pool (thread-safe); it is closed if the pool is full or the connection is not reusable
+ * \param connection    Pointer to IO server connection structure
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_pool_release(oph_io_client_connection * connection);
+
+/**
+ * \brief               Function to finalize library of IO server and release all dynamic loading resources (idle pooled connections are closed).
  * \return              0 if successfull, non-0 otherwise
  */
 int oph_io_client_cleanup();
 
 /**
  * \brief               Function to get result set after executing a query.
- * \param connection    Pointer to server-specific connection structure
+ * \param connection    Pointer to server-specific connection structure (no pipelined query can be waiting for a reply)
  * \param result_set    Pointer to the result set array to be created
  * \return              0 if successfull, non-0 otherwise
  */
@@ -241,4 +440,37 @@ int oph_io_client_fetch_row(oph_io_client_result * result_set, oph_io_client_rec
  */
 int oph_io_client_free_result(oph_io_client_result * result);
 
+/**
+ * \brief               Function to get the result set of last query executed as a raw result. With binary numeric protocol, LONG and REAL
+ *                      fields are stored as contiguous columns; all the other cells are kept in a single buffer
+ * \param connection    Pointer to IO server connection structure (no pipelined query can be waiting for a reply)
+ * \param result_set    Pointer to raw result set to be filled
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_get_raw_result(oph_io_client_connection * connection, oph_io_client_raw_result ** result_set);
+
+/**
+ * \brief               Function to get the next row of a raw result set. The record and the cells it points to belong to the result set:
+ *                      the record is overwritten by the next call and released by oph_io_client_free_raw_result
+ * \param result_set    Pointer to raw result set
+ * \param current_row   Pointer to the record of the next row; it is set to NULL when no row is left
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_fetch_raw_row(oph_io_client_raw_result * result_set, oph_io_client_record ** current_row);
+
+/**
+ * \brief               Function to access a fixed-width column of a raw result set
+ * \param result_set    Pointer to raw result set
+ * \param field         Index of the field
+ * \return              Pointer to num_rows 8-byte values (unsigned long long or double, according to field_type) if the column is fixed-width, NULL otherwise
+ */
+const void *oph_io_client_get_raw_column(oph_io_client_raw_result * result_set, unsigned int field);
+
+/**
+ * \brief               Function to release resources of a raw result set
+ * \param result        Pointer to raw result set
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_free_raw_result(oph_io_client_raw_result * result);
+
 #endif				//__OPH_IO_CLIENT_INTERFACE_H
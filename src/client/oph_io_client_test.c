@@ -28,6 +28,190 @@
 
 #define OPH_DEFAULT_NCHILDREN	2
 #define OPH_DEFAULT_NLOOPS	1
+#define OPH_DEFAULT_PIPELINE	16
+#define OPH_DEFAULT_BULK_ROWS	64
+
+//Setup and execute a query without arguments
+static int oph_io_test_execute(oph_io_client_connection * connection, const char *query)
+{
+	oph_io_client_query *stmt = NULL;
+	int res;
+
+	if ((res = oph_io_client_setup_query(connection, query, "memory", 0, (oph_io_client_query_arg **) NULL, &stmt))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in setup query '%s'\n", res, query);
+		oph_io_client_free_query(stmt);
+		return res;
+	}
+	if ((res = oph_io_client_execute_query(connection, stmt)))
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in executing query '%s'\n", res, query);
+	else
+		printf("Query submitted correctly.\n");
+	oph_io_client_free_query(stmt);
+
+	return res;
+}
+
+//Pipeline the inserts of a fragment and check that ids and measures are read back in order
+static int oph_io_test_pipeline(oph_io_client_connection * connection, int array_length)
+{
+	int i, r, res;
+	unsigned int tags[OPH_DEFAULT_PIPELINE], tag = 0;
+	unsigned long long id = 0;
+	double measure[array_length];
+	oph_io_client_query *stmt = NULL;
+	oph_io_client_query_arg *args[3];
+	oph_io_client_query_arg arg1, arg2;
+
+	if ((res = oph_io_test_execute(connection, "operation=create_frag;frag_name=trial4;column_name=id|measure;column_type=long|blob;")))
+		return res;
+
+	args[0] = &arg1;
+	args[1] = &arg2;
+	args[2] = NULL;
+	arg1.arg_type = OPH_IO_CLIENT_TYPE_LONG;
+	arg1.arg_length = sizeof(unsigned long long);
+	arg1.arg = &id;
+	arg2.arg_type = OPH_IO_CLIENT_TYPE_BLOB;
+	arg2.arg_length = sizeof(double) * array_length;
+	arg2.arg = measure;
+
+	if ((res =
+	     oph_io_client_setup_query(connection, "operation=insert;frag_name=trial4;field=id|measure;value=?|?;", "memory", OPH_DEFAULT_PIPELINE, (oph_io_client_query_arg **) args,
+				       &stmt))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in setup query '%s'\n", res, "operation=insert;frag_name=trial4;field=id|measure;value=?|?;");
+		oph_io_client_free_query(stmt);
+		return res;
+	}
+	//Arguments are encoded when a query is submitted, so they can be changed before the reply arrives
+	for (i = 0; i < OPH_DEFAULT_PIPELINE; i++) {
+		id++;
+		for (r = 0; r < array_length; r++)
+			measure[r] = (double) i;
+		if ((res = oph_io_client_submit_query(connection, stmt, &(tags[i])))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in submitting run %d of query '%s'\n", res, i, "operation=insert;frag_name=trial4;field=id|measure;value=?|?;");
+			oph_io_client_free_query(stmt);
+			return res;
+		}
+	}
+	//Replies come back in submission order
+	for (i = 0; i < OPH_DEFAULT_PIPELINE; i++) {
+		if ((res = i % 2 ? oph_io_client_wait_query(connection, &tag) : oph_io_client_complete_query(connection, &tag)) || tag != tags[i]) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in completing run %d (tag %u instead of %u)\n", res, i, tag, tags[i]);
+			oph_io_client_free_query(stmt);
+			return res ? res : OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+		}
+	}
+	oph_io_client_free_query(stmt);
+	printf("Pipelined queries completed correctly.\n");
+
+	if ((res = oph_io_test_execute(connection, "operation=select;field=id|measure;from=trial4;")))
+		return res;
+
+	oph_io_client_result *result_set = NULL;
+	if ((res = oph_io_client_get_result(connection, &result_set))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in retrieving result set\n", res);
+		return res;
+	}
+	oph_io_client_record *current_row = NULL;
+	for (i = 0, oph_io_client_fetch_row(result_set, &current_row); current_row; i++, oph_io_client_fetch_row(result_set, &current_row)) {
+		if (strtoll(current_row->field[0], NULL, 10) != i + 1 || current_row->field_length[1] != sizeof(double) * array_length
+		    || memcmp(current_row->field[1], &((double) { i }), sizeof(double))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Row %d of fragment trial4 is not correct\n", i);
+			break;
+		}
+	}
+	if (current_row || i != OPH_DEFAULT_PIPELINE) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unexpected result set of fragment trial4\n");
+		oph_io_client_free_result(result_set);
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	oph_io_client_free_result(result_set);
+	printf("Pipelined inserts read back correctly.\n");
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+//Load a fragment with two bulk insert batches and read it back with result frames. Ids are sequential, so they are stored implicitly:
+//reading them back checks both the columnar append of the batches and the implicit id column
+static int oph_io_test_bulk(oph_io_client_connection * connection, int array_length)
+{
+	int i, r, res;
+	unsigned long long ids[OPH_DEFAULT_BULK_ROWS], lengths[OPH_DEFAULT_BULK_ROWS];
+	double *measures = (double *) malloc(OPH_DEFAULT_BULK_ROWS * array_length * sizeof(double));
+	if (!measures) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+	}
+	for (i = 0; i < OPH_DEFAULT_BULK_ROWS; i++) {
+		ids[i] = i + 1;
+		lengths[i] = sizeof(double) * array_length;
+		for (r = 0; r < array_length; r++)
+			measures[i * array_length + r] = (double) i;
+	}
+
+	//Request binary numeric cells; result frames are always requested
+	if ((res = oph_io_client_set_protocol(OPH_IO_CLIENT_PROTOCOL_BINARY_NUMERIC, connection))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in setting protocol options\n", res);
+		free(measures);
+		return res;
+	}
+	printf("Result frames %s.\n", connection->protocol & OPH_IO_CLIENT_PROTOCOL_RESULT_FRAMES ? "accepted" : "not supported");
+
+	if ((res = oph_io_test_execute(connection, "operation=create_frag;frag_name=trial5;column_name=id|measure;column_type=long|blob;"))) {
+		free(measures);
+		return res;
+	}
+
+	oph_io_client_column column[2];
+	int half = OPH_DEFAULT_BULK_ROWS / 2;
+	for (i = 0; i < 2; i++) {
+		column[0].type = OPH_IO_CLIENT_FIELD_LONG;
+		column[0].length = NULL;
+		column[0].data = ids + i * half;
+		column[1].type = OPH_IO_CLIENT_FIELD_STRING;
+		column[1].length = lengths + i * half;
+		column[1].data = measures + i * half * array_length;
+		if ((res = oph_io_client_bulk_insert(connection, "trial5", i ? OPH_DEFAULT_BULK_ROWS - half : half, 2, column, i))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in bulk insert of batch %d\n", res, i);
+			free(measures);
+			return res;
+		}
+	}
+	free(measures);
+	printf("Bulk insert completed correctly.\n");
+
+	if ((res = oph_io_test_execute(connection, "operation=select;field=id|measure;from=trial5;")))
+		return res;
+
+	oph_io_client_raw_result *raw_set = NULL;
+	if ((res = oph_io_client_get_raw_result(connection, &raw_set))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in retrieving raw result set\n", res);
+		return res;
+	}
+	if (raw_set->num_rows != OPH_DEFAULT_BULK_ROWS || raw_set->num_fields != 2) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unexpected size of the result set of fragment trial5\n");
+		oph_io_client_free_raw_result(raw_set);
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	//Ids are a fixed-width column when binary numeric cells are accepted, strings otherwise
+	const unsigned long long *id_column = (const unsigned long long *) oph_io_client_get_raw_column(raw_set, 0);
+	oph_io_client_record *current_row = NULL;
+	for (i = 0, oph_io_client_fetch_raw_row(raw_set, &current_row); current_row; i++, oph_io_client_fetch_raw_row(raw_set, &current_row)) {
+		if ((id_column ? id_column[i] : strtoull(current_row->field[0], NULL, 10)) != ids[i] || current_row->field_length[1] != lengths[i]
+		    || memcmp(current_row->field[1], &((double) { i }), sizeof(double))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Row %d of fragment trial5 is not correct\n", i);
+			break;
+		}
+	}
+	oph_io_client_free_raw_result(raw_set);
+	if (current_row || i != OPH_DEFAULT_BULK_ROWS) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unexpected result set of fragment trial5\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	printf("Bulk inserted rows read back correctly.\n");
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
 
 int main(int argc, char *argv[])
 {
@@ -399,6 +583,17 @@ int main(int argc, char *argv[])
 				}
 				oph_io_client_free_result(result_set);
 
+				//Pipelined inserts
+				if (oph_io_test_pipeline(connection, array_length)) {
+					res = oph_io_client_close(connection);
+					return 0;
+				}
+				//Bulk insert and result frames
+				if (oph_io_test_bulk(connection, array_length)) {
+					res = oph_io_client_close(connection);
+					return 0;
+				}
+
 				snprintf(query, 1024, "operation=drop_database;db_name=test%d;", ii);
 
 				//Delete full DB
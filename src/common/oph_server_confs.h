@@ -39,6 +39,7 @@
 #define OPH_SERVER_DATABASE_SCHEMA                "%s/var/database.db"
 #define OPH_SERVER_FRAGMENT_SCHEMA                "%s/var/fragment.db"
 #define OPH_SERVER_TEMP_SCHEMA                    "%s/var/tmp.db"
+#define OPH_SERVER_SNAPSHOT                       "%s/var/snapshot.db"
 
 #define OPH_SERVER_LOG_PATH                 OPH_SERVER_PREFIX"/log/server.log"
 #define OPH_SERVER_LOG_PATH_PREFIX          "%s/log/server.log"
@@ -70,11 +71,23 @@
 #define OPH_SERVER_CONF_CACHE_LINE_SIZE	  "CACHE_LINE_SIZE"
 #define OPH_SERVER_CONF_CACHE_SIZE     	  "CACHE_SIZE"
 #define OPH_SERVER_CONF_WORKING_DIR    	  "WORKING_DIR"
+#define OPH_SERVER_CONF_SNAPSHOT_INTERVAL "SNAPSHOT_INTERVAL"
+#define OPH_SERVER_CONF_MEMORY_BUDGET     "MEMORY_BUDGET"
+#define OPH_SERVER_CONF_COMPRESSION_DELAY "COMPRESSION_DELAY"
+#define OPH_SERVER_CONF_HUGE_PAGES        "HUGE_PAGES"
+#define OPH_SERVER_CONF_NUMA_POLICY       "NUMA_POLICY"
+#define OPH_SERVER_CONF_WORKER_THREADS    "WORKER_THREADS"
+#define OPH_SERVER_CONF_UNIX_SOCKET       "UNIX_SOCKET"
+#define OPH_SERVER_CONF_SHM_RING_SIZE     "SHM_RING_SIZE"
+#define OPH_SERVER_CONF_QUERY_CACHE_SIZE  "QUERY_CACHE_SIZE"
+#define OPH_SERVER_CONF_MAX_BULK_LEN      "MAX_BULK_LEN"
 
 
 static const char *const oph_server_conf_params[] =
     { OPH_SERVER_CONF_HOSTNAME, OPH_SERVER_CONF_PORT, OPH_SERVER_CONF_DIR, OPH_SERVER_CONF_MPL, OPH_SERVER_CONF_TTL, OPH_SERVER_CONF_OMP_THREADS, OPH_SERVER_CONF_MEMORY_BUFFER,
-	OPH_SERVER_CONF_CACHE_LINE_SIZE, OPH_SERVER_CONF_CACHE_SIZE, OPH_SERVER_CONF_WORKING_DIR, NULL
+	OPH_SERVER_CONF_CACHE_LINE_SIZE, OPH_SERVER_CONF_CACHE_SIZE, OPH_SERVER_CONF_WORKING_DIR, OPH_SERVER_CONF_SNAPSHOT_INTERVAL,
+	OPH_SERVER_CONF_MEMORY_BUDGET, OPH_SERVER_CONF_COMPRESSION_DELAY, OPH_SERVER_CONF_HUGE_PAGES, OPH_SERVER_CONF_NUMA_POLICY,
+	OPH_SERVER_CONF_WORKER_THREADS, OPH_SERVER_CONF_UNIX_SOCKET, OPH_SERVER_CONF_SHM_RING_SIZE, OPH_SERVER_CONF_QUERY_CACHE_SIZE, OPH_SERVER_CONF_MAX_BULK_LEN, NULL
 };
 
 /**
@@ -27,7 +27,487 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef OPH_MEMORY_COMPRESSION
+#include <zlib.h>
+#endif
+
+//Fragments kept in memory, from the most to the least recently used, and their overall footprint
+static pthread_mutex_t memory_lock = PTHREAD_MUTEX_INITIALIZER;
+static memory_frag_entry *memory_lru_head = NULL;
+static memory_frag_entry *memory_lru_tail = NULL;
+static unsigned long long memory_resident_size = 0;
+static char memory_spill_ready = 0;
+
+//Background thread compressing cold fragments and spilling fragments when the memory budget is exceeded
+static pthread_cond_t memory_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t memory_idle_cond = PTHREAD_COND_INITIALIZER;
+static oph_iostore_handler *memory_handle = NULL;
+static pthread_t memory_tid;
+static char memory_running = 0;
+static char memory_stop = 0;
+static char memory_pending = 0;
+
+static void _memory_lru_unlink(memory_frag_entry * entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		memory_lru_head = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		memory_lru_tail = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+static void _memory_lru_push(memory_frag_entry * entry)
+{
+	entry->prev = NULL;
+	entry->next = memory_lru_head;
+	if (memory_lru_head)
+		memory_lru_head->prev = entry;
+	else
+		memory_lru_tail = entry;
+	memory_lru_head = entry;
+}
+
+static void _memory_free_blocks(memory_compressed_block * blocks, unsigned int block_num)
+{
+	unsigned int i;
+	for (i = 0; i < block_num; i++)
+		free(blocks[i].data);
+	free(blocks);
+}
+
+static void _memory_release_blocks(memory_frag_entry * entry)
+{
+	_memory_free_blocks(entry->blocks, entry->block_num);
+	entry->blocks = NULL;
+	entry->block_num = 0;
+	memory_resident_size -= entry->compressed_size;
+	entry->compressed_size = 0;
+}
+
+#ifdef OPH_MEMORY_COMPRESSION
+//Blocks are independent, so they are compressed and decompressed in parallel
+static int _memory_inflate_frag(memory_frag_entry * entry, char *image)
+{
+	char failed = 0;
+	int i;
+#ifdef OPH_OMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < (int) entry->block_num; i++) {
+		unsigned long long offset = (unsigned long long) i * MEMORY_COMPRESSION_BLOCK;
+		uLongf length = (uLongf) (entry->image_size - offset < MEMORY_COMPRESSION_BLOCK ? entry->image_size - offset : MEMORY_COMPRESSION_BLOCK);
+		if (uncompress((Bytef *) image + offset, &length, (const Bytef *) entry->blocks[i].data, (uLong) entry->blocks[i].length) != Z_OK)
+			failed = 1;
+	}
+	if (failed) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_DECOMPRESSION_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_DECOMPRESSION_ERROR);
+		return MEMORY_DEV_ERROR;
+	}
+	return MEMORY_DEV_SUCCESS;
+}
+
+//Compress the image of a record set in blocks (no device state is accessed, so memory_lock is not needed)
+static int _memory_compress_image(oph_iostore_frag_record_set * record_set, memory_compressed_block ** blocks, unsigned int *block_num, unsigned long long *image_size,
+				  unsigned long long *compressed_size)
+{
+	if (oph_iostore_get_frag_image_size(record_set, image_size))
+		return MEMORY_DEV_ERROR;
+
+	*block_num = (unsigned int) ((*image_size + MEMORY_COMPRESSION_BLOCK - 1) / MEMORY_COMPRESSION_BLOCK);
+	char *image = (char *) malloc(*image_size * sizeof(char));
+	*blocks = (memory_compressed_block *) calloc(*block_num, sizeof(memory_compressed_block));
+	if (!image || !*blocks) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		free(image);
+		free(*blocks);
+		*blocks = NULL;
+		return MEMORY_DEV_MEMORY_ERROR;
+	}
+	if (oph_iostore_write_frag_image(record_set, image, *image_size)) {
+		free(image);
+		free(*blocks);
+		*blocks = NULL;
+		return MEMORY_DEV_ERROR;
+	}
+
+	memory_compressed_block *internal_blocks = *blocks;
+	unsigned long long internal_size = *image_size;
+	char failed = 0;
+	int i;
+#ifdef OPH_OMP
+#pragma omp parallel for
+#endif
+	for (i = 0; i < (int) *block_num; i++) {
+		unsigned long long offset = (unsigned long long) i * MEMORY_COMPRESSION_BLOCK;
+		uLong source_length = (uLong) (internal_size - offset < MEMORY_COMPRESSION_BLOCK ? internal_size - offset : MEMORY_COMPRESSION_BLOCK);
+		uLongf length = compressBound(source_length);
+		char *data = (char *) malloc(length * sizeof(char));
+		if (!data || compress2((Bytef *) data, &length, (const Bytef *) image + offset, source_length, Z_BEST_SPEED) != Z_OK) {
+			free(data);
+			failed = 1;
+			continue;
+		}
+		//Shrink the buffer to the actual compressed length
+		char *tmp = (char *) realloc(data, length);
+		internal_blocks[i].data = tmp ? tmp : data;
+		internal_blocks[i].length = length;
+	}
+	free(image);
+
+	if (failed) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_COMPRESSION_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_COMPRESSION_ERROR);
+		_memory_free_blocks(*blocks, *block_num);
+		*blocks = NULL;
+		return MEMORY_DEV_ERROR;
+	}
+
+	*compressed_size = *block_num * sizeof(memory_compressed_block);
+	for (i = 0; i < (int) *block_num; i++)
+		*compressed_size += internal_blocks[i].length;
+
+	return MEMORY_DEV_SUCCESS;
+}
+
+//Replace a fragment with its compressed image (memory_lock is released while compressing; the fragment is left as is if compression is not worthwhile)
+static int _memory_compress_frag(memory_frag_entry * entry)
+{
+	//The reference keeps the fragment alive, while the busy flag prevents it from being spilled or deleted
+	oph_iostore_frag_record_set *record_set = entry->record_set;
+	time_t last_access = entry->last_access;
+	memory_compressed_block *blocks = NULL;
+	unsigned int block_num = 0;
+	unsigned long long image_size = 0, compressed_size = 0;
+	oph_iostore_retain_frag_recordset(record_set);
+	entry->busy = 1;
+	pthread_mutex_unlock(&memory_lock);
+
+	int res = _memory_compress_image(record_set, &blocks, &block_num, &image_size, &compressed_size);
+	oph_iostore_destroy_frag_recordset(&record_set);
+
+	pthread_mutex_lock(&memory_lock);
+	entry->busy = 0;
+	pthread_cond_broadcast(&memory_idle_cond);
+	if (res)
+		return res;
+	if (compressed_size >= entry->size) {
+		_memory_free_blocks(blocks, block_num);
+		entry->compressible = 0;
+		return MEMORY_DEV_SUCCESS;
+	}
+	//The fragment has been read meanwhile, so it is no longer cold
+	if (entry->last_access != last_access || entry->record_set->ref_count > 1) {
+		_memory_free_blocks(blocks, block_num);
+		return MEMORY_DEV_SUCCESS;
+	}
+
+	entry->blocks = blocks;
+	entry->block_num = block_num;
+	entry->image_size = image_size;
+	entry->compressed_size = compressed_size;
+	memory_resident_size += compressed_size;
+	oph_iostore_destroy_frag_recordset(&(entry->record_set));
+	memory_resident_size -= entry->size;
 
+	return MEMORY_DEV_SUCCESS;
+}
+
+//Rebuild a compressed fragment in an anonymous mapping, which is released along with the fragment (memory_lock is released while inflating)
+static int _memory_decompress_frag(memory_frag_entry * entry)
+{
+	//The busy flag keeps the blocks unchanged, while other readers wait for the record set to be published
+	oph_iostore_frag_record_set *record_set = NULL;
+	unsigned long long image_size = entry->image_size;
+	entry->busy = 1;
+	pthread_mutex_unlock(&memory_lock);
+
+	int res = MEMORY_DEV_SUCCESS;
+	char *map = (char *) mmap(NULL, image_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		res = MEMORY_DEV_MEMORY_ERROR;
+	} else {
+		int numa_node = oph_iostore_mem_get_node();
+		oph_iostore_mem_advise(map, image_size, numa_node);
+		if (_memory_inflate_frag(entry, map) || oph_iostore_map_frag_image(map, image_size, map, image_size, &record_set)) {
+			munmap(map, image_size);
+			res = MEMORY_DEV_ERROR;
+		} else
+			record_set->numa_node = numa_node;
+	}
+
+	pthread_mutex_lock(&memory_lock);
+	entry->busy = 0;
+	if (!res) {
+		entry->record_set = record_set;
+		_memory_release_blocks(entry);
+		memory_resident_size += entry->size;
+	}
+	pthread_cond_broadcast(&memory_idle_cond);
+
+	return res;
+}
+#endif
+
+//Compress the fragments not accessed for a while (they are at the end of the LRU list) and not being read by any query
+static void _memory_compress_cold(oph_iostore_handler * handle)
+{
+#ifdef OPH_MEMORY_COMPRESSION
+	if (!handle->compression_delay)
+		return;
+
+	time_t now = time(NULL);
+	memory_frag_entry *entry = NULL;
+	for (entry = memory_lru_tail; !memory_stop && entry && entry->last_access + (time_t) handle->compression_delay <= now; entry = entry->prev)
+		if (!entry->busy && entry->record_set && entry->compressible && entry->record_set->ref_count == 1 && _memory_compress_frag(entry))
+			break;
+#else
+	(void) handle;
+#endif
+}
+
+//Write the image of a fragment (from its record set or from its compressed blocks) in a new spill file
+static int _memory_write_spill_file(oph_iostore_handler * handle, memory_frag_entry * entry, oph_iostore_frag_record_set * record_set, char **spill_file)
+{
+	unsigned long long file_size = entry->image_size;
+	if (record_set && oph_iostore_get_frag_image_size(record_set, &file_size))
+		return MEMORY_DEV_ERROR;
+
+	char file[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	snprintf(file, OPH_IOSTORAGE_BUFLEN, MEMORY_SPILL_TEMPLATE, handle->data_dir);
+	int fd = mkstemp(file);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, file, strerror(errno));
+		return MEMORY_DEV_ERROR;
+	}
+	char *map = MAP_FAILED;
+	if (!ftruncate(fd, (off_t) file_size))
+		map = (char *) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, file, strerror(errno));
+		unlink(file);
+		return MEMORY_DEV_ERROR;
+	}
+	int res = MEMORY_DEV_ERROR;
+	if (record_set)
+		res = oph_iostore_write_frag_image(record_set, map, file_size);
+#ifdef OPH_MEMORY_COMPRESSION
+	else
+		res = _memory_inflate_frag(entry, map);
+#endif
+	if (munmap(map, file_size) || res || !(*spill_file = (char *) strdup(file))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, file, strerror(errno));
+		unlink(file);
+		return MEMORY_DEV_ERROR;
+	}
+
+	return MEMORY_DEV_SUCCESS;
+}
+
+//Write the image of a fragment (only once, since fragments are never modified) and release it (memory_lock is released while writing)
+static int _memory_spill_frag(oph_iostore_handler * handle, memory_frag_entry * entry)
+{
+	if (!entry->spill_file) {
+		//The reference (or the busy flag, for compressed fragments) keeps the fragment unchanged while the file is written
+		oph_iostore_frag_record_set *record_set = entry->record_set;
+		time_t last_access = entry->last_access;
+		char *spill_file = NULL;
+		if (record_set)
+			oph_iostore_retain_frag_recordset(record_set);
+		entry->busy = 1;
+		pthread_mutex_unlock(&memory_lock);
+
+		int res = _memory_write_spill_file(handle, entry, record_set, &spill_file);
+		if (record_set)
+			oph_iostore_destroy_frag_recordset(&record_set);
+
+		pthread_mutex_lock(&memory_lock);
+		entry->busy = 0;
+		pthread_cond_broadcast(&memory_idle_cond);
+		if (res)
+			return MEMORY_DEV_ERROR;
+		entry->spill_file = spill_file;
+
+		//The fragment has been read meanwhile, so it is kept in memory (its file is ready for a later spill)
+		if (entry->last_access != last_access || (entry->record_set && entry->record_set->ref_count > 1))
+			return MEMORY_DEV_SUCCESS;
+	}
+
+	_memory_lru_unlink(entry);
+	if (entry->record_set) {
+		oph_iostore_destroy_frag_recordset(&(entry->record_set));
+		memory_resident_size -= entry->size;
+	} else
+		_memory_release_blocks(entry);
+
+	return MEMORY_DEV_SUCCESS;
+}
+
+//Map back the image of a spilled fragment
+static int _memory_load_frag(memory_frag_entry * entry)
+{
+	int fd = open(entry->spill_file, O_RDONLY);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, entry->spill_file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, entry->spill_file, strerror(errno));
+		return MEMORY_DEV_ERROR;
+	}
+	struct stat st;
+	char *map = MAP_FAILED;
+	if (!fstat(fd, &st) && st.st_size > 0)
+		map = (char *) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, entry->spill_file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_SPILL_ERROR, entry->spill_file, strerror(errno));
+		return MEMORY_DEV_ERROR;
+	}
+
+	if (oph_iostore_map_frag_image(map, st.st_size, map, st.st_size, &(entry->record_set))) {
+		munmap(map, st.st_size);
+		return MEMORY_DEV_ERROR;
+	}
+
+	_memory_lru_push(entry);
+	memory_resident_size += entry->size;
+
+	return MEMORY_DEV_SUCCESS;
+}
+
+//Spill the least recently used fragments (compressed or not being read by any query) until the memory budget is respected
+static void _memory_spill_cold(oph_iostore_handler * handle)
+{
+	if (!handle->memory_budget || !memory_spill_ready)
+		return;
+
+	memory_frag_entry *entry = NULL;
+	while (!memory_stop && memory_resident_size > handle->memory_budget) {
+		for (entry = memory_lru_tail; entry; entry = entry->prev)
+			if (!entry->busy && (!entry->record_set || entry->record_set->ref_count == 1))
+				break;
+		if (!entry || _memory_spill_frag(handle, entry))
+			break;
+	}
+}
+
+//Wake up the background thread if some fragment may be cold or the memory budget is exceeded
+static void _memory_wake_housekeeper(oph_iostore_handler * handle)
+{
+	if (memory_running && (handle->compression_delay || (handle->memory_budget && memory_resident_size > handle->memory_budget))) {
+		memory_pending = 1;
+		pthread_cond_signal(&memory_cond);
+	}
+}
+
+static void *_memory_housekeeper(void *arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&memory_lock);
+	for (;;) {
+		while (!memory_pending && !memory_stop)
+			pthread_cond_wait(&memory_cond, &memory_lock);
+		if (memory_stop)
+			break;
+		memory_pending = 0;
+		_memory_compress_cold(memory_handle);
+		_memory_spill_cold(memory_handle);
+	}
+	pthread_mutex_unlock(&memory_lock);
+
+	return (NULL);
+}
+
+//Decompress or reload a fragment and mark it as the most recently used
+static int _memory_fetch_frag(memory_frag_entry * entry)
+{
+	//A compressed fragment being spilled or decompressed by another query is read as soon as it is ready
+	while (entry->busy && !entry->record_set)
+		pthread_cond_wait(&memory_idle_cond, &memory_lock);
+
+	if (entry->blocks) {
+#ifdef OPH_MEMORY_COMPRESSION
+		if (_memory_decompress_frag(entry))
+			return MEMORY_DEV_ERROR;
+#endif
+		_memory_lru_unlink(entry);
+		_memory_lru_push(entry);
+	} else if (entry->record_set == NULL) {
+		if (_memory_load_frag(entry))
+			return MEMORY_DEV_ERROR;
+	} else {
+		_memory_lru_unlink(entry);
+		_memory_lru_push(entry);
+	}
+	entry->last_access = time(NULL);
+
+	return MEMORY_DEV_SUCCESS;
+}
+
+//Create the entry of a new fragment (it is kept as is) and the resource id pointing to it
+static int _memory_create_entry(oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
+{
+	memory_frag_entry *internal_record = (memory_frag_entry *) malloc(1 * sizeof(memory_frag_entry));
+	if (internal_record == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		return MEMORY_DEV_ERROR;
+	}
+	internal_record->record_set = frag_record;
+	internal_record->size = 0;
+	internal_record->spill_file = NULL;
+	internal_record->blocks = NULL;
+	internal_record->block_num = 0;
+	internal_record->image_size = 0;
+	internal_record->compressed_size = 0;
+	internal_record->last_access = time(NULL);
+	internal_record->compressible = 1;
+	internal_record->busy = 0;
+	internal_record->prev = internal_record->next = NULL;
+	oph_iostore_get_frag_recordset_size(frag_record, &(internal_record->size));
+
+	//Get resource id
+	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
+	if (*res_id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		free(internal_record);
+		return MEMORY_DEV_ERROR;
+	}
+
+	unsigned long long addr = (unsigned long long) internal_record;
+	(*res_id)->id_length = sizeof(unsigned long long);
+	(*res_id)->id = (void *) memdup(&addr, sizeof(unsigned long long));
+	if ((*res_id)->id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+		free(*res_id);
+		*res_id = NULL;
+		free(internal_record);
+		return MEMORY_DEV_ERROR;
+	}
+
+	return MEMORY_DEV_SUCCESS;
+}
 
 int _memory_setup(oph_iostore_handler * handle)
 {
@@ -36,6 +516,53 @@ int _memory_setup(oph_iostore_handler * handle)
 		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
 		return MEMORY_DEV_NULL_PARAM;
 	}
+	char spill = handle->memory_budget && handle->data_dir;
+#ifdef OPH_MEMORY_COMPRESSION
+	if (!spill && !handle->compression_delay)
+		return MEMORY_DEV_SUCCESS;
+#else
+	if (handle->compression_delay)
+		pmesg(LOG_WARNING, __FILE__, __LINE__, MEMORY_LOG_NO_COMPRESSION);
+	if (!spill)
+		return MEMORY_DEV_SUCCESS;
+#endif
+
+	pthread_mutex_lock(&memory_lock);
+	if (spill && !memory_spill_ready) {
+		if (mkdir(handle->data_dir, 0755) && errno != EEXIST) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_DIR_ERROR, handle->data_dir, strerror(errno));
+			logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_DIR_ERROR, handle->data_dir, strerror(errno));
+			pthread_mutex_unlock(&memory_lock);
+			return MEMORY_DEV_ERROR;
+		}
+		//Spill files left by a previous run belong to fragments that no longer exist
+		DIR *dir = opendir(handle->data_dir);
+		if (dir) {
+			struct dirent *item = NULL;
+			char file[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+			while ((item = readdir(dir))) {
+				if (strncmp(item->d_name, MEMORY_SPILL_PREFIX, strlen(MEMORY_SPILL_PREFIX)))
+					continue;
+				snprintf(file, OPH_IOSTORAGE_BUFLEN, "%s/%s", handle->data_dir, item->d_name);
+				unlink(file);
+			}
+			closedir(dir);
+		}
+		memory_spill_ready = 1;
+	}
+	if (!memory_running) {
+		memory_handle = handle;
+		memory_stop = 0;
+		if (pthread_create(&memory_tid, NULL, &_memory_housekeeper, NULL) != 0) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_THREAD_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_THREAD_ERROR);
+			pthread_mutex_unlock(&memory_lock);
+			return MEMORY_DEV_ERROR;
+		}
+		memory_running = 1;
+	}
+	pthread_mutex_unlock(&memory_lock);
+
 	return MEMORY_DEV_SUCCESS;
 }
 
@@ -46,6 +573,24 @@ int _memory_cleanup(oph_iostore_handler * handle)
 		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
 		return MEMORY_DEV_NULL_PARAM;
 	}
+
+	pthread_mutex_lock(&memory_lock);
+	if (!memory_running) {
+		pthread_mutex_unlock(&memory_lock);
+		return MEMORY_DEV_SUCCESS;
+	}
+	//A spill in progress is completed before the thread exits
+	memory_running = 0;
+	memory_stop = 1;
+	pthread_cond_signal(&memory_cond);
+	pthread_mutex_unlock(&memory_lock);
+
+	if (pthread_join(memory_tid, NULL) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_THREAD_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_THREAD_ERROR);
+		return MEMORY_DEV_ERROR;
+	}
+
 	return MEMORY_DEV_SUCCESS;
 }
 
@@ -135,26 +680,13 @@ int _memory_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * re
 
 int _memory_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record)
 {
-	if (!handle || !res_id || !res_id->id || !frag_record) {
+	if (!handle || !res_id || !frag_record) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
 		return MEMORY_DEV_NULL_PARAM;
 	}
 
-	*frag_record = NULL;
-
-	//Read resource id
-	oph_iostore_frag_record_set *internal_record = *((oph_iostore_frag_record_set **) res_id->id);
-
-	//Get in-memory copy of frag
-/*  if(_memory_copy_frag_record_set(internal_record, frag_record) || frag_record == NULL){
-    pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-    logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);        
-    return MEMORY_DEV_ERROR;
-  }*/
-	*frag_record = internal_record;
-
-	return MEMORY_DEV_SUCCESS;
+	return _memory_get_frags(handle, &res_id, 1, frag_record);
 }
 
 int _memory_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
@@ -165,56 +697,158 @@ int _memory_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set *
 		return MEMORY_DEV_NULL_PARAM;
 	}
 
-	*res_id = NULL;
+	return _memory_put_frags(handle, &frag_record, 1, res_id);
+}
+
+int _memory_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle || !res_id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+		return MEMORY_DEV_NULL_PARAM;
+	}
 
-	//Create in-memory copy of Fragment
-	oph_iostore_frag_record_set *internal_record = NULL;
-/*  if(_memory_copy_frag_record_set(frag_record, &internal_record) || internal_record == NULL){
-    pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-    logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);        
-    return MEMORY_DEV_ERROR;
-  }*/
-	internal_record = frag_record;
+	return _memory_delete_frags(handle, &res_id, 1);
+}
 
-	//Get resource id
-	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
-	if (*res_id == NULL) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-		return MEMORY_DEV_ERROR;
+int _memory_get_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num, oph_iostore_frag_record_set ** frag_records)
+{
+	if (!handle || !res_ids || !frag_records) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+		return MEMORY_DEV_NULL_PARAM;
 	}
 
-	unsigned long long addr = (unsigned long long) internal_record;
-	(*res_id)->id_length = sizeof(unsigned long long);
-	(*res_id)->id = (void *) memdup(&addr, sizeof(unsigned long long));
-	if ((*res_id)->id == NULL) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-		free(*res_id);
-		*res_id = NULL;
-		return MEMORY_DEV_ERROR;
+	int i, j;
+	for (i = 0; i < frag_num; i++) {
+		if (!res_ids[i] || !res_ids[i]->id) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+			logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+			return MEMORY_DEV_NULL_PARAM;
+		}
+		frag_records[i] = NULL;
 	}
 
+	pthread_mutex_lock(&memory_lock);
+
+	for (i = 0; i < frag_num; i++) {
+		//Read resource id
+		memory_frag_entry *entry = *((memory_frag_entry **) res_ids[i]->id);
+
+		if (_memory_fetch_frag(entry)) {
+			for (j = 0; j < i; j++)
+				oph_iostore_destroy_frag_recordset(&(frag_records[j]));
+			pthread_mutex_unlock(&memory_lock);
+			return MEMORY_DEV_ERROR;
+		}
+		//The reference keeps the fragment alive even if it is compressed or spilled while being read
+		oph_iostore_retain_frag_recordset(entry->record_set);
+		frag_records[i] = entry->record_set;
+	}
+
+	//Referenced fragments are skipped, so the ones just read stay in memory
+	_memory_wake_housekeeper(handle);
+
+	pthread_mutex_unlock(&memory_lock);
+
 	return MEMORY_DEV_SUCCESS;
 }
 
-
-int _memory_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+int _memory_put_frags(oph_iostore_handler * handle, oph_iostore_frag_record_set ** frag_records, int frag_num, oph_iostore_resource_id ** res_ids)
 {
-	if (!handle || !res_id || !res_id->id) {
+	if (!handle || !res_ids || !frag_records) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
 		return MEMORY_DEV_NULL_PARAM;
 	}
-	//Read resource id
-	oph_iostore_frag_record_set *internal_record = *((oph_iostore_frag_record_set **) res_id->id);
 
-	//Delete in-memory frag
-	if (oph_iostore_destroy_frag_recordset(&internal_record)) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
-		return MEMORY_DEV_ERROR;
+	int i;
+	for (i = 0; i < frag_num; i++) {
+		if (!frag_records[i]) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+			logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+			return MEMORY_DEV_NULL_PARAM;
+		}
+		res_ids[i] = NULL;
 	}
 
+	//Every entry is created before any fragment is inserted, so that on failure all of them are left to the caller
+	for (i = 0; i < frag_num; i++) {
+		if (_memory_create_entry(frag_records[i], &(res_ids[i]))) {
+			for (i--; i >= 0; i--) {
+				free(*((memory_frag_entry **) res_ids[i]->id));
+				free(res_ids[i]->id);
+				free(res_ids[i]);
+				res_ids[i] = NULL;
+			}
+			return MEMORY_DEV_ERROR;
+		}
+	}
+
+	memory_frag_entry *entry = NULL;
+
+	pthread_mutex_lock(&memory_lock);
+	for (i = 0; i < frag_num; i++) {
+		entry = *((memory_frag_entry **) res_ids[i]->id);
+		_memory_lru_push(entry);
+		memory_resident_size += entry->size;
+	}
+	_memory_wake_housekeeper(handle);
+	pthread_mutex_unlock(&memory_lock);
+
 	return MEMORY_DEV_SUCCESS;
 }
+
+int _memory_delete_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num)
+{
+	if (!handle || !res_ids) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+		return MEMORY_DEV_NULL_PARAM;
+	}
+
+	int i, res = MEMORY_DEV_SUCCESS;
+	for (i = 0; i < frag_num; i++) {
+		if (!res_ids[i] || !res_ids[i]->id) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+			logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_NULL_INPUT_PARAM);
+			return MEMORY_DEV_NULL_PARAM;
+		}
+	}
+
+	memory_frag_entry *internal_record = NULL;
+
+	//Delete in-memory (or compressed) frags, queries still reading them keep them alive
+	pthread_mutex_lock(&memory_lock);
+	for (i = 0; i < frag_num; i++) {
+		//Read resource id
+		internal_record = *((memory_frag_entry **) res_ids[i]->id);
+		while (internal_record->busy)
+			pthread_cond_wait(&memory_idle_cond, &memory_lock);
+		if (internal_record->record_set) {
+			_memory_lru_unlink(internal_record);
+			memory_resident_size -= internal_record->size;
+			if (oph_iostore_destroy_frag_recordset(&(internal_record->record_set))) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+				logging(LOG_ERROR, __FILE__, __LINE__, MEMORY_LOG_MEMORY_ERROR);
+				res = MEMORY_DEV_ERROR;
+			}
+		} else if (internal_record->blocks) {
+			_memory_lru_unlink(internal_record);
+			_memory_release_blocks(internal_record);
+		}
+	}
+	pthread_mutex_unlock(&memory_lock);
+
+	//Spill files are removed out of the lock
+	for (i = 0; i < frag_num; i++) {
+		internal_record = *((memory_frag_entry **) res_ids[i]->id);
+		if (internal_record->spill_file) {
+			unlink(internal_record->spill_file);
+			free(internal_record->spill_file);
+		}
+		free(internal_record);
+	}
+
+	return res;
+}
@@ -21,6 +21,8 @@
 
 #include "oph_iostorage_interface.h"
 
+#include <time.h>
+
 #define MEMORY_DEV_ERROR -1
 #define MEMORY_DEV_SUCCESS 0
 #define MEMORY_DEV_NULL_PARAM -2
@@ -28,17 +30,68 @@
 
 #define MEMORY_LOG_NULL_INPUT_PARAM "Null input parameter\n"
 #define MEMORY_LOG_MEMORY_ERROR	"Memory allocation error\n"
+#define MEMORY_LOG_SPILL_ERROR	"Unable to access spill file %s: %s\n"
+#define MEMORY_LOG_DIR_ERROR	"Unable to create spill directory %s: %s\n"
+#define MEMORY_LOG_COMPRESSION_ERROR	"Unable to compress fragment image\n"
+#define MEMORY_LOG_DECOMPRESSION_ERROR	"Unable to decompress fragment image\n"
+#define MEMORY_LOG_NO_COMPRESSION	"Fragment compression is not supported by this build\n"
+#define MEMORY_LOG_THREAD_ERROR	"Unable to start or stop memory device background thread\n"
+
+#define MEMORY_SPILL_PREFIX	"spill."
+#define MEMORY_SPILL_TEMPLATE	"%s/" MEMORY_SPILL_PREFIX "XXXXXX"
+
+#define MEMORY_COMPRESSION_BLOCK	1048576
+
+/**
+ * \brief               Structure describing a block of a compressed fragment image
+ * \param data          Compressed data
+ * \param length        Length of compressed data
+ */
+typedef struct {
+	char *data;
+	unsigned long length;
+} memory_compressed_block;
+
+/**
+ * \brief               Structure describing a fragment stored in memory device (the resource id of a fragment points to it)
+ * \param record_set    Fragment kept in memory (NULL if it has been compressed or spilled to disk)
+ * \param size          Memory footprint of the fragment
+ * \param spill_file    File containing the image of the fragment (NULL until it is spilled for the first time)
+ * \param blocks        Compressed image of the fragment, split in blocks of MEMORY_COMPRESSION_BLOCK bytes (NULL unless it is compressed)
+ * \param block_num     Number of compressed blocks
+ * \param image_size    Size of the uncompressed image
+ * \param compressed_size Memory footprint of the compressed image
+ * \param last_access   Time of the last access to the fragment
+ * \param compressible  Flag set to 0 when compression does not reduce the footprint of the fragment
+ * \param busy          Flag set while the image of the fragment is being compressed or written by the background thread
+ * \param prev          Previous (more recently used) fragment kept in memory
+ * \param next          Next (less recently used) fragment kept in memory
+ */
+typedef struct _memory_frag_entry {
+	oph_iostore_frag_record_set *record_set;
+	unsigned long long size;
+	char *spill_file;
+	memory_compressed_block *blocks;
+	unsigned int block_num;
+	unsigned long long image_size;
+	unsigned long long compressed_size;
+	time_t last_access;
+	char compressible;
+	char busy;
+	struct _memory_frag_entry *prev;
+	struct _memory_frag_entry *next;
+} memory_frag_entry;
 
 
 /**
- * \brief               Function to initialize memory device library. 
+ * \brief               Function to initialize memory device library (when a memory budget or a compression delay is set, it prepares the spill directory and starts the thread compressing and spilling fragments). 
  * \param handle        Address to pointer for dynamic device plugin handle
  * \return              0 if successfull, non-0 otherwise
  */
 int _memory_setup(oph_iostore_handler * handle);
 
 /**
- * \brief               Function to finalize library of memory device and release all dynamic loading resources.
+ * \brief               Function to finalize library of memory device, stop its background thread and release all dynamic loading resources.
  * \param handle        Dynamic I/O storage plugin handle
  * \return              0 if successfull, non-0 otherwise
  */
@@ -71,18 +124,20 @@ int _memory_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_
 int _memory_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
 
 /**
- * \brief               Function to retrieve a fragment record from memory device
+ * \brief               Function to retrieve a fragment record from memory device. A compressed fragment is decompressed and a spilled
+ *                      fragment is mapped back in memory; then a background thread compresses cold fragments and, if the memory budget
+ *                      is exceeded, spills the least recently used fragments.
  * \param handle        Dynamic I/O storage plugin handle
  * \param res_id        ID of resource being fetched
- * \param db_record     Record containing a copy of a fragment (it should be deleted)
+ * \param db_record     Reference to the fragment (it should be deleted)
  * \return              0 if successfull, non-0 otherwise
  */
 int _memory_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
 
 /**
- * \brief               Function to insert a fragment record into memory device
+ * \brief               Function to insert a fragment record into memory device (other fragments may be compressed or spilled)
  * \param handle        Dynamic I/O storage plugin handle
- * \param db_record     Record containing a fragment (it should be copied into the memory device)
+ * \param db_record     Record containing a fragment (it is owned by the memory device)
  * \param res_id        ID of resource created
  * \return              0 if successfull, non-0 otherwise
  */
@@ -96,4 +151,33 @@ int _memory_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set *
  */
 int _memory_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
 
+/**
+ * \brief               Function to retrieve several fragment records from memory device, holding the device lock only once
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_ids       IDs of resources being fetched
+ * \param frag_num      Number of resources
+ * \param frag_records  References to the fragments (they should be deleted)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _memory_get_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num, oph_iostore_frag_record_set ** frag_records);
+
+/**
+ * \brief               Function to insert several fragment records into memory device, holding the device lock only once
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param frag_records  Records containing the fragments (they are owned by the memory device only in case of success)
+ * \param frag_num      Number of fragments
+ * \param res_ids       IDs of resources created
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _memory_put_frags(oph_iostore_handler * handle, oph_iostore_frag_record_set ** frag_records, int frag_num, oph_iostore_resource_id ** res_ids);
+
+/**
+ * \brief               Function to delete several fragments from a memory device, holding the device lock only once
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_ids       IDs of resources to delete
+ * \param frag_num      Number of resources
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _memory_delete_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num);
+
 #endif				//__MEMORY_DEVICE_H
@@ -0,0 +1,281 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+#include "MMAP_device.h"
+
+#include "oph_server_utility.h"
+
+#include <unistd.h>
+#include "debug.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+
+int _mmap_setup(oph_iostore_handler * handle)
+{
+	if (!handle || !handle->data_dir) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+
+	if (mkdir(handle->data_dir, 0755) && errno != EEXIST) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_DIR_ERROR, handle->data_dir, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_DIR_ERROR, handle->data_dir, strerror(errno));
+		return MMAP_DEV_ERROR;
+	}
+
+	return MMAP_DEV_SUCCESS;
+}
+
+int _mmap_cleanup(oph_iostore_handler * handle)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+	return MMAP_DEV_SUCCESS;
+}
+
+int _mmap_get_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record)
+{
+	if (!handle || !res_id || !res_id->id || !db_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+
+	*db_record = NULL;
+
+	//DBs are only described by the MetaDB: build a copy from resource id
+	*db_record = (oph_iostore_db_record_set *) malloc(1 * sizeof(oph_iostore_db_record_set));
+	if (*db_record == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		return MMAP_DEV_ERROR;
+	}
+
+	(*db_record)->db_name = (char *) strndup(res_id->id, res_id->id_length - strlen(handle->device) - 1);
+	if ((*db_record)->db_name == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		free(*db_record);
+		*db_record = NULL;
+		return MMAP_DEV_ERROR;
+	}
+
+	return MMAP_DEV_SUCCESS;
+}
+
+int _mmap_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id)
+{
+	if (!handle || !res_id || !db_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+
+	*res_id = NULL;
+
+	//Get resource id
+	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
+	if (*res_id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		return MMAP_DEV_ERROR;
+	}
+
+	(*res_id)->id_length = strlen(db_record->db_name) + strlen(handle->device) + 1;
+	(*res_id)->id = (void *) calloc((*res_id)->id_length, sizeof(char));
+	if ((*res_id)->id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		free(*res_id);
+		*res_id = NULL;
+		return MMAP_DEV_ERROR;
+	}
+	snprintf((*res_id)->id, strlen(db_record->db_name) + strlen(handle->device) + 1, "%s%s", db_record->db_name, handle->device);
+
+	return MMAP_DEV_SUCCESS;
+}
+
+int _mmap_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle || !res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+	//Fragment files are removed one by one (nothing to do)
+	;
+
+	return MMAP_DEV_SUCCESS;
+}
+
+int _mmap_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record)
+{
+	if (!handle || !handle->data_dir || !res_id || !res_id->id || !frag_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+
+	*frag_record = NULL;
+
+	//Map fragment file
+	char file[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	snprintf(file, OPH_IOSTORAGE_BUFLEN, MMAP_FRAG_FILE, handle->data_dir, (char *) res_id->id);
+
+	int fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		return MMAP_DEV_ERROR;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || (unsigned long long) st.st_size < sizeof(oph_iostore_frag_image_header)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FORMAT_ERROR, file);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FORMAT_ERROR, file);
+		close(fd);
+		return MMAP_DEV_ERROR;
+	}
+	unsigned long long map_size = (unsigned long long) st.st_size;
+	char *map = (char *) mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		return MMAP_DEV_ERROR;
+	}
+
+	//Columns are used in place
+	oph_iostore_frag_record_set *internal_record = NULL;
+	if (oph_iostore_map_frag_image(map, map_size, map, map_size, &internal_record)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FORMAT_ERROR, file);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FORMAT_ERROR, file);
+		munmap(map, map_size);
+		return MMAP_DEV_ERROR;
+	}
+
+	*frag_record = internal_record;
+
+	return MMAP_DEV_SUCCESS;
+}
+
+int _mmap_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
+{
+	if (!handle || !handle->data_dir || !res_id || !frag_record || !frag_record->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+
+	*res_id = NULL;
+
+	const char *frag_name = frag_record->frag_name ? frag_record->frag_name : "";
+	unsigned long long file_size = 0;
+	if (oph_iostore_get_frag_image_size(frag_record, &file_size))
+		return MMAP_DEV_ERROR;
+
+	//Create a new fragment file
+	char file[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	snprintf(file, OPH_IOSTORAGE_BUFLEN, MMAP_FRAG_TEMPLATE, handle->data_dir, frag_name);
+	int fd = mkstemp(file);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		return MMAP_DEV_ERROR;
+	}
+	char *map = MAP_FAILED;
+	if (!ftruncate(fd, (off_t) file_size))
+		map = (char *) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		unlink(file);
+		return MMAP_DEV_ERROR;
+	}
+
+	if (oph_iostore_write_frag_image(frag_record, map, file_size)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FORMAT_ERROR, file);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FORMAT_ERROR, file);
+		munmap(map, file_size);
+		unlink(file);
+		return MMAP_DEV_ERROR;
+	}
+	if (munmap(map, file_size)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		unlink(file);
+		return MMAP_DEV_ERROR;
+	}
+
+	//Resource id is the name of the file within device directory
+	const char *file_name = strrchr(file, '/') + 1;
+	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
+	if (*res_id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		unlink(file);
+		return MMAP_DEV_ERROR;
+	}
+
+	(*res_id)->id_length = strlen(file_name) + 1;
+	(*res_id)->id = (void *) memdup(file_name, (*res_id)->id_length);
+	if ((*res_id)->id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_MEMORY_ERROR);
+		free(*res_id);
+		*res_id = NULL;
+		unlink(file);
+		return MMAP_DEV_ERROR;
+	}
+
+	return MMAP_DEV_SUCCESS;
+}
+
+
+int _mmap_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle || !handle->data_dir || !res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_NULL_INPUT_PARAM);
+		return MMAP_DEV_NULL_PARAM;
+	}
+
+	//Record sets still mapping the file keep its content until they are destroyed
+	char file[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	snprintf(file, OPH_IOSTORAGE_BUFLEN, MMAP_FRAG_FILE, handle->data_dir, (char *) res_id->id);
+	if (unlink(file)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, MMAP_LOG_FILE_ERROR, file, strerror(errno));
+		return MMAP_DEV_ERROR;
+	}
+
+	return MMAP_DEV_SUCCESS;
+}
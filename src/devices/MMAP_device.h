@@ -0,0 +1,105 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __MMAP_DEVICE_H
+#define __MMAP_DEVICE_H
+
+#include "oph_iostorage_interface.h"
+
+#define MMAP_DEV_ERROR -1
+#define MMAP_DEV_SUCCESS 0
+#define MMAP_DEV_NULL_PARAM -2
+#define MMAP_DEV_MEMORY_ERROR -3
+
+#define MMAP_LOG_NULL_INPUT_PARAM "Null input parameter\n"
+#define MMAP_LOG_MEMORY_ERROR	"Memory allocation error\n"
+#define MMAP_LOG_FILE_ERROR	"Unable to access fragment file %s: %s\n"
+#define MMAP_LOG_FORMAT_ERROR	"Fragment file %s is corrupted\n"
+#define MMAP_LOG_DIR_ERROR	"Unable to create device directory %s: %s\n"
+
+#define MMAP_FRAG_FILE		"%s/%s"
+#define MMAP_FRAG_TEMPLATE	"%s/%s.XXXXXX"
+
+/**
+ * \brief               Function to initialize mmap device library (it creates the directory of the fragment files). 
+ * \param handle        Address to pointer for dynamic device plugin handle
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_setup(oph_iostore_handler * handle);
+
+/**
+ * \brief               Function to finalize library of mmap device and release all dynamic loading resources.
+ * \param handle        Dynamic I/O storage plugin handle
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_cleanup(oph_iostore_handler * handle);
+
+/**
+ * \brief               Function to retrieve a DB record from mmap device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource being fetched
+ * \param db_record     Record containing a copy of a DB (it should be deleted)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_get_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
+
+/**
+ * \brief               Function to insert a DB record into mmap device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param db_record     Record containing a DB
+ * \param res_id        ID of resource created
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
+
+/**
+ * \brief               Function to delete a DB from a mmap device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource to delete
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+
+/**
+ * \brief               Function to retrieve a fragment record from mmap device. The fragment file is mapped in memory and
+ *                      its columns are used in place; the mapping is released when the record set is destroyed.
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource being fetched
+ * \param frag_record   Columnar record set backed by the fragment file (it should be deleted)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
+
+/**
+ * \brief               Function to write a fragment record into a new file of the mmap device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param frag_record   Record containing a fragment (any layout; it is not modified)
+ * \param res_id        ID of resource created (name of the fragment file)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
+
+/**
+ * \brief               Function to delete a fragment file from a mmap device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource to delete
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _mmap_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+
+#endif				//__MMAP_DEVICE_H
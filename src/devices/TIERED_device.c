@@ -0,0 +1,518 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+#include "TIERED_device.h"
+
+#include "oph_server_utility.h"
+
+#include <unistd.h>
+#include "debug.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+//Fragments of the hot tier grouped by access counter (each group is a circular list, from the oldest to the most recent fragment) and their overall footprint
+static pthread_mutex_t tiered_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tiered_cond = PTHREAD_COND_INITIALIZER;
+static tiered_frag_entry tiered_hot[TIERED_HOT_LEVELS];
+static unsigned long long tiered_hot_size = 0;
+static unsigned long long tiered_clock = 0;
+static unsigned long long tiered_epoch = 0;
+static char tiered_ready = 0;
+
+//Access counter of a fragment, aged by the decay periods elapsed since its last update
+static unsigned long long _tiered_hits(tiered_frag_entry * entry)
+{
+	unsigned long long periods = tiered_epoch - entry->epoch;
+	entry->hits = periods >= 64 ? 0 : entry->hits >> periods;
+	entry->epoch = tiered_epoch;
+	return entry->hits;
+}
+
+static void _tiered_hot_unlink(tiered_frag_entry * entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+//Append a fragment to the group of its access counter
+static void _tiered_hot_append(tiered_frag_entry * entry)
+{
+	tiered_frag_entry *level = &(tiered_hot[_tiered_hits(entry)]);
+	entry->next = level;
+	entry->prev = level->prev;
+	level->prev->next = entry;
+	level->prev = entry;
+}
+
+static void _tiered_hot_push(tiered_frag_entry * entry)
+{
+	_tiered_hot_append(entry);
+	tiered_hot_size += entry->size;
+}
+
+//Halve the access counters of the hot tier by merging each group into the one of half its counter (counters of single fragments are aged lazily)
+static void _tiered_hot_decay()
+{
+	unsigned int i;
+	tiered_frag_entry *from = NULL, *to = NULL;
+	for (i = 1; i < TIERED_HOT_LEVELS; i++) {
+		from = &(tiered_hot[i]);
+		if (from->next == from)
+			continue;
+		to = &(tiered_hot[i >> 1]);
+		from->next->prev = to->prev;
+		to->prev->next = from->next;
+		from->prev->next = to;
+		to->prev = from->prev;
+		from->next = from->prev = from;
+	}
+}
+
+static void _tiered_count_access(tiered_frag_entry * entry)
+{
+	if (!(++tiered_clock % TIERED_DECAY_PERIOD)) {
+		tiered_epoch++;
+		_tiered_hot_decay();
+	}
+	//Fragments of the hot tier move to the next group
+	char is_hot = entry->prev != NULL;
+	if (is_hot)
+		_tiered_hot_unlink(entry);
+	entry->hits = _tiered_hits(entry) + 1;
+	if (is_hot)
+		_tiered_hot_append(entry);
+}
+
+//Map a cold tier file; a private copy is read in anonymous memory when the fragment is promoted
+static int _tiered_map_file(const char *file, char in_memory, oph_iostore_frag_record_set ** record_set)
+{
+	int fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		return TIERED_DEV_ERROR;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || (unsigned long long) st.st_size < sizeof(oph_iostore_frag_image_header)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FORMAT_ERROR, file);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FORMAT_ERROR, file);
+		close(fd);
+		return TIERED_DEV_ERROR;
+	}
+	unsigned long long map_size = (unsigned long long) st.st_size;
+	char *map = MAP_FAILED;
+	if (!in_memory)
+		map = (char *) mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+	else if ((map = (char *) mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED) {
+		oph_iostore_mem_advise(map, map_size, oph_iostore_mem_get_node());
+		unsigned long long offset = 0;
+		ssize_t n = 0;
+		while (offset < map_size && (n = pread(fd, map + offset, map_size - offset, (off_t) offset)) > 0)
+			offset += n;
+		if (offset < map_size) {
+			munmap(map, map_size);
+			map = MAP_FAILED;
+		}
+	}
+	close(fd);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		return TIERED_DEV_ERROR;
+	}
+
+	if (oph_iostore_map_frag_image(map, map_size, map, map_size, record_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FORMAT_ERROR, file);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FORMAT_ERROR, file);
+		munmap(map, map_size);
+		return TIERED_DEV_ERROR;
+	}
+	if (in_memory)
+		(*record_set)->numa_node = oph_iostore_mem_get_node();
+
+	return TIERED_DEV_SUCCESS;
+}
+
+//Write the image of a fragment in a new cold tier file
+static int _tiered_write_file(oph_iostore_handler * handle, oph_iostore_frag_record_set * record_set, char **cold_file)
+{
+	unsigned long long file_size = 0;
+	if (oph_iostore_get_frag_image_size(record_set, &file_size))
+		return TIERED_DEV_ERROR;
+
+	char file[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	snprintf(file, OPH_IOSTORAGE_BUFLEN, TIERED_COLD_TEMPLATE, handle->data_dir);
+	int fd = mkstemp(file);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		return TIERED_DEV_ERROR;
+	}
+	char *map = MAP_FAILED;
+	if (!ftruncate(fd, (off_t) file_size))
+		map = (char *) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		unlink(file);
+		return TIERED_DEV_ERROR;
+	}
+	int res = oph_iostore_write_frag_image(record_set, map, file_size);
+	if (munmap(map, file_size) || res || !(*cold_file = (char *) strdup(file))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_FILE_ERROR, file, strerror(errno));
+		unlink(file);
+		return TIERED_DEV_ERROR;
+	}
+
+	return TIERED_DEV_SUCCESS;
+}
+
+//Move a fragment to the cold tier: its image is written only once, since fragments are never modified (tiered_lock is released while writing)
+static int _tiered_demote_frag(oph_iostore_handler * handle, tiered_frag_entry * entry)
+{
+	if (!entry->cold_file) {
+		//The reference keeps the fragment alive, while the busy flag prevents it from being demoted twice or deleted
+		oph_iostore_frag_record_set *record_set = entry->record_set;
+		char *cold_file = NULL;
+		oph_iostore_retain_frag_recordset(record_set);
+		entry->busy = 1;
+		pthread_mutex_unlock(&tiered_lock);
+
+		int res = _tiered_write_file(handle, record_set, &cold_file);
+		oph_iostore_destroy_frag_recordset(&record_set);
+
+		pthread_mutex_lock(&tiered_lock);
+		entry->busy = 0;
+		pthread_cond_broadcast(&tiered_cond);
+		if (res)
+			return TIERED_DEV_ERROR;
+		entry->cold_file = cold_file;
+
+		//The fragment is being read meanwhile, so it is kept in the hot tier (its file is ready for a later demotion)
+		if (entry->record_set->ref_count > 1)
+			return TIERED_DEV_SUCCESS;
+	}
+
+	_tiered_hot_unlink(entry);
+	tiered_hot_size -= entry->size;
+	oph_iostore_destroy_frag_recordset(&(entry->record_set));
+
+	return TIERED_DEV_SUCCESS;
+}
+
+//Least frequently accessed fragment not being read by any query (on equal counters the oldest one is chosen), except the one just accessed
+static tiered_frag_entry *_tiered_hot_victim(tiered_frag_entry * current)
+{
+	unsigned int i;
+	tiered_frag_entry *entry = NULL;
+	for (i = 0; i < TIERED_HOT_LEVELS; i++)
+		for (entry = tiered_hot[i].next; entry != &(tiered_hot[i]); entry = entry->next)
+			if (entry != current && !entry->busy && entry->record_set->ref_count == 1)
+				return entry;
+	return NULL;
+}
+
+//Demote fragments until the memory budget is respected
+static void _tiered_check_budget(oph_iostore_handler * handle, tiered_frag_entry * current)
+{
+	if (!handle->memory_budget)
+		return;
+
+	tiered_frag_entry *victim = NULL;
+	while (tiered_hot_size > handle->memory_budget) {
+		victim = _tiered_hot_victim(current);
+		if (!victim || _tiered_demote_frag(handle, victim))
+			break;
+	}
+}
+
+int _tiered_setup(oph_iostore_handler * handle)
+{
+	if (!handle || !handle->data_dir) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+	if (!handle->memory_budget)
+		pmesg(LOG_WARNING, __FILE__, __LINE__, TIERED_LOG_NO_BUDGET);
+
+	pthread_mutex_lock(&tiered_lock);
+	if (!tiered_ready) {
+		unsigned int i;
+		for (i = 0; i < TIERED_HOT_LEVELS; i++)
+			tiered_hot[i].next = tiered_hot[i].prev = &(tiered_hot[i]);
+		if (mkdir(handle->data_dir, 0755) && errno != EEXIST) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_DIR_ERROR, handle->data_dir, strerror(errno));
+			logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_DIR_ERROR, handle->data_dir, strerror(errno));
+			pthread_mutex_unlock(&tiered_lock);
+			return TIERED_DEV_ERROR;
+		}
+		//The device is transient: cold tier files left by a previous run belong to fragments that no longer exist
+		DIR *dir = opendir(handle->data_dir);
+		if (dir) {
+			struct dirent *item = NULL;
+			char file[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+			while ((item = readdir(dir))) {
+				if (strncmp(item->d_name, TIERED_COLD_PREFIX, strlen(TIERED_COLD_PREFIX)))
+					continue;
+				snprintf(file, OPH_IOSTORAGE_BUFLEN, "%s/%s", handle->data_dir, item->d_name);
+				unlink(file);
+			}
+			closedir(dir);
+		}
+		tiered_ready = 1;
+	}
+	pthread_mutex_unlock(&tiered_lock);
+
+	return TIERED_DEV_SUCCESS;
+}
+
+int _tiered_cleanup(oph_iostore_handler * handle)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+	return TIERED_DEV_SUCCESS;
+}
+
+int _tiered_get_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record)
+{
+	if (!handle || !res_id || !res_id->id || !db_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+
+	*db_record = NULL;
+
+	//DBs are only described by the MetaDB: build a copy from resource id
+	*db_record = (oph_iostore_db_record_set *) malloc(1 * sizeof(oph_iostore_db_record_set));
+	if (*db_record == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		return TIERED_DEV_ERROR;
+	}
+
+	(*db_record)->db_name = (char *) strndup(res_id->id, res_id->id_length - strlen(handle->device) - 1);
+	if ((*db_record)->db_name == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		free(*db_record);
+		*db_record = NULL;
+		return TIERED_DEV_ERROR;
+	}
+
+	return TIERED_DEV_SUCCESS;
+}
+
+int _tiered_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id)
+{
+	if (!handle || !res_id || !db_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+
+	*res_id = NULL;
+
+	//Get resource id
+	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
+	if (*res_id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		return TIERED_DEV_ERROR;
+	}
+
+	(*res_id)->id_length = strlen(db_record->db_name) + strlen(handle->device) + 1;
+	(*res_id)->id = (void *) calloc((*res_id)->id_length, sizeof(char));
+	if ((*res_id)->id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		free(*res_id);
+		*res_id = NULL;
+		return TIERED_DEV_ERROR;
+	}
+	snprintf((*res_id)->id, strlen(db_record->db_name) + strlen(handle->device) + 1, "%s%s", db_record->db_name, handle->device);
+
+	return TIERED_DEV_SUCCESS;
+}
+
+int _tiered_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle || !res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+	//Fragments are removed one by one (nothing to do)
+	;
+
+	return TIERED_DEV_SUCCESS;
+}
+
+int _tiered_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record)
+{
+	if (!handle || !res_id || !res_id->id || !frag_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+
+	*frag_record = NULL;
+
+	//Read resource id
+	tiered_frag_entry *entry = *((tiered_frag_entry **) res_id->id);
+
+	pthread_mutex_lock(&tiered_lock);
+	_tiered_count_access(entry);
+
+	if (entry->record_set == NULL) {
+		//Fragments not accessed frequently (or being promoted by another query) are read from the cold tier without being promoted
+		if (entry->hits < TIERED_PROMOTE_HITS || entry->busy) {
+			pthread_mutex_unlock(&tiered_lock);
+			return _tiered_map_file(entry->cold_file, 0, frag_record);
+		}
+		//The file is read out of the lock, while the busy flag prevents the fragment from being promoted twice or deleted
+		oph_iostore_frag_record_set *record_set = NULL;
+		entry->busy = 1;
+		pthread_mutex_unlock(&tiered_lock);
+
+		int res = _tiered_map_file(entry->cold_file, 1, &record_set);
+
+		pthread_mutex_lock(&tiered_lock);
+		entry->busy = 0;
+		pthread_cond_broadcast(&tiered_cond);
+		if (res) {
+			pthread_mutex_unlock(&tiered_lock);
+			return TIERED_DEV_ERROR;
+		}
+		entry->record_set = record_set;
+		_tiered_hot_push(entry);
+	}
+	//The reference keeps the fragment alive even if it is demoted while being read
+	oph_iostore_retain_frag_recordset(entry->record_set);
+	*frag_record = entry->record_set;
+
+	_tiered_check_budget(handle, entry);
+	pthread_mutex_unlock(&tiered_lock);
+
+	return TIERED_DEV_SUCCESS;
+}
+
+int _tiered_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
+{
+	if (!handle || !res_id || !frag_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+
+	*res_id = NULL;
+
+	tiered_frag_entry *internal_record = (tiered_frag_entry *) calloc(1, sizeof(tiered_frag_entry));
+	if (internal_record == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		return TIERED_DEV_ERROR;
+	}
+	internal_record->record_set = frag_record;
+	oph_iostore_get_frag_recordset_size(frag_record, &(internal_record->size));
+
+	//Get resource id: it points to the entry, which is kept in both tiers
+	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
+	if (*res_id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		free(internal_record);
+		return TIERED_DEV_ERROR;
+	}
+
+	unsigned long long addr = (unsigned long long) internal_record;
+	(*res_id)->id_length = sizeof(unsigned long long);
+	(*res_id)->id = (void *) memdup(&addr, sizeof(unsigned long long));
+	if ((*res_id)->id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+		free(*res_id);
+		*res_id = NULL;
+		free(internal_record);
+		return TIERED_DEV_ERROR;
+	}
+
+	//New fragments start in the hot tier
+	pthread_mutex_lock(&tiered_lock);
+	_tiered_count_access(internal_record);
+	_tiered_hot_push(internal_record);
+	_tiered_check_budget(handle, internal_record);
+	pthread_mutex_unlock(&tiered_lock);
+
+	return TIERED_DEV_SUCCESS;
+}
+
+int _tiered_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle || !res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_NULL_INPUT_PARAM);
+		return TIERED_DEV_NULL_PARAM;
+	}
+
+	int res = TIERED_DEV_SUCCESS;
+
+	//Read resource id
+	tiered_frag_entry *internal_record = *((tiered_frag_entry **) res_id->id);
+
+	//Queries still reading the fragment keep it alive
+	pthread_mutex_lock(&tiered_lock);
+	while (internal_record->busy)
+		pthread_cond_wait(&tiered_cond, &tiered_lock);
+	if (internal_record->record_set) {
+		_tiered_hot_unlink(internal_record);
+		tiered_hot_size -= internal_record->size;
+		if (oph_iostore_destroy_frag_recordset(&(internal_record->record_set))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, TIERED_LOG_MEMORY_ERROR);
+			res = TIERED_DEV_ERROR;
+		}
+	}
+	pthread_mutex_unlock(&tiered_lock);
+
+	//Mappings of the cold tier file keep its content until they are released
+	if (internal_record->cold_file) {
+		unlink(internal_record->cold_file);
+		free(internal_record->cold_file);
+	}
+	free(internal_record);
+
+	return res;
+}
@@ -0,0 +1,136 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TIERED_DEVICE_H
+#define __TIERED_DEVICE_H
+
+#include "oph_iostorage_interface.h"
+
+#define TIERED_DEV_ERROR -1
+#define TIERED_DEV_SUCCESS 0
+#define TIERED_DEV_NULL_PARAM -2
+#define TIERED_DEV_MEMORY_ERROR -3
+
+#define TIERED_LOG_NULL_INPUT_PARAM "Null input parameter\n"
+#define TIERED_LOG_MEMORY_ERROR	"Memory allocation error\n"
+#define TIERED_LOG_FILE_ERROR	"Unable to access cold tier file %s: %s\n"
+#define TIERED_LOG_FORMAT_ERROR	"Cold tier file %s is corrupted\n"
+#define TIERED_LOG_DIR_ERROR	"Unable to create cold tier directory %s: %s\n"
+#define TIERED_LOG_NO_BUDGET	"No memory budget is set: every fragment of tiered device is kept in memory\n"
+
+#define TIERED_COLD_PREFIX	"tier."
+#define TIERED_COLD_TEMPLATE	"%s/" TIERED_COLD_PREFIX "XXXXXX"
+
+//Number of accesses to a cold fragment (within the current period) that promote it to the hot tier
+#define TIERED_PROMOTE_HITS	2
+//Number of accesses to the device after which the access counters of all fragments are halved
+#define TIERED_DECAY_PERIOD	1024
+//Number of groups of the hot tier: access counters never exceed twice the decay period, since they are halved at the end of each period
+#define TIERED_HOT_LEVELS	(2 * TIERED_DECAY_PERIOD + 1)
+
+/**
+ * \brief               Structure describing a fragment stored in tiered device (the resource id of a fragment points to it, so it does not change when the fragment moves between tiers)
+ * \param record_set    Fragment kept in the hot tier (NULL if it is in the cold tier only)
+ * \param size          Memory footprint of the fragment
+ * \param cold_file     File containing the image of the fragment (NULL until it is demoted for the first time)
+ * \param hits          Access counter, halved every TIERED_DECAY_PERIOD accesses to the device
+ * \param epoch         Decay period in which hits was last updated
+ * \param busy          Flag set while the fragment is being written to or read from its cold tier file
+ * \param prev          Previous (older) fragment of the hot tier with the same access counter (NULL in the cold tier)
+ * \param next          Next (more recent) fragment of the hot tier with the same access counter (NULL in the cold tier)
+ */
+typedef struct _tiered_frag_entry {
+	oph_iostore_frag_record_set *record_set;
+	unsigned long long size;
+	char *cold_file;
+	unsigned long long hits;
+	unsigned long long epoch;
+	char busy;
+	struct _tiered_frag_entry *prev;
+	struct _tiered_frag_entry *next;
+} tiered_frag_entry;
+
+/**
+ * \brief               Function to initialize tiered device library (it prepares the directory of the cold tier). 
+ * \param handle        Address to pointer for dynamic device plugin handle
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_setup(oph_iostore_handler * handle);
+
+/**
+ * \brief               Function to finalize library of tiered device and release all dynamic loading resources.
+ * \param handle        Dynamic I/O storage plugin handle
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_cleanup(oph_iostore_handler * handle);
+
+/**
+ * \brief               Function to retrieve a DB record from tiered device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource being fetched
+ * \param db_record     Record containing a copy of a DB (it should be deleted)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_get_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
+
+/**
+ * \brief               Function to insert a DB record into tiered device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param db_record     Record containing a DB
+ * \param res_id        ID of resource created
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
+
+/**
+ * \brief               Function to delete a DB from a tiered device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource to delete
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+
+/**
+ * \brief               Function to retrieve a fragment record from tiered device. Each access is counted: a cold fragment accessed
+ *                      TIERED_PROMOTE_HITS times is promoted to the hot tier, otherwise its file is only mapped for the caller.
+ *                      Then the least frequently accessed fragments are demoted until the memory budget is respected.
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource being fetched
+ * \param frag_record   Reference to the fragment (it should be deleted)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
+
+/**
+ * \brief               Function to insert a fragment record into the hot tier of tiered device (other fragments may be demoted)
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param frag_record   Record containing a fragment (it is owned by the tiered device)
+ * \param res_id        ID of resource created
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
+
+/**
+ * \brief               Function to delete a fragment from both tiers of a tiered device
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_id        ID of resource to delete
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _tiered_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+
+#endif				//__TIERED_DEVICE_H
@@ -103,6 +103,7 @@ int main()
 	}
 
 	printf("Retrieved Frag has %s field\n", frag_record1->field_name[0]);
+	oph_iostore_destroy_frag_recordset(&frag_record1);
 
 	if (oph_iostore_delete_frag(dev_handle, res_id) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to delete frag from device\n");
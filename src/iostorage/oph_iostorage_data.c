@@ -25,7 +25,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <ctype.h>
+#include <math.h>
+#include <sched.h>
+#ifdef OPH_IOSTORE_NUMA
+#include <numa.h>
+#endif
 
 #include <debug.h>
 
@@ -104,6 +111,9 @@ int oph_iostore_copy_frag_record(oph_iostore_frag_record * input_record, unsigne
 	return OPH_IOSTORAGE_SUCCESS;
 }
 
+static int _oph_iostore_build_column_views(oph_iostore_frag_record_set * record_set, unsigned long long first, unsigned long long row_num, oph_iostore_frag_record ** view);
+static void _oph_iostore_free_column_views(oph_iostore_frag_record ** view);
+
 int oph_iostore_copy_frag_record_set(oph_iostore_frag_record_set * input_record_set, oph_iostore_frag_record_set ** output_record_set)
 {
 	return oph_iostore_copy_frag_record_set_limit(input_record_set, output_record_set, 0, 0);
@@ -124,31 +134,95 @@ int oph_iostore_copy_frag_record_set_limit(oph_iostore_frag_record_set * input_r
 		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
 
-	long long j, total_size = 0, set_size = 0;
-	oph_iostore_frag_record *tmp_record = NULL;
-	if (offset) {
-		tmp_record = input_record_set->record_set[0];
-		while (tmp_record)
-			tmp_record = input_record_set->record_set[++total_size];
+	oph_iostore_frag_record_set *output = *output_record_set;
+	long long j, total_size = oph_iostore_get_frag_row_num(input_record_set), set_size = 0;
+	if (offset < total_size)
+		set_size = (limit && (limit < total_size - offset)) ? limit : total_size - offset;
+
+	//Cells are not copied: the copy references the cells of the input, which is kept alive until the copy is destroyed
+	_oph_iostore_free_column_views(&(output->view));
+	output->id_base = NULL;
+	if (!set_size) {
+		output->id_field = -1;
+		output->id_start = 0;
+		return OPH_IOSTORAGE_SUCCESS;
 	}
-	if (!offset || (offset < total_size)) {
-		tmp_record = input_record_set->record_set[offset];
-		while (tmp_record && (!limit || (set_size < limit)))
-			tmp_record = input_record_set->record_set[++set_size];
+	if (oph_iostore_share_frag_recordset(output, input_record_set->origin ? input_record_set->origin : input_record_set)) {
+		oph_iostore_destroy_frag_recordset(output_record_set);
+		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
 
-	if (set_size != 0) {
-		oph_iostore_frag_record **new = (*output_record_set)->record_set;
-		for (j = 0; j < set_size; j++) {
-			if (oph_iostore_copy_frag_record(input_record_set->record_set[j], input_record_set->field_num, &new[j]) || !new[j]) {
+	unsigned short i;
+	if (input_record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+		//Columns of the copy point at the selected range of the input columns; only offsets are rebased
+		free(output->record_set);
+		output->record_set = NULL;
+		output->layout = OPH_IOSTORE_COLUMN_LAYOUT;
+		output->row_num = set_size;
+		output->origin = NULL;
+		output->column = (oph_iostore_frag_column *) calloc(output->field_num, sizeof(oph_iostore_frag_column));
+		if (!output->column) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			oph_iostore_destroy_frag_recordset(output_record_set);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+		unsigned long long base;
+		for (i = 0; i < output->field_num; i++) {
+			output->column[i].cell_num = set_size;
+			if (OPH_IOSTORE_IS_IMPLICIT_ID(input_record_set, i))
+				continue;
+			output->column[i].offset = (unsigned long long *) malloc((set_size + 1) * sizeof(unsigned long long));
+			if (!output->column[i].offset) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 				oph_iostore_destroy_frag_recordset(output_record_set);
 				return OPH_IOSTORAGE_MEMORY_ERR;
 			}
+			base = input_record_set->column[i].offset[offset];
+			for (j = 0; j <= set_size; j++)
+				output->column[i].offset[j] = input_record_set->column[i].offset[offset + j] - base;
+			output->column[i].data = input_record_set->column[i].data + base;
+			output->column[i].is_shared = 1;
+			output->column[i].cell_capacity = set_size;
+			output->column[i].data_capacity = output->column[i].offset[set_size];
+		}
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+	//Records of the copy are allocated in its arena and point at the cells of the input
+	if (oph_iostore_arena_create(&(output->arena))) {
+		oph_iostore_destroy_frag_recordset(output_record_set);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	oph_iostore_frag_record **new = output->record_set;
+	oph_iostore_frag_record *input_record = NULL;
+	long long id;
+	for (j = 0; j < set_size; j++) {
+		input_record = input_record_set->record_set[offset + j];
+		if (oph_iostore_alloc_frag_record(output, &new[j])) {
+			oph_iostore_destroy_frag_recordset(output_record_set);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+		for (i = 0; i < output->field_num; i++) {
+			//Records are not views, so ids are stored in every copy
+			if (OPH_IOSTORE_IS_IMPLICIT_ID(input_record_set, i)) {
+				id = OPH_IOSTORE_RECORD_ID(input_record_set, input_record);
+				if (!(new[j]->field[i] = oph_iostore_alloc_frag_cell(output, &id, sizeof(long long)))) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+					logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+					oph_iostore_destroy_frag_recordset(output_record_set);
+					return OPH_IOSTORAGE_MEMORY_ERR;
+				}
+				new[j]->field_length[i] = sizeof(long long);
+				continue;
+			}
+			new[j]->field[i] = input_record->field[i];
+			new[j]->field_length[i] = input_record->field_length[i];
 		}
-		new[j] = NULL;
 	}
+	new[j] = NULL;
+	output->id_field = -1;
+	output->id_start = 0;
 	return OPH_IOSTORAGE_SUCCESS;
 }
 
@@ -170,6 +244,23 @@ int oph_iostore_copy_frag_record_set_only(oph_iostore_frag_record_set * input_re
 	(*output_record_set)->field_num = input_record_set->field_num;
 	(*output_record_set)->field_type = NULL;
 	(*output_record_set)->record_set = NULL;
+	(*output_record_set)->tmp_flag = 0;
+	(*output_record_set)->layout = OPH_IOSTORE_ROW_LAYOUT;
+	(*output_record_set)->row_num = 0;
+	(*output_record_set)->column = NULL;
+	(*output_record_set)->view = NULL;
+	(*output_record_set)->arena = NULL;
+	(*output_record_set)->id_field = input_record_set->id_field;
+	(*output_record_set)->id_start = input_record_set->id_start;
+	(*output_record_set)->id_base = input_record_set->id_base;
+	(*output_record_set)->ref_count = 1;
+	(*output_record_set)->origin = input_record_set->origin ? input_record_set->origin : input_record_set;
+	(*output_record_set)->shared = NULL;
+	(*output_record_set)->shared_num = 0;
+	(*output_record_set)->map_addr = NULL;
+	(*output_record_set)->map_size = 0;
+	(*output_record_set)->stats = NULL;
+	(*output_record_set)->numa_node = input_record_set->numa_node;
 	(*output_record_set)->field_name = (char **) calloc(input_record_set->field_num, sizeof(char *));
 	if (!(*output_record_set)->field_name) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
@@ -197,18 +288,9 @@ int oph_iostore_copy_frag_record_set_only(oph_iostore_frag_record_set * input_re
 		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
 
-	long long total_size = 0, set_size = 0;
-	oph_iostore_frag_record *tmp_record = NULL;
-	if (offset) {
-		tmp_record = input_record_set->record_set[0];
-		while (tmp_record)
-			tmp_record = input_record_set->record_set[++total_size];
-	}
-	if (!offset || (offset < total_size)) {
-		tmp_record = input_record_set->record_set[offset];
-		while (tmp_record && (!limit || (set_size < limit)))
-			tmp_record = input_record_set->record_set[++set_size];
-	}
+	long long total_size = oph_iostore_get_frag_row_num(input_record_set), set_size = 0;
+	if (offset < total_size)
+		set_size = (limit && (limit < total_size - offset)) ? limit : total_size - offset;
 
 	if (set_size != 0) {
 		(*output_record_set)->record_set = (oph_iostore_frag_record **) calloc(set_size + 1, sizeof(oph_iostore_frag_record *));
@@ -218,6 +300,17 @@ int oph_iostore_copy_frag_record_set_only(oph_iostore_frag_record_set * input_re
 			oph_iostore_destroy_frag_recordset(output_record_set);
 			return OPH_IOSTORAGE_MEMORY_ERR;
 		}
+		//Columnar record sets have no records: the copy reads the selected rows through its own views
+		if (input_record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+			if (_oph_iostore_build_column_views(input_record_set, offset, set_size, &((*output_record_set)->view))) {
+				oph_iostore_destroy_frag_recordset(output_record_set);
+				return OPH_IOSTORAGE_MEMORY_ERR;
+			}
+			if (input_record_set->id_field >= 0) {
+				(*output_record_set)->id_start = input_record_set->id_start + offset;
+				(*output_record_set)->id_base = (*output_record_set)->view;
+			}
+		}
 	}
 	return OPH_IOSTORAGE_SUCCESS;
 }
@@ -280,6 +373,8 @@ int oph_iostore_destroy_frag_record(oph_iostore_frag_record ** record, short int
 	return OPH_IOSTORAGE_SUCCESS;
 }
 
+static void _oph_iostore_free_frag_recordset(oph_iostore_frag_record_set ** record_set);
+
 int oph_iostore_destroy_frag_recordset(oph_iostore_frag_record_set ** record_set)
 {
 	if (!*record_set) {
@@ -287,17 +382,23 @@ int oph_iostore_destroy_frag_recordset(oph_iostore_frag_record_set ** record_set
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
 		return OPH_IOSTORAGE_NULL_PARAM;
 	}
+	//Other record sets still reference the cells
+	if (__sync_sub_and_fetch(&((*record_set)->ref_count), 1) > 0) {
+		*record_set = NULL;
+		return OPH_IOSTORAGE_SUCCESS;
+	}
 
 	long long i = 0;
 
-	if ((*record_set)->record_set != NULL) {
+	//Columnar record sets have no records; records in arena are released with it
+	if ((*record_set)->record_set != NULL && (*record_set)->layout == OPH_IOSTORE_ROW_LAYOUT && !(*record_set)->arena) {
 		while ((*record_set)->record_set[i]) {
 			oph_iostore_destroy_frag_record(&(*record_set)->record_set[i], (*record_set)->field_num);
 			i++;
 		}
 	}
 
-	oph_iostore_destroy_frag_recordset_only(record_set);
+	_oph_iostore_free_frag_recordset(record_set);
 
 	return OPH_IOSTORAGE_SUCCESS;
 }
@@ -310,6 +411,18 @@ int oph_iostore_destroy_frag_recordset_only(oph_iostore_frag_record_set ** recor
 		return OPH_IOSTORAGE_NULL_PARAM;
 	}
 
+	if (__sync_sub_and_fetch(&((*record_set)->ref_count), 1) > 0) {
+		*record_set = NULL;
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+
+	_oph_iostore_free_frag_recordset(record_set);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+static void _oph_iostore_free_frag_recordset(oph_iostore_frag_record_set ** record_set)
+{
 	long long j = 0;
 
 	if ((*record_set)->record_set != NULL) {
@@ -317,6 +430,35 @@ int oph_iostore_destroy_frag_recordset_only(oph_iostore_frag_record_set ** recor
 		(*record_set)->record_set = NULL;
 	}
 
+	_oph_iostore_free_column_views(&((*record_set)->view));
+
+	if ((*record_set)->column) {
+		for (j = 0; j < (*record_set)->field_num; j++) {
+			if ((*record_set)->column[j].offset && !(*record_set)->map_addr)
+				free((*record_set)->column[j].offset);
+			if ((*record_set)->column[j].data && !(*record_set)->column[j].is_shared)
+				oph_iostore_mem_free((*record_set)->column[j].data);
+		}
+		free((*record_set)->column);
+		(*record_set)->column = NULL;
+	}
+
+	if ((*record_set)->map_addr) {
+		munmap((*record_set)->map_addr, (*record_set)->map_size);
+		(*record_set)->map_addr = NULL;
+	}
+
+	if ((*record_set)->arena)
+		oph_iostore_arena_destroy(&((*record_set)->arena));
+
+	//Drop references to record sets whose cells were used
+	if ((*record_set)->shared) {
+		for (j = 0; j < (*record_set)->shared_num; j++)
+			oph_iostore_destroy_frag_recordset(&((*record_set)->shared[j]));
+		free((*record_set)->shared);
+		(*record_set)->shared = NULL;
+	}
+
 	if ((*record_set)->frag_name)
 		free((*record_set)->frag_name);
 
@@ -331,10 +473,11 @@ int oph_iostore_destroy_frag_recordset_only(oph_iostore_frag_record_set ** recor
 	if ((*record_set)->field_type)
 		free((*record_set)->field_type);
 
+	if ((*record_set)->stats)
+		free((*record_set)->stats);
+
 	free(*record_set);
 	*record_set = NULL;
-
-	return OPH_IOSTORAGE_SUCCESS;
 }
 
 int oph_iostore_create_frag_recordset(oph_iostore_frag_record_set ** record_set, long long set_size, short int field_num)
@@ -351,11 +494,20 @@ int oph_iostore_create_frag_recordset(oph_iostore_frag_record_set ** record_set,
 		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
 
+	if (oph_iostore_arena_create(&((*record_set)->arena))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		oph_iostore_destroy_frag_recordset(record_set);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	//Records and columns of the fragment are placed on the same node
+	(*record_set)->numa_node = (*record_set)->arena->numa_node = oph_iostore_mem_get_node();
+
 	if (set_size != 0) {
 		oph_iostore_frag_record **new = (*record_set)->record_set;
 		long long i = 0;
 		for (i = 0; i < set_size; i++) {
-			if (oph_iostore_create_frag_record(&new[i], field_num) || !new[i]) {
+			if (oph_iostore_alloc_frag_record(*record_set, &new[i]) || !new[i]) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 				oph_iostore_destroy_frag_recordset(record_set);
@@ -386,6 +538,22 @@ int oph_iostore_create_frag_recordset_only(oph_iostore_frag_record_set ** record
 	(*record_set)->field_type = NULL;
 	(*record_set)->record_set = NULL;
 	(*record_set)->tmp_flag = 0;
+	(*record_set)->layout = OPH_IOSTORE_ROW_LAYOUT;
+	(*record_set)->row_num = 0;
+	(*record_set)->column = NULL;
+	(*record_set)->view = NULL;
+	(*record_set)->arena = NULL;
+	(*record_set)->id_field = -1;
+	(*record_set)->id_start = 0;
+	(*record_set)->id_base = NULL;
+	(*record_set)->ref_count = 1;
+	(*record_set)->origin = NULL;
+	(*record_set)->shared = NULL;
+	(*record_set)->shared_num = 0;
+	(*record_set)->map_addr = NULL;
+	(*record_set)->map_size = 0;
+	(*record_set)->stats = NULL;
+	(*record_set)->numa_node = -1;
 
 	(*record_set)->field_name = (char **) calloc(field_num, sizeof(char *));
 	if (!(*record_set)->field_name) {
@@ -432,6 +600,23 @@ int oph_iostore_create_sample_frag(const long long row_number, const long long a
 	(*record_set)->field_num = 2;
 	(*record_set)->field_type = NULL;
 	(*record_set)->record_set = NULL;
+	(*record_set)->tmp_flag = 0;
+	(*record_set)->layout = OPH_IOSTORE_ROW_LAYOUT;
+	(*record_set)->row_num = 0;
+	(*record_set)->column = NULL;
+	(*record_set)->view = NULL;
+	(*record_set)->arena = NULL;
+	(*record_set)->id_field = -1;
+	(*record_set)->id_start = 0;
+	(*record_set)->id_base = NULL;
+	(*record_set)->ref_count = 1;
+	(*record_set)->origin = NULL;
+	(*record_set)->shared = NULL;
+	(*record_set)->shared_num = 0;
+	(*record_set)->map_addr = NULL;
+	(*record_set)->map_size = 0;
+	(*record_set)->stats = NULL;
+	(*record_set)->numa_node = -1;
 	(*record_set)->field_name = (char **) calloc(2, sizeof(char *));
 	if (!(*record_set)->field_name) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
@@ -527,3 +712,1359 @@ int oph_iostore_create_sample_frag(const long long row_number, const long long a
 
 	return OPH_IOSTORAGE_SUCCESS;
 }
+
+//Build a block of views on row_num rows of a columnar record set starting from first; values of the implicit id column are materialized after the lengths
+static int _oph_iostore_build_column_views(oph_iostore_frag_record_set * record_set, unsigned long long first, unsigned long long row_num, oph_iostore_frag_record ** view)
+{
+	unsigned long long i, k;
+	unsigned short j, field_num = record_set->field_num;
+
+	*view = NULL;
+	if (!row_num)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	//Views are allocated as three blocks: records, lengths (followed by the values of the implicit id, if any) and cell pointers
+	oph_iostore_frag_record *tmp_view = (oph_iostore_frag_record *) malloc(row_num * sizeof(oph_iostore_frag_record));
+	unsigned long long *view_length = (unsigned long long *) malloc(row_num * (field_num + (record_set->id_field >= 0 ? 1 : 0)) * sizeof(unsigned long long));
+	void **view_field = (void **) malloc(row_num * field_num * sizeof(void *));
+	if (!tmp_view || !view_length || !view_field) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		free(tmp_view);
+		free(view_length);
+		free(view_field);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	long long *view_id = (long long *) (view_length + row_num * field_num);
+
+	for (i = 0, k = first; i < row_num; i++, k++) {
+		tmp_view[i].field_length = view_length + i * field_num;
+		tmp_view[i].field = view_field + i * field_num;
+		for (j = 0; j < field_num; j++) {
+			if (OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j)) {
+				//Value is computed from the position of the record, but it is also materialized for generic readers
+				view_id[i] = record_set->id_start + (long long) k;
+				tmp_view[i].field_length[j] = sizeof(long long);
+				tmp_view[i].field[j] = (void *) &(view_id[i]);
+				continue;
+			}
+			tmp_view[i].field_length[j] = record_set->column[j].offset[k + 1] - record_set->column[j].offset[k];
+			tmp_view[i].field[j] = tmp_view[i].field_length[j] ? (void *) (record_set->column[j].data + record_set->column[j].offset[k]) : NULL;
+		}
+	}
+	*view = tmp_view;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+static void _oph_iostore_free_column_views(oph_iostore_frag_record ** view)
+{
+	if (!*view)
+		return;
+	free((*view)[0].field_length);
+	free((*view)[0].field);
+	free(*view);
+	*view = NULL;
+}
+
+unsigned long long oph_iostore_get_frag_row_num(oph_iostore_frag_record_set * record_set)
+{
+	unsigned long long row_num = 0;
+
+	if (!record_set)
+		return 0;
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT)
+		return record_set->row_num;
+	if (record_set->record_set)
+		while (record_set->record_set[row_num])
+			row_num++;
+
+	return row_num;
+}
+
+int oph_iostore_create_frag_columns(oph_iostore_frag_record_set * record_set)
+{
+	if (!record_set || !record_set->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT && !record_set->row_num)
+		return OPH_IOSTORAGE_SUCCESS;
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT || oph_iostore_get_frag_row_num(record_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		return OPH_IOSTORAGE_BAD_PARAMETER;
+	}
+
+	oph_iostore_frag_column *column = (oph_iostore_frag_column *) calloc(record_set->field_num, sizeof(oph_iostore_frag_column));
+	if (!column) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	free(record_set->record_set);
+	record_set->record_set = NULL;
+	record_set->column = column;
+	record_set->row_num = 0;
+	record_set->id_field = -1;
+	record_set->id_start = 0;
+	record_set->layout = OPH_IOSTORE_COLUMN_LAYOUT;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Make room in a column being built for cell_num more cells holding length bytes; buffers grow geometrically
+static int _oph_iostore_reserve_frag_column(oph_iostore_frag_column * column, unsigned long long cell_num, unsigned long long length, int numa_node)
+{
+	unsigned long long capacity, used = column->offset ? column->offset[column->cell_num] : 0;
+
+	if (!column->offset || column->cell_num + cell_num > column->cell_capacity) {
+		capacity = column->cell_capacity ? column->cell_capacity : OPH_IOSTORE_COLUMN_MIN_CELLS;
+		while (capacity < column->cell_num + cell_num)
+			capacity <<= 1;
+		unsigned long long *offset = (unsigned long long *) realloc(column->offset, (capacity + 1) * sizeof(unsigned long long));
+		if (!offset)
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		if (!column->offset)
+			offset[0] = 0;
+		column->offset = offset;
+		column->cell_capacity = capacity;
+	}
+
+	if (!column->data || column->is_shared || used + length > column->data_capacity) {
+		capacity = column->data_capacity > OPH_IOSTORE_COLUMN_MIN_DATA ? column->data_capacity : OPH_IOSTORE_COLUMN_MIN_DATA;
+		while (capacity < used + length)
+			capacity <<= 1;
+		char *data = NULL;
+		if (column->is_shared) {
+			//Cells of a shared record set are copied before being extended
+			if ((data = (char *) oph_iostore_mem_alloc(capacity, numa_node)) && used)
+				memcpy(data, column->data, used);
+		} else
+			data = (char *) oph_iostore_mem_realloc(column->data, capacity, numa_node);
+		if (!data)
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		column->data = data;
+		column->data_capacity = capacity;
+		column->is_shared = 0;
+	}
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Store the values of an implicit id column, whose sequence has been broken
+static int _oph_iostore_materialize_frag_ids(oph_iostore_frag_record_set * record_set)
+{
+	oph_iostore_frag_column *column = record_set->column + record_set->id_field;
+	unsigned long long i, cell_num = column->cell_num;
+	unsigned long long capacity = cell_num > OPH_IOSTORE_COLUMN_MIN_CELLS ? cell_num : OPH_IOSTORE_COLUMN_MIN_CELLS;
+
+	unsigned long long *offset = (unsigned long long *) malloc((capacity + 1) * sizeof(unsigned long long));
+	char *data = (char *) oph_iostore_mem_alloc(capacity * sizeof(long long), record_set->numa_node);
+	if (!offset || !data) {
+		free(offset);
+		oph_iostore_mem_free(data);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	offset[0] = 0;
+	for (i = 0; i < cell_num; i++) {
+		*((long long *) (data + offset[i])) = record_set->id_start + (long long) i;
+		offset[i + 1] = offset[i] + sizeof(long long);
+	}
+
+	column->offset = offset;
+	column->data = data;
+	column->is_shared = 0;
+	column->cell_capacity = capacity;
+	column->data_capacity = capacity * sizeof(long long);
+	record_set->id_field = -1;
+	record_set->id_start = 0;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_append_frag_cell(oph_iostore_frag_record_set * record_set, unsigned short col, const void *value, unsigned long long length)
+{
+	if (!record_set || record_set->layout != OPH_IOSTORE_COLUMN_LAYOUT || !record_set->column || col >= record_set->field_num || (length && !value)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+	//Mapped images and views cannot be extended
+	if (record_set->map_addr || record_set->origin) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		return OPH_IOSTORAGE_BAD_PARAMETER;
+	}
+
+	oph_iostore_frag_column *column = record_set->column + col;
+	long long id = 0;
+
+	if (length == sizeof(long long))
+		memcpy(&id, value, sizeof(long long));
+	if (OPH_IOSTORE_IS_IMPLICIT_ID(record_set, col)) {
+		//Ids are not stored as long as they follow the sequence
+		if (length == sizeof(long long) && id == record_set->id_start + (long long) column->cell_num) {
+			column->cell_num++;
+			return OPH_IOSTORAGE_SUCCESS;
+		}
+		if (_oph_iostore_materialize_frag_ids(record_set)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+	} else if (!column->cell_num && !record_set->row_num && record_set->id_field < 0 && length == sizeof(long long) && record_set->field_type[col] == OPH_IOSTORE_LONG_TYPE
+		   && record_set->field_name[col] && !STRCMP(record_set->field_name[col], OPH_NAME_ID)) {
+		//The first id starts an implicit sequence
+		record_set->id_field = col;
+		record_set->id_start = id;
+		column->cell_num = 1;
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+
+	if (_oph_iostore_reserve_frag_column(column, 1, length, record_set->numa_node)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	if (length)
+		memcpy(column->data + column->offset[column->cell_num], value, length);
+	column->offset[column->cell_num + 1] = column->offset[column->cell_num] + length;
+	column->cell_num++;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_append_frag_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record)
+{
+	if (!record_set || record_set->layout != OPH_IOSTORE_COLUMN_LAYOUT || !record_set->column || !record || !*record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	unsigned short j, k, field_num = record_set->field_num;
+	for (j = 0; j < field_num; j++)
+		if (record_set->column[j].cell_num != record_set->row_num)
+			break;
+	if (j < field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		return OPH_IOSTORAGE_BAD_PARAMETER;
+	}
+
+	for (j = 0; j < field_num; j++)
+		if (oph_iostore_append_frag_cell(record_set, j, (*record)->field[j], (*record)->field_length[j]))
+			break;
+	if (j < field_num) {
+		//Cells already appended are dropped
+		for (k = 0; k < j; k++)
+			record_set->column[k].cell_num = record_set->row_num;
+		if (!record_set->row_num && record_set->id_field >= 0) {
+			record_set->id_field = -1;
+			record_set->id_start = 0;
+		}
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	record_set->row_num++;
+
+	//Records only live until they are appended, so the arena can be reused for the next one
+	if (record_set->arena) {
+		*record = NULL;
+		return oph_iostore_arena_reset(record_set->arena);
+	}
+
+	return oph_iostore_destroy_frag_record(record, field_num);
+}
+
+int oph_iostore_seal_frag_columns(oph_iostore_frag_record_set * record_set, unsigned long long row_num)
+{
+	if (!record_set || record_set->layout != OPH_IOSTORE_COLUMN_LAYOUT || !record_set->column) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+	if (record_set->map_addr)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	oph_iostore_frag_column *column = record_set->column;
+	unsigned short j;
+	for (j = 0; j < record_set->field_num; j++)
+		if (column[j].cell_num < row_num)
+			break;
+	if (j < record_set->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		return OPH_IOSTORAGE_BAD_PARAMETER;
+	}
+
+	//An empty record set has no implicit id, and a column whose type has been changed is stored as it is
+	if (!row_num && record_set->id_field >= 0) {
+		record_set->id_field = -1;
+		record_set->id_start = 0;
+	} else if (record_set->id_field >= 0 && record_set->field_type[record_set->id_field] != OPH_IOSTORE_LONG_TYPE && _oph_iostore_materialize_frag_ids(record_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	unsigned long long *offset = NULL, used;
+	char *data = NULL;
+	for (j = 0; j < record_set->field_num; j++) {
+		column[j].cell_num = row_num;
+		if (OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j))
+			continue;
+		//Buffers are shrunk to fit; they are kept as they are if this is not possible
+		if (!column[j].offset || column[j].cell_capacity != row_num) {
+			if (!(offset = (unsigned long long *) realloc(column[j].offset, (row_num + 1) * sizeof(unsigned long long))) && !column[j].offset)
+				break;
+			if (offset) {
+				if (!column[j].offset)
+					offset[0] = 0;
+				column[j].offset = offset;
+				column[j].cell_capacity = row_num;
+			}
+		}
+		used = column[j].offset[row_num] ? column[j].offset[row_num] : 1;
+		if (!column[j].data || (!column[j].is_shared && column[j].data_capacity != used)) {
+			if (!(data = (char *) oph_iostore_mem_realloc(column[j].data, used, record_set->numa_node)) && !column[j].data)
+				break;
+			if (data) {
+				column[j].data = data;
+				column[j].data_capacity = used;
+			}
+		}
+	}
+	if (j < record_set->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	record_set->row_num = row_num;
+
+	//Records are not built anymore
+	if (record_set->arena)
+		oph_iostore_arena_destroy(&(record_set->arena));
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+static int _oph_iostore_is_shared_region(oph_iostore_frag_record_set * record_set, const char *region, unsigned long long size)
+{
+	unsigned short l, k;
+	oph_iostore_frag_record_set *source = NULL;
+	oph_iostore_arena_chunk *chunk = NULL;
+
+	for (l = 0; l < record_set->shared_num; l++) {
+		source = record_set->shared[l];
+		if (source->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+			for (k = 0; k < source->field_num; k++)
+				if (source->column[k].data && region >= source->column[k].data && region + size <= source->column[k].data + source->column[k].offset[source->row_num])
+					return 1;
+		} else if (source->arena) {
+			for (chunk = source->arena->head; chunk; chunk = chunk->next)
+				if (region >= chunk->data && region + size <= chunk->data + chunk->used)
+					return 1;
+		}
+	}
+
+	return 0;
+}
+
+int oph_iostore_frag_recordset_to_columns(oph_iostore_frag_record_set * record_set)
+{
+	if (!record_set || !record_set->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	unsigned long long i, row_num = 0;
+	unsigned short j;
+
+	if (record_set->record_set)
+		while (record_set->record_set[row_num])
+			row_num++;
+
+	oph_iostore_frag_column *column = (oph_iostore_frag_column *) calloc(record_set->field_num, sizeof(oph_iostore_frag_column));
+	if (!column) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	oph_iostore_frag_record **rows = record_set->record_set;
+
+	//Look for a strictly sequential id column
+	short int id_field = -1;
+	if (row_num) {
+		for (j = 0; j < record_set->field_num; j++) {
+			if (record_set->field_type[j] != OPH_IOSTORE_LONG_TYPE || !record_set->field_name[j] || STRCMP(record_set->field_name[j], OPH_NAME_ID))
+				continue;
+			for (i = 0; i < row_num; i++)
+				if (rows[i]->field_length[j] != sizeof(long long) || !rows[i]->field[j]
+				    || *((long long *) rows[i]->field[j]) != *((long long *) rows[0]->field[j]) + (long long) i)
+					break;
+			if (i == row_num)
+				id_field = j;
+			break;
+		}
+	}
+
+	for (j = 0; j < record_set->field_num; j++) {
+		if (j == id_field)
+			continue;
+		column[j].offset = (unsigned long long *) malloc((row_num + 1) * sizeof(unsigned long long));
+		if (!column[j].offset)
+			break;
+		column[j].offset[0] = 0;
+		for (i = 0; i < row_num; i++)
+			column[j].offset[i + 1] = column[j].offset[i] + rows[i]->field_length[j];
+		//Cells already stored contiguously in a shared record set are referenced instead of copied
+		if (record_set->shared_num && row_num && rows[0]->field_length[j]) {
+			for (i = 1; i < row_num; i++)
+				if (rows[i]->field_length[j] && (char *) rows[i]->field[j] != (char *) rows[0]->field[j] + column[j].offset[i])
+					break;
+			if (i == row_num && _oph_iostore_is_shared_region(record_set, (char *) rows[0]->field[j], column[j].offset[row_num])) {
+				column[j].data = (char *) rows[0]->field[j];
+				column[j].is_shared = 1;
+				continue;
+			}
+		}
+		column[j].data = (char *) oph_iostore_mem_alloc(column[j].offset[row_num] ? column[j].offset[row_num] : 1, record_set->numa_node);
+		if (!column[j].data)
+			break;
+		for (i = 0; i < row_num; i++)
+			if (rows[i]->field_length[j])
+				memcpy(column[j].data + column[j].offset[i], rows[i]->field[j], rows[i]->field_length[j]);
+		column[j].cell_capacity = row_num;
+		column[j].data_capacity = column[j].offset[row_num] ? column[j].offset[row_num] : 1;
+	}
+	if (j < record_set->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		for (j = 0; j < record_set->field_num; j++) {
+			free(column[j].offset);
+			if (!column[j].is_shared)
+				oph_iostore_mem_free(column[j].data);
+		}
+		free(column);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	for (j = 0; j < record_set->field_num; j++)
+		column[j].cell_num = row_num;
+	record_set->column = column;
+	record_set->row_num = row_num;
+	if (id_field >= 0) {
+		record_set->id_field = id_field;
+		record_set->id_start = *((long long *) rows[0]->field[id_field]);
+	}
+
+	//Release original records
+	record_set->record_set = NULL;
+	if (record_set->arena)
+		oph_iostore_arena_destroy(&(record_set->arena));
+	else
+		for (i = 0; i < row_num; i++)
+			oph_iostore_destroy_frag_record(&(rows[i]), record_set->field_num);
+	free(rows);
+
+	//Keep shared record sets only if some column still references them
+	if (record_set->shared) {
+		for (j = 0; j < record_set->field_num; j++)
+			if (column[j].is_shared)
+				break;
+		if (j == record_set->field_num) {
+			for (j = 0; j < record_set->shared_num; j++)
+				oph_iostore_destroy_frag_recordset(&(record_set->shared[j]));
+			free(record_set->shared);
+			record_set->shared = NULL;
+			record_set->shared_num = 0;
+		}
+	}
+
+	record_set->layout = OPH_IOSTORE_COLUMN_LAYOUT;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+void oph_iostore_free_frag_columns(oph_iostore_frag_column * column, unsigned short field_num)
+{
+	unsigned short j;
+
+	if (!column)
+		return;
+	for (j = 0; j < field_num; j++) {
+		free(column[j].offset);
+		if (!column[j].is_shared)
+			oph_iostore_mem_free(column[j].data);
+		column[j].offset = NULL;
+		column[j].data = NULL;
+	}
+}
+
+//Check if a column contains the sequence of ids first, first+1, ... (row_num cells)
+static int _oph_iostore_is_id_sequence(oph_iostore_frag_column * column, unsigned long long row_num, long long first)
+{
+	unsigned long long i;
+
+	for (i = 0; i < row_num; i++)
+		if (column->offset[i + 1] - column->offset[i] != sizeof(long long) || *((long long *) (column->data + column->offset[i])) != first + (long long) i)
+			return 0;
+
+	return 1;
+}
+
+int oph_iostore_append_frag_columns(oph_iostore_frag_record_set * record_set, unsigned long long row_num, oph_iostore_frag_column * column)
+{
+	if (!record_set || !record_set->field_num || !column) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	unsigned short j, field_num = record_set->field_num;
+	for (j = 0; j < field_num; j++)
+		if (!column[j].offset || !column[j].data || column[j].is_shared || column[j].offset[0])
+			break;
+	//Mapped images and views cannot be extended
+	if (j < field_num || record_set->map_addr || record_set->origin) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_APPEND_ERROR);
+		return OPH_IOSTORAGE_BAD_PARAMETER;
+	}
+
+	if (record_set->layout != OPH_IOSTORE_COLUMN_LAYOUT && oph_iostore_frag_recordset_to_columns(record_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	unsigned long long i, old_num = record_set->row_num, tot_num = old_num + row_num, old_len;
+	short int id_field = record_set->id_field;
+	long long id_start = record_set->id_start;
+
+	//An implicit id column is kept only if the batch continues its sequence
+	if (id_field >= 0 && !_oph_iostore_is_id_sequence(&(column[id_field]), row_num, id_start + (long long) old_num))
+		id_field = -1;
+	if (!old_num && row_num) {
+		for (j = 0; j < field_num; j++) {
+			if (record_set->field_type[j] != OPH_IOSTORE_LONG_TYPE || !record_set->field_name[j] || STRCMP(record_set->field_name[j], OPH_NAME_ID))
+				continue;
+			if (column[j].offset[1] == sizeof(long long) && _oph_iostore_is_id_sequence(&(column[j]), row_num, *((long long *) column[j].data))) {
+				id_field = j;
+				id_start = *((long long *) column[j].data);
+			}
+			break;
+		}
+	}
+
+	oph_iostore_frag_column *old_column = record_set->column;
+
+	//Columns of the first batch are adopted as they are
+	if (!old_num) {
+		for (j = 0; j < field_num; j++) {
+			free(old_column[j].offset);
+			if (!old_column[j].is_shared)
+				oph_iostore_mem_free(old_column[j].data);
+			if (j == id_field) {
+				free(column[j].offset);
+				oph_iostore_mem_free(column[j].data);
+				memset(old_column + j, 0, sizeof(oph_iostore_frag_column));
+			} else {
+				old_column[j] = column[j];
+				old_column[j].cell_capacity = row_num;
+				old_column[j].data_capacity = column[j].offset[row_num];
+			}
+			old_column[j].cell_num = row_num;
+		}
+	} else {
+		//Reserve room in every column first, so that a failure leaves the record set unchanged
+		for (j = 0; j < field_num; j++)
+			if (j != id_field && !OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j)
+			    && _oph_iostore_reserve_frag_column(old_column + j, row_num, column[j].offset[row_num], record_set->numa_node))
+				break;
+		//The sequence is broken: ids of previous rows are materialized
+		if (j == field_num && id_field < 0 && record_set->id_field >= 0) {
+			j = record_set->id_field;
+			if (_oph_iostore_materialize_frag_ids(record_set) || _oph_iostore_reserve_frag_column(old_column + j, row_num, column[j].offset[row_num], record_set->numa_node))
+				j = 0;
+			else
+				j = field_num;
+		}
+		if (j < field_num) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+		//Append the batch in place
+		for (j = 0; j < field_num; j++) {
+			if (j != id_field) {
+				old_len = old_column[j].offset[old_num];
+				for (i = 1; i <= row_num; i++)
+					old_column[j].offset[old_num + i] = old_len + column[j].offset[i];
+				memcpy(old_column[j].data + old_len, column[j].data, column[j].offset[row_num]);
+			}
+			old_column[j].cell_num = tot_num;
+			free(column[j].offset);
+			oph_iostore_mem_free(column[j].data);
+		}
+	}
+	memset(column, 0, field_num * sizeof(oph_iostore_frag_column));
+
+	record_set->row_num = tot_num;
+	record_set->id_field = id_field;
+	record_set->id_start = id_field >= 0 ? id_start : 0;
+
+	//Every column is now owned by the record set
+	if (record_set->shared) {
+		for (j = 0; j < record_set->shared_num; j++)
+			oph_iostore_destroy_frag_recordset(&(record_set->shared[j]));
+		free(record_set->shared);
+		record_set->shared = NULL;
+		record_set->shared_num = 0;
+	}
+	//Zone maps are computed again when the fragment is stored
+	free(record_set->stats);
+	record_set->stats = NULL;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_compute_frag_stats(oph_iostore_frag_record_set * record_set)
+{
+	if (!record_set || !record_set->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	oph_iostore_field_stats *stats = record_set->stats;
+	if (!stats && !(stats = (oph_iostore_field_stats *) malloc(record_set->field_num * sizeof(oph_iostore_field_stats)))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	memset(stats, 0, record_set->field_num * sizeof(oph_iostore_field_stats));
+
+	unsigned long long i, row_num = 0;
+	unsigned short j;
+	long long long_value;
+	double double_value;
+
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT)
+		row_num = record_set->row_num;
+	else if (record_set->record_set)
+		while (record_set->record_set[row_num])
+			row_num++;
+
+	for (j = 0; j < record_set->field_num && row_num; j++) {
+		if (OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j)) {
+			stats[j].count = row_num;
+			stats[j].is_sequential = 1;
+			stats[j].min.long_value = record_set->id_start;
+			stats[j].max.long_value = record_set->id_start + (long long) row_num - 1;
+			continue;
+		}
+		switch (record_set->field_type[j]) {
+			case OPH_IOSTORE_LONG_TYPE:
+				stats[j].is_sequential = 1;
+				for (i = 0; i < row_num; i++) {
+					if (OPH_IOSTORE_FIELD_LENGTH(record_set, i, j) != sizeof(long long)) {
+						stats[j].is_sequential = 0;
+						continue;
+					}
+					long_value = *((long long *) OPH_IOSTORE_FIELD(record_set, i, j));
+					if (!stats[j].count) {
+						stats[j].min.long_value = stats[j].max.long_value = long_value;
+					} else {
+						if (long_value != stats[j].max.long_value + 1)
+							stats[j].is_sequential = 0;
+						if (long_value < stats[j].min.long_value)
+							stats[j].min.long_value = long_value;
+						if (long_value > stats[j].max.long_value)
+							stats[j].max.long_value = long_value;
+					}
+					stats[j].count++;
+				}
+				break;
+			case OPH_IOSTORE_REAL_TYPE:
+				for (i = 0; i < row_num; i++) {
+					if (OPH_IOSTORE_FIELD_LENGTH(record_set, i, j) != sizeof(double))
+						continue;
+					double_value = *((double *) OPH_IOSTORE_FIELD(record_set, i, j));
+					//NaN cannot be ordered: the column is not summarized
+					if (isnan(double_value)) {
+						stats[j].count = 0;
+						break;
+					}
+					if (!stats[j].count || double_value < stats[j].min.double_value)
+						stats[j].min.double_value = double_value;
+					if (!stats[j].count || double_value > stats[j].max.double_value)
+						stats[j].max.double_value = double_value;
+					stats[j].count++;
+				}
+				break;
+			default:
+				break;
+		}
+		if (!stats[j].count)
+			stats[j].is_sequential = 0;
+	}
+
+	record_set->stats = stats;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_get_frag_image_size(oph_iostore_frag_record_set * record_set, unsigned long long *size)
+{
+	if (!record_set || !record_set->field_num || !size) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	oph_iostore_frag_record **rows = record_set->record_set;
+	unsigned long long i, row_num = 0, data_length, tmp_size;
+	unsigned short j;
+
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT)
+		row_num = record_set->row_num;
+	else if (rows)
+		while (rows[row_num])
+			row_num++;
+
+	//Header, field descriptors and names, then offsets and cells of each column
+	tmp_size = sizeof(oph_iostore_frag_image_header) + record_set->field_num * sizeof(oph_iostore_frag_image_field);
+	tmp_size += (record_set->frag_name ? strlen(record_set->frag_name) : 0) + 1;
+	for (j = 0; j < record_set->field_num; j++)
+		tmp_size += (record_set->field_name[j] ? strlen(record_set->field_name[j]) : 0) + 1;
+	tmp_size = OPH_IOSTORE_IMAGE_PAD(tmp_size);
+	for (j = 0; j < record_set->field_num; j++) {
+		if (OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j))
+			continue;
+		data_length = 0;
+		if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT)
+			data_length = record_set->column[j].offset[row_num];
+		else
+			for (i = 0; i < row_num; i++)
+				data_length += rows[i]->field_length[j];
+		tmp_size += (row_num + 1) * sizeof(unsigned long long) + OPH_IOSTORE_IMAGE_PAD(data_length);
+	}
+
+	*size = tmp_size;
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_write_frag_image(oph_iostore_frag_record_set * record_set, char *image, unsigned long long size)
+{
+	if (!record_set || !record_set->field_num || !image || size < sizeof(oph_iostore_frag_image_header)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	oph_iostore_frag_record **rows = record_set->record_set;
+	const char *frag_name = record_set->frag_name ? record_set->frag_name : "";
+	unsigned long long i, row_num = 0, length, data_length;
+	unsigned short j, field_num = record_set->field_num;
+
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT)
+		row_num = record_set->row_num;
+	else if (rows)
+		while (rows[row_num])
+			row_num++;
+
+	oph_iostore_frag_image_header *header = (oph_iostore_frag_image_header *) image;
+	oph_iostore_frag_image_field *field = (oph_iostore_frag_image_field *) (image + sizeof(oph_iostore_frag_image_header));
+	unsigned long long pos = sizeof(oph_iostore_frag_image_header) + field_num * sizeof(oph_iostore_frag_image_field);
+
+	memcpy(header->magic, OPH_IOSTORE_IMAGE_MAGIC, OPH_IOSTORE_IMAGE_MAGIC_LEN);
+	header->image_size = size;
+	header->row_num = row_num;
+	header->field_num = field_num;
+	header->id_field = record_set->id_field >= 0 ? record_set->id_field : -1;
+	header->id_start = record_set->id_start;
+	header->name_offset = pos;
+	length = strlen(frag_name) + 1;
+	memcpy(image + pos, frag_name, length);
+	pos += length;
+	for (j = 0; j < field_num; j++) {
+		field[j].name_offset = pos;
+		length = (record_set->field_name[j] ? strlen(record_set->field_name[j]) : 0) + 1;
+		memcpy(image + pos, record_set->field_name[j] ? record_set->field_name[j] : "", length);
+		pos += length;
+	}
+	pos = OPH_IOSTORE_IMAGE_PAD(pos);
+
+	unsigned long long *offset = NULL;
+	for (j = 0; j < field_num; j++) {
+		field[j].type = record_set->field_type[j];
+		if (record_set->stats)
+			field[j].stats = record_set->stats[j];
+		else
+			memset(&(field[j].stats), 0, sizeof(oph_iostore_field_stats));
+		if (OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j)) {
+			field[j].offset_offset = field[j].data_offset = 0;
+			continue;
+		}
+		field[j].offset_offset = pos;
+		offset = (unsigned long long *) (image + pos);
+		pos += (row_num + 1) * sizeof(unsigned long long);
+		field[j].data_offset = pos;
+		if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+			data_length = record_set->column[j].offset[row_num];
+			if (pos + data_length > size)
+				break;
+			memcpy(offset, record_set->column[j].offset, (row_num + 1) * sizeof(unsigned long long));
+			if (data_length)
+				memcpy(image + pos, record_set->column[j].data, data_length);
+		} else {
+			offset[0] = 0;
+			for (i = 0; i < row_num; i++)
+				offset[i + 1] = offset[i] + rows[i]->field_length[j];
+			data_length = offset[row_num];
+			if (pos + data_length > size)
+				break;
+			for (i = 0; i < row_num; i++)
+				if (rows[i]->field_length[j])
+					memcpy(image + pos + offset[i], rows[i]->field[j], rows[i]->field_length[j]);
+		}
+		pos += OPH_IOSTORE_IMAGE_PAD(data_length);
+	}
+	if (j < field_num || pos > size) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IMAGE_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IMAGE_ERROR);
+		return OPH_IOSTORAGE_VALID_ERROR;
+	}
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+static int _oph_iostore_check_image_string(const char *image, unsigned long long size, unsigned long long offset)
+{
+	return offset < size && memchr(image + offset, '\0', size - offset) != NULL;
+}
+
+int oph_iostore_map_frag_image(char *image, unsigned long long size, void *map_addr, size_t map_size, oph_iostore_frag_record_set ** record_set)
+{
+	if (!image || !map_addr || !record_set) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*record_set = NULL;
+
+	//Check image content before using it in place
+	oph_iostore_frag_image_header *header = (oph_iostore_frag_image_header *) image;
+	oph_iostore_frag_image_field *field = (oph_iostore_frag_image_field *) (image + sizeof(oph_iostore_frag_image_header));
+	unsigned long long j = 0, row_num = 0;
+	int valid = size >= sizeof(oph_iostore_frag_image_header) && !memcmp(header->magic, OPH_IOSTORE_IMAGE_MAGIC, OPH_IOSTORE_IMAGE_MAGIC_LEN) && header->image_size == size
+	    && header->field_num && header->field_num <= 0xFFFF && sizeof(oph_iostore_frag_image_header) + header->field_num * sizeof(oph_iostore_frag_image_field) <= size
+	    && header->id_field < (long long) header->field_num && header->row_num < size && _oph_iostore_check_image_string(image, size, header->name_offset);
+	if (valid)
+		row_num = header->row_num;
+	for (j = 0; valid && j < header->field_num; j++) {
+		if ((long long) j == header->id_field)
+			valid = _oph_iostore_check_image_string(image, size, field[j].name_offset);
+		else
+			valid = field[j].type <= OPH_IOSTORE_STRING_TYPE && _oph_iostore_check_image_string(image, size, field[j].name_offset) && !(field[j].offset_offset % OPH_IOSTORE_IMAGE_ALIGN)
+			    && field[j].offset_offset + (row_num + 1) * sizeof(unsigned long long) <= size && field[j].data_offset <= size
+			    && ((unsigned long long *) (image + field[j].offset_offset))[row_num] <= size - field[j].data_offset;
+	}
+	if (!valid) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IMAGE_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IMAGE_ERROR);
+		return OPH_IOSTORAGE_VALID_ERROR;
+	}
+
+	//Build a columnar record set whose columns point into the image
+	oph_iostore_frag_record_set *tmp_record_set = NULL;
+	oph_iostore_frag_column *column = NULL;
+	if (oph_iostore_create_frag_recordset_only(&tmp_record_set, 0, header->field_num)
+	    || !(tmp_record_set->frag_name = strdup(image + header->name_offset))
+	    || !(tmp_record_set->stats = (oph_iostore_field_stats *) malloc(header->field_num * sizeof(oph_iostore_field_stats)))
+	    || !(column = (oph_iostore_frag_column *) calloc(header->field_num, sizeof(oph_iostore_frag_column)))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		if (tmp_record_set)
+			oph_iostore_destroy_frag_recordset(&tmp_record_set);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	tmp_record_set->column = column;
+	tmp_record_set->row_num = row_num;
+	for (j = 0; j < header->field_num; j++) {
+		column[j].is_shared = 1;
+		if (!(tmp_record_set->field_name[j] = strdup(image + field[j].name_offset)))
+			break;
+		tmp_record_set->stats[j] = field[j].stats;
+		column[j].cell_num = row_num;
+		if ((long long) j == header->id_field) {
+			tmp_record_set->field_type[j] = OPH_IOSTORE_LONG_TYPE;
+			continue;
+		}
+		tmp_record_set->field_type[j] = (oph_iostore_field_type) field[j].type;
+		column[j].offset = (unsigned long long *) (image + field[j].offset_offset);
+		column[j].data = image + field[j].data_offset;
+	}
+	if (header->id_field >= 0) {
+		tmp_record_set->id_field = (short int) header->id_field;
+		tmp_record_set->id_start = header->id_start;
+	}
+	//Offsets belong to the mapping: they are not released with the columns
+	tmp_record_set->map_addr = map_addr;
+	if (j < header->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		tmp_record_set->map_addr = NULL;
+		for (j = 0; j < header->field_num; j++)
+			column[j].offset = NULL;
+		oph_iostore_destroy_frag_recordset(&tmp_record_set);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	tmp_record_set->map_size = map_size;
+	tmp_record_set->layout = OPH_IOSTORE_COLUMN_LAYOUT;
+	*record_set = tmp_record_set;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_get_frag_recordset_size(oph_iostore_frag_record_set * record_set, unsigned long long *size)
+{
+	if (!record_set || !size) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	unsigned long long i = 0, tmp_size = 0;
+	unsigned short j;
+
+	if (record_set->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+		tmp_size = record_set->field_num * sizeof(oph_iostore_frag_column);
+		for (j = 0; j < record_set->field_num; j++)
+			if (!OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j))
+				tmp_size += (record_set->row_num + 1) * sizeof(unsigned long long) + record_set->column[j].offset[record_set->row_num];
+	} else {
+		tmp_size = sizeof(oph_iostore_frag_record *);
+		if (record_set->record_set) {
+			while (record_set->record_set[i]) {
+				tmp_size += sizeof(oph_iostore_frag_record *) + sizeof(oph_iostore_frag_record);
+				for (j = 0; j < record_set->field_num; j++)
+					tmp_size += record_set->record_set[i]->field_length[j] + sizeof(unsigned long long) + sizeof(void *);
+				i++;
+			}
+		}
+	}
+
+	*size = tmp_size;
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Header preceding each region returned by oph_iostore_mem_alloc
+typedef struct {
+	size_t length;
+	size_t is_mapped;
+} oph_iostore_mem_header;
+
+static oph_iostore_huge_pages memory_huge_pages = OPH_IOSTORE_HUGE_PAGES_NONE;
+static oph_iostore_numa_policy memory_numa_policy = OPH_IOSTORE_NUMA_DEFAULT;
+static unsigned int memory_next_node = 0;
+
+int oph_iostore_set_memory_policy(oph_iostore_huge_pages huge_pages, oph_iostore_numa_policy numa_policy)
+{
+#ifdef OPH_IOSTORE_NUMA
+	if (numa_policy != OPH_IOSTORE_NUMA_DEFAULT && numa_available() < 0) {
+#else
+	if (numa_policy != OPH_IOSTORE_NUMA_DEFAULT) {
+#endif
+		pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NO_NUMA);
+		logging(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NO_NUMA);
+		numa_policy = OPH_IOSTORE_NUMA_DEFAULT;
+	}
+
+	memory_huge_pages = huge_pages;
+	memory_numa_policy = numa_policy;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_mem_get_node()
+{
+#ifdef OPH_IOSTORE_NUMA
+	int cpu;
+	switch (memory_numa_policy) {
+		case OPH_IOSTORE_NUMA_LOCAL:
+			//Memory stays on the node of the creating thread even if it is moved later
+			if ((cpu = sched_getcpu()) >= 0)
+				return numa_node_of_cpu(cpu);
+			break;
+		case OPH_IOSTORE_NUMA_BIND:
+			//Fragments are spread over nodes, each one on a single node
+			return (int) (__sync_fetch_and_add(&memory_next_node, 1) % (unsigned int) (numa_max_node() + 1));
+		default:
+			break;
+	}
+#endif
+	return -1;
+}
+
+int oph_iostore_mem_advise(void *addr, size_t length, int numa_node)
+{
+	if (!addr || !length) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+#ifdef MADV_HUGEPAGE
+	if (memory_huge_pages != OPH_IOSTORE_HUGE_PAGES_NONE)
+		madvise(addr, length, MADV_HUGEPAGE);
+#endif
+#ifdef OPH_IOSTORE_NUMA
+	if (numa_node >= 0)
+		numa_tonode_memory(addr, length, numa_node);
+	else if (memory_numa_policy == OPH_IOSTORE_NUMA_INTERLEAVE)
+		numa_interleave_memory(addr, length, numa_all_nodes_ptr);
+#endif
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+void *oph_iostore_mem_alloc(size_t size, int numa_node)
+{
+	oph_iostore_mem_header *header = NULL;
+	size_t length = sizeof(oph_iostore_mem_header) + size;
+
+	//Small regions and default policies are served by malloc
+	if (size < OPH_IOSTORE_MEM_MAP_THRESHOLD || (memory_huge_pages == OPH_IOSTORE_HUGE_PAGES_NONE && memory_numa_policy == OPH_IOSTORE_NUMA_DEFAULT)) {
+		if (!(header = (oph_iostore_mem_header *) malloc(length))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return NULL;
+		}
+		header->length = length;
+		header->is_mapped = 0;
+		return header + 1;
+	}
+
+	void *addr = MAP_FAILED;
+	size_t is_mapped = 1;
+#ifdef MAP_HUGETLB
+	//Explicit huge pages come from the reserved pool: fall back to normal pages when it is exhausted
+	if (memory_huge_pages == OPH_IOSTORE_HUGE_PAGES_EXPLICIT && length >= OPH_IOSTORE_MEM_HUGE_PAGE) {
+		length = (length + OPH_IOSTORE_MEM_HUGE_PAGE - 1) & ~((size_t) OPH_IOSTORE_MEM_HUGE_PAGE - 1);
+		addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		is_mapped = 2;
+	}
+#endif
+	if (addr == MAP_FAILED) {
+		length = sizeof(oph_iostore_mem_header) + size;
+		is_mapped = 1;
+		addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (addr == MAP_FAILED) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return NULL;
+		}
+	}
+	oph_iostore_mem_advise(addr, length, numa_node);
+
+	//Mappings of explicit huge pages are marked with 2, since they cannot be resized by normal pages
+	header = (oph_iostore_mem_header *) addr;
+	header->length = length;
+	header->is_mapped = is_mapped;
+
+	return header + 1;
+}
+
+void *oph_iostore_mem_realloc(void *ptr, size_t size, int numa_node)
+{
+	if (!ptr)
+		return oph_iostore_mem_alloc(size, numa_node);
+
+	oph_iostore_mem_header *header = (oph_iostore_mem_header *) ptr - 1, *tmp = NULL;
+	size_t length = sizeof(oph_iostore_mem_header) + size;
+
+	//Regions served by malloc stay there as long as oph_iostore_mem_alloc would use it
+	if (!header->is_mapped && (size < OPH_IOSTORE_MEM_MAP_THRESHOLD || (memory_huge_pages == OPH_IOSTORE_HUGE_PAGES_NONE && memory_numa_policy == OPH_IOSTORE_NUMA_DEFAULT))) {
+		if (!(tmp = (oph_iostore_mem_header *) realloc(header, length))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return NULL;
+		}
+		tmp->length = length;
+		return tmp + 1;
+	}
+	//Mappings with normal pages shrink in place and grow without copying
+	if (header->is_mapped == 1) {
+		size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+		size_t old_pages = (header->length + page_size - 1) & ~(page_size - 1), new_pages = (length + page_size - 1) & ~(page_size - 1);
+		if (new_pages <= old_pages) {
+			if (new_pages < old_pages)
+				munmap((char *) header + new_pages, old_pages - new_pages);
+			header->length = length;
+			return ptr;
+		}
+#ifdef MREMAP_MAYMOVE
+		void *addr = mremap(header, old_pages, new_pages, MREMAP_MAYMOVE);
+		if (addr != MAP_FAILED) {
+			oph_iostore_mem_advise((char *) addr + old_pages, new_pages - old_pages, numa_node);
+			tmp = (oph_iostore_mem_header *) addr;
+			tmp->length = length;
+			return tmp + 1;
+		}
+#endif
+	} else if (header->is_mapped && length <= header->length)
+		return ptr;
+
+	void *new_ptr = oph_iostore_mem_alloc(size, numa_node);
+	if (!new_ptr)
+		return NULL;
+	memcpy(new_ptr, ptr, header->length - sizeof(oph_iostore_mem_header) < size ? header->length - sizeof(oph_iostore_mem_header) : size);
+	oph_iostore_mem_free(ptr);
+
+	return new_ptr;
+}
+
+void oph_iostore_mem_free(void *ptr)
+{
+	if (!ptr)
+		return;
+
+	oph_iostore_mem_header *header = (oph_iostore_mem_header *) ptr - 1;
+	if (header->is_mapped)
+		munmap(header, header->length);
+	else
+		free(header);
+}
+
+int oph_iostore_run_on_node(int numa_node)
+{
+#ifdef OPH_IOSTORE_NUMA
+	//A negative node lets the thread run on any node again
+	if (memory_numa_policy != OPH_IOSTORE_NUMA_DEFAULT && numa_run_on_node(numa_node >= 0 ? numa_node : -1)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NUMA_NODE_ERROR, numa_node);
+		logging(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NUMA_NODE_ERROR, numa_node);
+		return OPH_IOSTORAGE_UTILITY_ERROR;
+	}
+#endif
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_arena_create(oph_iostore_arena ** arena)
+{
+	if (!arena) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*arena = (oph_iostore_arena *) malloc(1 * sizeof(oph_iostore_arena));
+	if (!*arena) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	(*arena)->head = NULL;
+	(*arena)->next_chunk_size = OPH_IOSTORE_ARENA_MIN_CHUNK;
+	(*arena)->size = 0;
+	(*arena)->numa_node = -1;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+void *oph_iostore_arena_alloc(oph_iostore_arena * arena, size_t size)
+{
+	if (!arena) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return NULL;
+	}
+
+	size = (size + OPH_IOSTORE_ARENA_ALIGN - 1) & ~((size_t) OPH_IOSTORE_ARENA_ALIGN - 1);
+
+	oph_iostore_arena_chunk *chunk = arena->head;
+	if (!chunk || (chunk->size - chunk->used) < size) {
+		//Chunks grow geometrically; regions bigger than a chunk get a dedicated one
+		size_t chunk_size = arena->next_chunk_size;
+		if (chunk_size < size)
+			chunk_size = size;
+		if (arena->next_chunk_size < OPH_IOSTORE_ARENA_MAX_CHUNK)
+			arena->next_chunk_size <<= 1;
+
+		chunk = (oph_iostore_arena_chunk *) oph_iostore_mem_alloc(sizeof(oph_iostore_arena_chunk) + chunk_size, arena->numa_node);
+		if (!chunk) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return NULL;
+		}
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = arena->head;
+		arena->head = chunk;
+		arena->size += sizeof(oph_iostore_arena_chunk) + chunk_size;
+	}
+
+	void *ptr = chunk->data + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
+int oph_iostore_arena_reset(oph_iostore_arena * arena)
+{
+	if (!arena) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (!arena->head)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	//The newest chunk is kept for the next requests
+	oph_iostore_arena_chunk *chunk = arena->head->next, *next = NULL;
+	while (chunk) {
+		next = chunk->next;
+		oph_iostore_mem_free(chunk);
+		chunk = next;
+	}
+	arena->head->next = NULL;
+	arena->head->used = 0;
+	arena->size = sizeof(oph_iostore_arena_chunk) + arena->head->size;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_arena_destroy(oph_iostore_arena ** arena)
+{
+	if (!arena || !*arena) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	oph_iostore_arena_chunk *chunk = (*arena)->head, *next = NULL;
+	while (chunk) {
+		next = chunk->next;
+		oph_iostore_mem_free(chunk);
+		chunk = next;
+	}
+	free(*arena);
+	*arena = NULL;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_alloc_frag_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record)
+{
+	if (!record_set || !record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (!record_set->arena)
+		return oph_iostore_create_frag_record(record, record_set->field_num);
+
+	//Record, lengths and cell pointers are reserved with a single request
+	size_t field_num = record_set->field_num;
+	char *region = (char *) oph_iostore_arena_alloc(record_set->arena, sizeof(oph_iostore_frag_record) + field_num * (sizeof(unsigned long long) + sizeof(void *)));
+	if (!region) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		*record = NULL;
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	*record = (oph_iostore_frag_record *) region;
+	(*record)->field_length = (unsigned long long *) (region + sizeof(oph_iostore_frag_record));
+	(*record)->field = (void **) (region + sizeof(oph_iostore_frag_record) + field_num * sizeof(unsigned long long));
+	memset((*record)->field_length, 0, field_num * sizeof(unsigned long long));
+	memset((*record)->field, 0, field_num * sizeof(void *));
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_release_frag_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record)
+{
+	if (!record_set || !record || !*record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (!record_set->arena)
+		return oph_iostore_destroy_frag_record(record, record_set->field_num);
+
+	*record = NULL;
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+void *oph_iostore_alloc_frag_cell(oph_iostore_frag_record_set * record_set, const void *value, unsigned long long length)
+{
+	if (!record_set || !value) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return NULL;
+	}
+
+	if (!record_set->arena)
+		return memdup(value, length);
+
+	void *cell = oph_iostore_arena_alloc(record_set->arena, length);
+	if (cell)
+		memcpy(cell, value, length);
+
+	return cell;
+}
+
+int oph_iostore_share_frag_recordset(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record_set * source)
+{
+	if (!record_set || !source) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	unsigned short l;
+	for (l = 0; l < record_set->shared_num; l++)
+		if (record_set->shared[l] == source)
+			return OPH_IOSTORAGE_SUCCESS;
+
+	oph_iostore_frag_record_set **tmp = (oph_iostore_frag_record_set **) realloc(record_set->shared, (record_set->shared_num + 1) * sizeof(oph_iostore_frag_record_set *));
+	if (!tmp) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	record_set->shared = tmp;
+
+	__sync_add_and_fetch(&(source->ref_count), 1);
+	record_set->shared[record_set->shared_num++] = source;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_retain_frag_recordset(oph_iostore_frag_record_set * record_set)
+{
+	if (!record_set) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	__sync_add_and_fetch(&(record_set->ref_count), 1);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
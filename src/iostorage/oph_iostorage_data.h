@@ -19,6 +19,23 @@
 #ifndef __OPH_IOSTORAGE_DATA_H
 #define __OPH_IOSTORAGE_DATA_H
 
+#include <stddef.h>
+
+#define OPH_IOSTORE_ARENA_MIN_CHUNK   65536
+#define OPH_IOSTORE_ARENA_MAX_CHUNK   16777216
+#define OPH_IOSTORE_ARENA_ALIGN       16
+
+#define OPH_IOSTORE_MEM_MAP_THRESHOLD 65536
+#define OPH_IOSTORE_MEM_HUGE_PAGE     2097152
+
+#define OPH_IOSTORE_COLUMN_MIN_CELLS  64
+#define OPH_IOSTORE_COLUMN_MIN_DATA   4096
+
+#define OPH_IOSTORE_IMAGE_MAGIC       "OPHFRAG2"
+#define OPH_IOSTORE_IMAGE_MAGIC_LEN   8
+#define OPH_IOSTORE_IMAGE_ALIGN       8
+#define OPH_IOSTORE_IMAGE_PAD(size)   (((size) + OPH_IOSTORE_IMAGE_ALIGN - 1) & ~((unsigned long long) OPH_IOSTORE_IMAGE_ALIGN - 1))
+
 /**
  * \brief			          Enum with possible field types (also used as plugin return types)
  */
@@ -28,6 +45,33 @@ typedef enum {
 	OPH_IOSTORE_STRING_TYPE
 } oph_iostore_field_type;
 
+/**
+ * \brief			          Enum with possible physical layouts of a fragment record set
+ */
+typedef enum {
+	OPH_IOSTORE_ROW_LAYOUT,
+	OPH_IOSTORE_COLUMN_LAYOUT
+} oph_iostore_frag_layout;
+
+/**
+ * \brief			          Enum with possible huge page policies for fragment memory
+ */
+typedef enum {
+	OPH_IOSTORE_HUGE_PAGES_NONE,
+	OPH_IOSTORE_HUGE_PAGES_TRANSPARENT,
+	OPH_IOSTORE_HUGE_PAGES_EXPLICIT
+} oph_iostore_huge_pages;
+
+/**
+ * \brief			          Enum with possible NUMA placement policies for fragment memory
+ */
+typedef enum {
+	OPH_IOSTORE_NUMA_DEFAULT,
+	OPH_IOSTORE_NUMA_LOCAL,
+	OPH_IOSTORE_NUMA_INTERLEAVE,
+	OPH_IOSTORE_NUMA_BIND
+} oph_iostore_numa_policy;
+
 /**
  * \brief			          Structure for storing information about a fragment record (a single table row)
  * \param field_length 	Array containing the length for each cell in the record
@@ -38,24 +82,175 @@ typedef struct {
 	void **field;
 } oph_iostore_frag_record;
 
+/**
+ * \brief			          Structure for a memory chunk of an arena
+ * \param next 	        Pointer to previously allocated chunk
+ * \param size			    Size of data region
+ * \param used			    Bytes already reserved in data region
+ * \param data			    Data region
+ */
+typedef struct _oph_iostore_arena_chunk {
+	struct _oph_iostore_arena_chunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+} oph_iostore_arena_chunk;
+
+/**
+ * \brief			          Bump-pointer arena used to allocate records and cells of a record set; memory is only released all at once
+ * \param head 	        Chunk currently used for allocations
+ * \param next_chunk_size Size of the next chunk to be allocated (doubled up to OPH_IOSTORE_ARENA_MAX_CHUNK)
+ * \param size			    Total size of the allocated chunks
+ * \param numa_node     NUMA node chunks are bound to (-1 to follow the default placement)
+ */
+typedef struct {
+	oph_iostore_arena_chunk *head;
+	size_t next_chunk_size;
+	unsigned long long size;
+	int numa_node;
+} oph_iostore_arena;
+
+/**
+ * \brief			          Structure containing a contiguous column of a columnar record set
+ * \param offset 	      Array of cell_num+1 offsets in data; length of cell i is offset[i+1]-offset[i]
+ * \param data			    Contiguous region with the values of all the cells in the column
+ * \param is_shared     Flag set to 1 if data belongs to a shared record set (it is not freed with the column)
+ * \param cell_num      Number of cells in the column (it differs from the row number only while the column is being built)
+ * \param cell_capacity Number of cells offset can describe before it has to grow (0 if unknown)
+ * \param data_capacity Size of data before it has to grow (0 if unknown)
+ */
+typedef struct {
+	unsigned long long *offset;
+	char *data;
+	char is_shared;
+	unsigned long long cell_num;
+	unsigned long long cell_capacity;
+	unsigned long long data_capacity;
+} oph_iostore_frag_column;
+
+/**
+ * \brief			          Value of a scalar cell, interpreted according to the type of the field
+ * \param long_value    Value of a LONG cell
+ * \param double_value  Value of a REAL cell
+ */
+typedef union {
+	long long long_value;
+	double double_value;
+} oph_iostore_field_value;
+
+/**
+ * \brief			          Zone map of a column, used to skip a fragment (or jump to a row range) without reading its cells
+ * \param count         Number of cells summarized by the statistics (0 if no statistics are available, e.g. for binary columns)
+ * \param is_sequential Flag set to 1 if each value is the previous one plus 1 (LONG columns only): the row of value v is v-min
+ * \param min           Minimum value of the column
+ * \param max           Maximum value of the column
+ */
+typedef struct {
+	unsigned long long count;
+	unsigned long long is_sequential;
+	oph_iostore_field_value min;
+	oph_iostore_field_value max;
+} oph_iostore_field_stats;
+
+/**
+ * \brief			          Header of the binary image of a fragment. Offsets are relative to the beginning of the image and aligned to OPH_IOSTORE_IMAGE_ALIGN bytes
+ * \param magic         Magic string identifying the image format (OPH_IOSTORE_IMAGE_MAGIC)
+ * \param image_size    Total length of the image
+ * \param row_num       Number of rows of the fragment
+ * \param field_num     Number of fields of the fragment; field_num descriptors follow the header
+ * \param id_field      Index of the implicit id column (-1 if every column is stored)
+ * \param id_start      Id of the first row if id_field is set
+ * \param name_offset   Offset of the null-terminated fragment name
+ */
+typedef struct {
+	char magic[OPH_IOSTORE_IMAGE_MAGIC_LEN];
+	unsigned long long image_size;
+	unsigned long long row_num;
+	unsigned long long field_num;
+	long long id_field;
+	long long id_start;
+	unsigned long long name_offset;
+} oph_iostore_frag_image_header;
+
+/**
+ * \brief			          Descriptor of a column in the binary image of a fragment
+ * \param type          Type of the field
+ * \param name_offset   Offset of the null-terminated field name
+ * \param offset_offset Offset of the row_num+1 cell offsets of the column (0 for the implicit id column)
+ * \param data_offset   Offset of the contiguous cells of the column (0 for the implicit id column)
+ * \param stats         Zone map of the column (count is 0 if it was not available)
+ */
+typedef struct {
+	unsigned long long type;
+	unsigned long long name_offset;
+	unsigned long long offset_offset;
+	unsigned long long data_offset;
+	oph_iostore_field_stats stats;
+} oph_iostore_frag_image_field;
+
 /**
  * \brief			          Structure containing information about a fragment record set (entire table)
  * \param frag_name		  Name of Fragment
  * \param field_num 	  Number of fields contained in records
  * \param field_name		Array with field (columns) names
  * \param field_type		Array containing type of each cell
- * \param record_set		NULL terminated array with pointers to actual records
+ * \param record_set		NULL terminated array with pointers to actual records (NULL with columnar layout)
  * \param tmp_flag			Flag set to 1 if the table is considered as a temporary one (deleted at the end of the operation)
+ * \param layout			  Physical layout of the records (row or columnar)
+ * \param row_num			  Number of rows (only meaningful with columnar layout)
+ * \param column			  Array of field_num columns (only with columnar layout)
+ * \param view			    Block of records pointing into the columns of a columnar origin, owned by the record set reading them
+ * \param arena			    Arena owning records and cells (if NULL each record and cell is allocated separately)
+ * \param id_field		  Index of the implicit id column (-1 if every column is materialized)
+ * \param id_start		  Id of the first row when id_field is set: ids are id_start + row index
+ * \param id_base		    First record of the block used to compute the row index of a record when id_field is set (not owned)
+ * \param ref_count		  Number of owners of the record set; it is released when the last one destroys it
+ * \param origin		    Record set the records of a view belong to (NULL if the record set owns its records)
+ * \param shared		    Array of record sets whose cells are referenced by this record set
+ * \param shared_num		Number of record sets in shared
+ * \param map_addr		  Read-only mapping holding offsets and data of every column (NULL if columns are allocated in memory)
+ * \param map_size		  Length of the file mapping
+ * \param stats		      Array of field_num zone maps (NULL if statistics have not been computed)
+ * \param numa_node		  NUMA node holding the memory of the record set (-1 if unknown or spread over several nodes)
  */
-typedef struct {
+typedef struct _oph_iostore_frag_record_set {
 	char *frag_name;
 	unsigned short field_num;
 	char **field_name;
 	oph_iostore_field_type *field_type;
 	oph_iostore_frag_record **record_set;
 	char tmp_flag;
+	oph_iostore_frag_layout layout;
+	unsigned long long row_num;
+	oph_iostore_frag_column *column;
+	oph_iostore_frag_record *view;
+	oph_iostore_arena *arena;
+	short int id_field;
+	long long id_start;
+	oph_iostore_frag_record *id_base;
+	unsigned int ref_count;
+	struct _oph_iostore_frag_record_set *origin;
+	struct _oph_iostore_frag_record_set **shared;
+	unsigned short shared_num;
+	void *map_addr;
+	size_t map_size;
+	oph_iostore_field_stats *stats;
+	int numa_node;
 } oph_iostore_frag_record_set;
 
+/**
+ * \brief			          Macros to check if a column is an implicit id column and to compute the id of a record of such record set
+ */
+#define OPH_IOSTORE_IS_IMPLICIT_ID(rs, col) ((rs)->id_field >= 0 && (rs)->id_field == (int) (col))
+#define OPH_IOSTORE_RECORD_ID(rs, rec) ((rs)->id_start + (long long) ((rec) - (rs)->id_base))
+#define OPH_IOSTORE_ROW_ID(rs, row) ((rs)->record_set ? OPH_IOSTORE_RECORD_ID(rs, (rs)->record_set[row]) : (rs)->id_start + (long long) (row))
+
+/**
+ * \brief			          Macros to access a cell (and its length) of a record set regardless of its layout (implicit ids have to be read with OPH_IOSTORE_ROW_ID)
+ */
+#define OPH_IOSTORE_FIELD(rs, row, col) ((rs)->layout == OPH_IOSTORE_COLUMN_LAYOUT && !OPH_IOSTORE_IS_IMPLICIT_ID(rs, col) ? (void *) ((rs)->column[col].data + (rs)->column[col].offset[row]) : (rs)->record_set[row]->field[col])
+#define OPH_IOSTORE_FIELD_LENGTH(rs, row, col) ((rs)->layout == OPH_IOSTORE_COLUMN_LAYOUT && !OPH_IOSTORE_IS_IMPLICIT_ID(rs, col) ? (rs)->column[col].offset[(row) + 1] - (rs)->column[col].offset[row] : (rs)->record_set[row]->field_length[col])
+
 /**
  * \brief			          Structure containing information about a DB record set
  * \param db_name		    Name of DB
@@ -93,7 +288,7 @@ int oph_iostore_compare_id(oph_iostore_resource_id id1, oph_iostore_resource_id
 int oph_iostore_copy_frag_record(oph_iostore_frag_record * input_record, unsigned short input_field_num, oph_iostore_frag_record ** output_record);
 
 /**
- * \brief			              Copy a fragment record_set (it does not copy the frag_name)
+ * \brief			              Copy a fragment record_set (it does not copy the frag_name). Cells are not duplicated: the copy references them and keeps the input alive
  * \param input_record_set  Record to be copied
  * \param output_record_set  Record copied
  * \return                  0 if successfull, non-0 otherwise
@@ -101,7 +296,9 @@ int oph_iostore_copy_frag_record(oph_iostore_frag_record * input_record, unsigne
 int oph_iostore_copy_frag_record_set(oph_iostore_frag_record_set * input_record_set, oph_iostore_frag_record_set ** output_record_set);
 
 /**
- * \brief			              Copy a fragment record_set by specifying a limit (it does not copy the frag_name)
+ * \brief			              Copy a fragment record_set by specifying a limit (it does not copy the frag_name).
+ *                          Cells are not duplicated: the copy of a columnar input references a range of its columns, otherwise records point at the input cells.
+ *                          The input is kept alive until the copy is destroyed.
  * \param input_record_set  Record to be copied
  * \param output_record_set  Record copied
  * \param limit Copy up to 'limit' rows; all the rows are extracted using '0'
@@ -111,7 +308,8 @@ int oph_iostore_copy_frag_record_set(oph_iostore_frag_record_set * input_record_
 int oph_iostore_copy_frag_record_set_limit(oph_iostore_frag_record_set * input_record_set, oph_iostore_frag_record_set ** output_record_set, long long limit, long long offset);
 
 /**
- * \brief			              Copy a fragment record_set structure only by specifying a limit (it does not copy the frag_name and the internal record set)
+ * \brief			              Copy a fragment record_set structure only by specifying a limit (it does not copy the frag_name and the internal record set).
+ *                          If the input is columnar, the copy owns a block of views on its rows (view) that can be used to fill the record set.
  * \param input_record_set  Record to be copied
  * \param output_record_set  Record copied
  * \param limit Copy up to 'limit' rows; all the rows are extracted using '0'
@@ -137,7 +335,7 @@ int oph_iostore_destroy_frag_record(oph_iostore_frag_record ** record, short int
 int oph_iostore_create_frag_record(oph_iostore_frag_record ** record, short int field_num);
 
 /**
- * \brief			        Destroy a record set and release resources
+ * \brief			        Destroy a record set and release resources. If the record set is shared, only the reference of the caller is dropped.
  * \param record_set  Record set to be freed
  * \return            0 if successfull, non-0 otherwise
  */
@@ -177,4 +375,237 @@ int oph_iostore_create_frag_recordset_only(oph_iostore_frag_record_set ** record
  */
 int oph_iostore_create_sample_frag(const long long row_number, const long long array_length, oph_iostore_frag_record_set ** record_set);
 
+/**
+ * \brief			        Count the rows of a record set (any layout)
+ * \param record_set  Record set to be evaluated
+ * \return            Number of rows
+ */
+unsigned long long oph_iostore_get_frag_row_num(oph_iostore_frag_record_set * record_set);
+
+/**
+ * \brief			        Switch an empty record set to columnar layout, so that its rows are appended directly to growable columns
+ * \param record_set  Record set to be switched (it must not contain any row)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_create_frag_columns(oph_iostore_frag_record_set * record_set);
+
+/**
+ * \brief			        Append a cell to a column of a columnar record set. Cells of a column have to be appended in row order; the id column is kept implicit
+ *                    as long as its values are strictly sequential.
+ * \param record_set  Record set being built
+ * \param col         Index of the column
+ * \param value       Value of the cell (it can be NULL if length is 0)
+ * \param length      Length of the value
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_append_frag_cell(oph_iostore_frag_record_set * record_set, unsigned short col, const void *value, unsigned long long length);
+
+/**
+ * \brief			        Append a record to a columnar record set. The record is released (records of a columnar record set only live until they are appended).
+ * \param record_set  Record set being built
+ * \param record      Record created with oph_iostore_alloc_frag_record
+ * \return            0 if successfull, non-0 otherwise (the rows of the record set are left unchanged)
+ */
+int oph_iostore_append_frag_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record);
+
+/**
+ * \brief			        Complete the columns of a record set built cell by cell: every column is cut to row_num cells and its buffers are shrunk to fit
+ * \param record_set  Record set being built
+ * \param row_num     Number of rows of the record set (each column must contain at least row_num cells)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_seal_frag_columns(oph_iostore_frag_record_set * record_set, unsigned long long row_num);
+
+/**
+ * \brief			        Convert a record set with row layout into a columnar record set (in place). Records are released.
+ *                    A strictly sequential id column is not materialized and is turned into an implicit id column.
+ * \param record_set  Record set to be converted
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_frag_recordset_to_columns(oph_iostore_frag_record_set * record_set);
+
+/**
+ * \brief			        Append a batch of rows given as columns to a record set (converted to columnar layout if needed). Columns are grown geometrically
+ *                    and the batch is appended in place; the columns of the first batch are adopted as they are. The id column of the first batch is made
+ *                    implicit if it is strictly sequential, and later batches keep it implicit as long as they continue the sequence.
+ * \param record_set  Record set to be extended
+ * \param row_num     Number of rows in the batch
+ * \param column      Array of field_num columns allocated with oph_iostore_mem_alloc (offsets with malloc); on success they are owned by the record set and reset
+ * \return            0 if successfull, non-0 otherwise (the rows of the record set are left unchanged)
+ */
+int oph_iostore_append_frag_columns(oph_iostore_frag_record_set * record_set, unsigned long long row_num, oph_iostore_frag_column * column);
+
+/**
+ * \brief			        Release offsets and data of an array of columns (the array itself is not freed)
+ * \param column      Array of columns (it can be NULL)
+ * \param field_num   Number of columns in the array
+ */
+void oph_iostore_free_frag_columns(oph_iostore_frag_column * column, unsigned short field_num);
+
+/**
+ * \brief			        Compute (or refresh) the zone map of each LONG and REAL column of a record set (any layout)
+ * \param record_set  Record set to be evaluated
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_compute_frag_stats(oph_iostore_frag_record_set * record_set);
+
+/**
+ * \brief			        Compute the length of the binary image of a record set (any layout)
+ * \param record_set  Record set to be evaluated
+ * \param size        Length in bytes of the image
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_get_frag_image_size(oph_iostore_frag_record_set * record_set, unsigned long long *size);
+
+/**
+ * \brief			        Write the binary image of a record set: columns are stored contiguously so that the image can be used in place
+ * \param record_set  Record set to be written (it is not modified)
+ * \param image       Buffer of at least size bytes, aligned to OPH_IOSTORE_IMAGE_ALIGN bytes
+ * \param size        Length of the image computed by oph_iostore_get_frag_image_size
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_write_frag_image(oph_iostore_frag_record_set * record_set, char *image, unsigned long long size);
+
+/**
+ * \brief			        Build a columnar record set on top of the binary image of a fragment contained in a read-only mapping.
+ *                    Columns are used in place and the mapping is released with the record set.
+ * \param image       Address of the image inside the mapping
+ * \param size        Length of the image
+ * \param map_addr    Address of the mapping (it is owned by the record set on success)
+ * \param map_size    Length of the mapping
+ * \param record_set  Record set created
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_map_frag_image(char *image, unsigned long long size, void *map_addr, size_t map_size, oph_iostore_frag_record_set ** record_set);
+
+/**
+ * \brief			        Compute the memory footprint of the records contained in a record set (any layout)
+ * \param record_set  Record set to be evaluated
+ * \param size        Size in bytes
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_get_frag_recordset_size(oph_iostore_frag_record_set * record_set, unsigned long long *size);
+
+/**
+ * \brief			        Set the huge page and NUMA policies used for fragment memory. It should be called before any fragment is created.
+ * \param huge_pages  Huge page policy
+ * \param numa_policy NUMA placement policy (it falls back to OPH_IOSTORE_NUMA_DEFAULT if NUMA is not supported)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_set_memory_policy(oph_iostore_huge_pages huge_pages, oph_iostore_numa_policy numa_policy);
+
+/**
+ * \brief			        Choose the NUMA node for the memory of a new fragment according to the placement policy
+ * \return            Node index, -1 if the memory is not bound to a single node
+ */
+int oph_iostore_mem_get_node();
+
+/**
+ * \brief			        Allocate fragment memory according to the huge page and NUMA policies
+ * \param size        Size of the region
+ * \param numa_node   Node the region has to be bound to (-1 to follow the default placement)
+ * \return            Pointer to the region (aligned to 16 bytes), NULL in case of error
+ */
+void *oph_iostore_mem_alloc(size_t size, int numa_node);
+
+/**
+ * \brief			        Resize a region allocated with oph_iostore_mem_alloc; the content is preserved up to the smaller size
+ * \param ptr         Region to be resized (a new region is allocated if it is NULL)
+ * \param size        New size of the region
+ * \param numa_node   Node the region has to be bound to (-1 to follow the default placement)
+ * \return            Pointer to the region (aligned to 16 bytes), NULL in case of error (the original region is left unchanged)
+ */
+void *oph_iostore_mem_realloc(void *ptr, size_t size, int numa_node);
+
+/**
+ * \brief			        Release a region allocated with oph_iostore_mem_alloc
+ * \param ptr         Region to be freed (it can be NULL)
+ */
+void oph_iostore_mem_free(void *ptr);
+
+/**
+ * \brief			        Apply the huge page and NUMA policies to an existing anonymous mapping, before it is touched
+ * \param addr        Address of the mapping (page aligned)
+ * \param length      Length of the mapping
+ * \param numa_node   Node the mapping has to be bound to (-1 to follow the default placement)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_mem_advise(void *addr, size_t length, int numa_node);
+
+/**
+ * \brief			        Restrict the calling thread to the CPUs of a NUMA node, so that it runs near the memory of a fragment
+ * \param numa_node   Node index (-1 to run on any node); nothing is done with the default NUMA policy
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_run_on_node(int numa_node);
+
+/**
+ * \brief			        Create an empty arena
+ * \param arena       Arena to be allocated
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_arena_create(oph_iostore_arena ** arena);
+
+/**
+ * \brief			        Reserve a memory region from an arena
+ * \param arena       Arena to be used
+ * \param size        Size of the region
+ * \return            Pointer to the region, NULL in case of error
+ */
+void *oph_iostore_arena_alloc(oph_iostore_arena * arena, size_t size);
+
+/**
+ * \brief			        Release every region reserved from an arena at once, keeping its last chunk for the next requests
+ * \param arena       Arena to be reset
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_arena_reset(oph_iostore_arena * arena);
+
+/**
+ * \brief			        Release all the chunks of an arena
+ * \param arena       Arena to be freed
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_arena_destroy(oph_iostore_arena ** arena);
+
+/**
+ * \brief			        Create an empty record owned by a record set (it uses the arena of the record set, if available)
+ * \param record_set  Record set that will contain the record
+ * \param record      Record to be allocated
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_alloc_frag_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record);
+
+/**
+ * \brief			        Release a record created with oph_iostore_alloc_frag_record (arena memory is only reclaimed with the record set)
+ * \param record_set  Record set owning the record
+ * \param record      Record to be freed
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_release_frag_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record);
+
+/**
+ * \brief			        Copy a cell value into memory owned by a record set
+ * \param record_set  Record set owning the cell
+ * \param value       Value to be copied
+ * \param length      Length of the value
+ * \return            Pointer to the copy, NULL in case of error
+ */
+void *oph_iostore_alloc_frag_cell(oph_iostore_frag_record_set * record_set, const void *value, unsigned long long length);
+
+/**
+ * \brief			        Make a record set reference the cells of another one (usually the origin of a view), which is kept alive until the first is destroyed
+ * \param record_set  Record set referencing the cells
+ * \param source      Record set owning the cells
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_share_frag_recordset(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record_set * source);
+
+/**
+ * \brief			        Add an owner to a record set, so that it is kept alive until the owner destroys it as well
+ * \param record_set  Record set to be retained
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_retain_frag_recordset(oph_iostore_frag_record_set * record_set);
+
 #endif				/* __OPH_IOSTORAGE_DATA_H */
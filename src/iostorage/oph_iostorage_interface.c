@@ -35,36 +35,81 @@
 extern int msglevel;
 extern pthread_mutex_t libtool_lock;
 
-static int oph_iostore_find_device(const char *device, char **dyn_lib, unsigned short int *is_persitent);
+static int oph_iostore_find_device(const char *device, char **dyn_lib, unsigned short int *is_persitent, oph_iostore_frag_layout * layout);
 
-int oph_iostore_setup(const char *device, oph_iostore_handler ** handle)
+//Devices loaded by the server: each one keeps the handle shared by all the queries
+typedef struct _oph_iostore_device {
+	oph_iostore_handler handle;
+	struct _oph_iostore_device *next;
+} oph_iostore_device;
+
+static oph_iostore_device *device_registry = NULL;
+static char data_prefix[OPH_IOSTORAGE_BUFLEN] = OPH_SERVER_PREFIX;
+static unsigned long long memory_budget = 0;
+static unsigned int compression_delay = 0;
+
+void oph_iostore_set_data_prefix(char *p)
 {
-	if (!handle) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
-		return OPH_IOSTORAGE_NULL_HANDLE;
+	snprintf(data_prefix, OPH_IOSTORAGE_BUFLEN, "%s", p);
+}
+
+void oph_iostore_set_memory_budget(unsigned long long budget)
+{
+	memory_budget = budget;
+}
+
+void oph_iostore_set_compression_delay(unsigned int delay)
+{
+	compression_delay = delay;
+}
+
+//Resolve a function of a device library
+static lt_ptr oph_iostore_load_function(lt_dlhandle dlh, const char *format, const char *device)
+{
+	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, format, device);
+
+	lt_ptr func = lt_dlsym(dlh, func_name);
+	if (!func) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, func_name);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, func_name);
 	}
-	//If already executed don't procede further
-	if ((*handle) && (*handle)->dlh)
-		return OPH_IOSTORAGE_SUCCESS;
+	return func;
+}
 
-	oph_iostore_handler *internal_handle = (oph_iostore_handler *) malloc(sizeof(oph_iostore_handler));
-	if (internal_handle == NULL) {
+static void oph_iostore_free_device(oph_iostore_device * dev)
+{
+	if (dev->handle.device)
+		free(dev->handle.device);
+	if (dev->handle.lib)
+		free(dev->handle.lib);
+	if (dev->handle.data_dir)
+		free(dev->handle.data_dir);
+	free(dev);
+}
+
+//Open the library of a device, resolve its functions and add it to the registry (libtool_lock must be held)
+static int oph_iostore_load_device(const char *device, oph_iostore_device ** dev)
+{
+	oph_iostore_device *internal_dev = (oph_iostore_device *) calloc(1, sizeof(oph_iostore_device));
+	if (internal_dev == NULL) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
 
-	internal_handle->device = NULL;
-	internal_handle->lib = NULL;
-	internal_handle->dlh = NULL;
+	oph_iostore_handler *internal_handle = &(internal_dev->handle);
+	internal_handle->is_persistent = 0;
+	internal_handle->layout = OPH_IOSTORE_ROW_LAYOUT;
+	internal_handle->memory_budget = memory_budget;
+	internal_handle->compression_delay = compression_delay;
 
 	//Set storage device type
 	internal_handle->device = (char *) strndup(device, strlen(device));
 	if (internal_handle->device == NULL) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
-		free(internal_handle);
+		oph_iostore_free_device(internal_dev);
 		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
 	//Convert device name to lower case
@@ -74,120 +119,213 @@ int oph_iostore_setup(const char *device, oph_iostore_handler ** handle)
 		i++;
 	}
 
-	//LTDL_SET_PRELOADED_SYMBOLS();
-	pthread_mutex_lock(&libtool_lock);
-	if (lt_dlinit() != 0) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLINIT_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLINIT_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		free(internal_handle->device);
-		free(internal_handle);
-		return OPH_IOSTORAGE_DLOPEN_ERR;
+	char data_dir[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	int n = snprintf(data_dir, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_DATA_DIR, data_prefix, internal_handle->device);
+	if (n < 0 || n >= OPH_IOSTORAGE_BUFLEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_PATH_TOO_LONG, internal_handle->device);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_PATH_TOO_LONG, internal_handle->device);
+		oph_iostore_free_device(internal_dev);
+		return OPH_IOSTORAGE_BAD_PARAMETER;
+	}
+	internal_handle->data_dir = (char *) strndup(data_dir, OPH_IOSTORAGE_BUFLEN);
+	if (internal_handle->data_dir == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		oph_iostore_free_device(internal_dev);
+		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	if (oph_iostore_find_device(internal_handle->device, &internal_handle->lib, &internal_handle->is_persistent)) {
+	if (oph_iostore_find_device(internal_handle->device, &internal_handle->lib, &internal_handle->is_persistent, &internal_handle->layout)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LIB_NOT_FOUND);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LIB_NOT_FOUND);
-		free(internal_handle->device);
-		free(internal_handle);
+		oph_iostore_free_device(internal_dev);
 		return OPH_IOSTORAGE_LIB_NOT_FOUND;
 	}
 
-	pthread_mutex_lock(&libtool_lock);
+	//LTDL_SET_PRELOADED_SYMBOLS();
+	if (lt_dlinit() != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLINIT_ERROR, lt_dlerror());
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLINIT_ERROR, lt_dlerror());
+		oph_iostore_free_device(internal_dev);
+		return OPH_IOSTORAGE_DLOPEN_ERR;
+	}
+
 	if (!(internal_handle->dlh = (lt_dlhandle) lt_dlopen(internal_handle->lib))) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLOPEN_ERROR, lt_dlerror());
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLOPEN_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		free(internal_handle->lib);
-		free(internal_handle->device);
-		free(internal_handle);
+		lt_dlexit();
+		oph_iostore_free_device(internal_dev);
 		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
+	//Devices may keep their own state (e.g. the fragments spilled by memory device) until the server stops
+	lt_dlmakeresident(internal_handle->dlh);
+
+	oph_iostore_device_api *api = &(internal_handle->api);
+	if (!(api->setup = (int (*)(oph_iostore_handler *)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_SETUP_FUNC, internal_handle->device))
+	    || !(api->cleanup = (int (*)(oph_iostore_handler *)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_CLEANUP_FUNC, internal_handle->device))
+	    || !(api->get_db =
+		 (int (*)(oph_iostore_handler *, oph_iostore_resource_id *, oph_iostore_db_record_set **)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_GET_DB_FUNC,
+														      internal_handle->device))
+	    || !(api->put_db =
+		 (int (*)(oph_iostore_handler *, oph_iostore_db_record_set *, oph_iostore_resource_id **)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_PUT_DB_FUNC,
+														      internal_handle->device))
+	    || !(api->delete_db =
+		 (int (*)(oph_iostore_handler *, oph_iostore_resource_id *)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_DELETE_DB_FUNC, internal_handle->device))
+	    || !(api->get_frag =
+		 (int (*)(oph_iostore_handler *, oph_iostore_resource_id *, oph_iostore_frag_record_set **)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_GET_FRAG_FUNC,
+															internal_handle->device))
+	    || !(api->put_frag =
+		 (int (*)(oph_iostore_handler *, oph_iostore_frag_record_set *, oph_iostore_resource_id **)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_PUT_FRAG_FUNC,
+															internal_handle->device))
+	    || !(api->delete_frag =
+		 (int (*)(oph_iostore_handler *, oph_iostore_resource_id *)) oph_iostore_load_function(internal_handle->dlh, OPH_IOSTORAGE_DELETE_FRAG_FUNC, internal_handle->device))) {
+		lt_dlclose(internal_handle->dlh);
+		lt_dlexit();
+		oph_iostore_free_device(internal_dev);
+		return OPH_IOSTORAGE_DLSYM_ERR;
+	}
+	//Batch functions are optional: single fragment functions are used otherwise
+	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_GET_FRAGS_FUNC, internal_handle->device);
+	api->get_frags = (int (*)(oph_iostore_handler *, oph_iostore_resource_id **, int, oph_iostore_frag_record_set **)) lt_dlsym(internal_handle->dlh, func_name);
+	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_PUT_FRAGS_FUNC, internal_handle->device);
+	api->put_frags = (int (*)(oph_iostore_handler *, oph_iostore_frag_record_set **, int, oph_iostore_resource_id **)) lt_dlsym(internal_handle->dlh, func_name);
+	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_DELETE_FRAGS_FUNC, internal_handle->device);
+	api->delete_frags = (int (*)(oph_iostore_handler *, oph_iostore_resource_id **, int)) lt_dlsym(internal_handle->dlh, func_name);
+
+	int res;
+	if ((res = api->setup(internal_handle))) {
+		lt_dlclose(internal_handle->dlh);
+		lt_dlexit();
+		oph_iostore_free_device(internal_dev);
+		return res;
+	}
+	//Publish the device only when it is completely initialized, since the registry is read without locking
+	internal_dev->next = device_registry;
+	__sync_synchronize();
+	device_registry = internal_dev;
+
+	if (dev)
+		*dev = internal_dev;
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+static oph_iostore_device *oph_iostore_find_loaded_device(const char *device)
+{
+	oph_iostore_device *dev = NULL;
+	for (dev = device_registry; dev; dev = dev->next)
+		if (!strcasecmp(dev->handle.device, device))
+			break;
+	return dev;
+}
+
+int oph_iostore_load_devices()
+{
+	FILE *fp = NULL;
+	char line[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	char value[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+	char dyn_lib_str[OPH_IOSTORAGE_BUFLEN] = { '\0' };
+
+	snprintf(dyn_lib_str, sizeof(dyn_lib_str), OPH_SERVER_DEVICE_FILE_PATH);
+
+	fp = fopen(dyn_lib_str, "r");
+	if (!fp) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FILE_NOT_FOUND, dyn_lib_str);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FILE_NOT_FOUND, dyn_lib_str);
+		return OPH_IOSTORAGE_LIB_NOT_FOUND;
+	}
+
+	//A device that cannot be loaded does not prevent the others from being used
+	pthread_mutex_lock(&libtool_lock);
+	while (fgets(line, OPH_IOSTORAGE_BUFLEN, fp)) {
+		if (sscanf(line, "[%[^]]", value) != 1 || oph_iostore_find_loaded_device(value))
+			continue;
+		if (oph_iostore_load_device(value, NULL)) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DEVICE_ERROR, value);
+			logging(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DEVICE_ERROR, value);
+		}
+	}
 	pthread_mutex_unlock(&libtool_lock);
+	fclose(fp);
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_SETUP_FUNC, internal_handle->device);
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_unload_devices()
+{
+	int res = OPH_IOSTORAGE_SUCCESS;
 
 	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_setup = (int (*)(oph_iostore_handler *)) lt_dlsym(internal_handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
+	oph_iostore_device *dev = device_registry, *next = NULL;
+	device_registry = NULL;
+	for (; dev; dev = next) {
+		next = dev->next;
+		if (dev->handle.api.cleanup(&(dev->handle))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_RELEASE_RES_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_RELEASE_RES_ERROR);
+			res = OPH_IOSTORAGE_INIT_HANDLE_ERR;
+		}
+		//Resident libraries are not closed, only libtool reference is released
+		if (lt_dlexit()) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLEXIT_ERROR, lt_dlerror());
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLEXIT_ERROR, lt_dlerror());
+			res = OPH_IOSTORAGE_DLEXIT_ERR;
+		}
+		oph_iostore_free_device(dev);
 	}
 	pthread_mutex_unlock(&libtool_lock);
 
-	*handle = internal_handle;
-	return _DEVICE_setup(*handle);
+	return res;
 }
 
-int oph_iostore_cleanup(oph_iostore_handler * handle)
+int oph_iostore_setup(const char *device, oph_iostore_handler ** handle)
 {
 	if (!handle) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
 		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
+	//If already executed don't procede further
+	if ((*handle) && (*handle)->dlh)
+		return OPH_IOSTORAGE_SUCCESS;
 
-	if (!handle->dlh || !handle->device) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
-		return OPH_IOSTORAGE_DLOPEN_ERR;
+	if (!device) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
 	}
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_CLEANUP_FUNC, handle->device);
-
-	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_cleanup = (int (*)(oph_iostore_handler *)) lt_dlsym(handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
+	oph_iostore_device *dev = oph_iostore_find_loaded_device(device);
+	if (!dev) {
+		//Device not listed at startup
+		int res;
+		pthread_mutex_lock(&libtool_lock);
+		if (!(dev = oph_iostore_find_loaded_device(device)) && (res = oph_iostore_load_device(device, &dev))) {
+			pthread_mutex_unlock(&libtool_lock);
+			return res;
+		}
 		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	//Release device resources
-	int res;
-	if ((res = _DEVICE_cleanup(handle))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_RELEASE_RES_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_RELEASE_RES_ERROR);
-		return res;
-	}
-	//Release handle resources
-	if (handle->device) {
-		free(handle->device);
-		handle->device = NULL;
-	}
-	if (handle->lib) {
-		free(handle->lib);
-		handle->lib = NULL;
-	}
+	*handle = &(dev->handle);
+	return OPH_IOSTORAGE_SUCCESS;
+}
 
-	pthread_mutex_lock(&libtool_lock);
-	if ((lt_dlclose(handle->dlh))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLCLOSE_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLCLOSE_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLCLOSE_ERR;
+int oph_iostore_cleanup(oph_iostore_handler * handle)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
-	pthread_mutex_unlock(&libtool_lock);
-	handle->dlh = NULL;
 
-	pthread_mutex_lock(&libtool_lock);
-	if (lt_dlexit()) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLEXIT_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_DLEXIT_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLEXIT_ERR;
+	if (!handle->dlh || !handle->device) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
-	pthread_mutex_unlock(&libtool_lock);
-
-	free(handle);
-	handle = NULL;
-
-	return res;
+	//Handle is owned by the registry
+	return OPH_IOSTORAGE_SUCCESS;
 }
 
 int oph_iostore_get_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record)
@@ -198,28 +336,33 @@ int oph_iostore_get_db(oph_iostore_handler * handle, oph_iostore_resource_id * r
 		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
 
-	if (!handle->dlh || !handle->device) {
+	if (!handle->dlh || !handle->api.get_db) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_GET_DB_FUNC, handle->device);
+	return handle->api.get_db(handle, res_id, db_record);
+}
 
-	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_get_db = (int (*)(oph_iostore_handler *, oph_iostore_resource_id *, oph_iostore_db_record_set **)) lt_dlsym(handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
+int oph_iostore_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_get_db(handle, res_id, db_record);
+	if (!handle->dlh || !handle->api.put_db) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		return OPH_IOSTORAGE_DLOPEN_ERR;
+	}
+
+	return handle->api.put_db(handle, db_record, res_id);
 }
 
-int oph_iostore_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id)
+int oph_iostore_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
 {
 	if (!handle) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
@@ -227,28 +370,33 @@ int oph_iostore_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set *
 		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
 
-	if (!handle->dlh || !handle->device) {
+	if (!handle->dlh || !handle->api.delete_db) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_PUT_DB_FUNC, handle->device);
+	return handle->api.delete_db(handle, res_id);
+}
 
-	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_put_db = (int (*)(oph_iostore_handler *, oph_iostore_db_record_set *, oph_iostore_resource_id **)) lt_dlsym(handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
+int oph_iostore_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_put_db(handle, db_record, res_id);
+	if (!handle->dlh || !handle->api.get_frag) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		return OPH_IOSTORAGE_DLOPEN_ERR;
+	}
+
+	return handle->api.get_frag(handle, res_id, frag_record);
 }
 
-int oph_iostore_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+int oph_iostore_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
 {
 	if (!handle) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
@@ -256,28 +404,33 @@ int oph_iostore_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id
 		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
 
-	if (!handle->dlh || !handle->device) {
+	if (!handle->dlh || !handle->api.put_frag) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_DELETE_DB_FUNC, handle->device);
+	return handle->api.put_frag(handle, frag_record, res_id);
+}
 
-	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_delete_db = (int (*)(oph_iostore_handler *, oph_iostore_resource_id *)) lt_dlsym(handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
+int oph_iostore_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		return OPH_IOSTORAGE_NULL_HANDLE;
+	}
+
+	if (!handle->dlh || !handle->api.delete_frag) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
+		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_delete_db(handle, res_id);
+	return handle->api.delete_frag(handle, res_id);
 }
 
-int oph_iostore_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record)
+int oph_iostore_get_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num, oph_iostore_frag_record_set ** frag_records)
 {
 	if (!handle) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
@@ -285,28 +438,35 @@ int oph_iostore_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id *
 		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
 
-	if (!handle->dlh || !handle->device) {
+	if (!handle->dlh || !handle->api.get_frag) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_GET_FRAG_FUNC, handle->device);
+	if (!res_ids || !frag_records || frag_num < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
 
-	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_get_frag = (int (*)(oph_iostore_handler *, oph_iostore_resource_id *, oph_iostore_frag_record_set **)) lt_dlsym(handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
+	if (handle->api.get_frags)
+		return handle->api.get_frags(handle, res_ids, frag_num, frag_records);
+
+	int i, j, res;
+	for (i = 0; i < frag_num; i++) {
+		if ((res = handle->api.get_frag(handle, res_ids[i], &(frag_records[i])))) {
+			for (j = 0; j < i; j++)
+				oph_iostore_destroy_frag_recordset(&(frag_records[j]));
+			frag_records[i] = NULL;
+			return res;
+		}
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_get_frag(handle, res_id, frag_record);
+	return OPH_IOSTORAGE_SUCCESS;
 }
 
-int oph_iostore_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
+int oph_iostore_put_frags(oph_iostore_handler * handle, oph_iostore_frag_record_set ** frag_records, int frag_num, oph_iostore_resource_id ** res_ids)
 {
 	if (!handle) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
@@ -314,28 +474,41 @@ int oph_iostore_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_s
 		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
 
-	if (!handle->dlh || !handle->device) {
+	if (!handle->dlh || !handle->api.put_frag || !handle->api.delete_frag) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_PUT_FRAG_FUNC, handle->device);
-
-	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_put_frag = (int (*)(oph_iostore_handler *, oph_iostore_frag_record_set *, oph_iostore_resource_id **)) lt_dlsym(handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
+	if (!res_ids || !frag_records || frag_num < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (handle->api.put_frags)
+		return handle->api.put_frags(handle, frag_records, frag_num, res_ids);
+
+	int i, res;
+	for (i = 0; i < frag_num; i++) {
+		if ((res = handle->api.put_frag(handle, frag_records[i], &(res_ids[i])))) {
+			//Transient devices give the fragments already inserted back to the caller
+			for (i--; i >= 0; i--) {
+				if (!handle->is_persistent)
+					oph_iostore_retain_frag_recordset(frag_records[i]);
+				handle->api.delete_frag(handle, res_ids[i]);
+				free(res_ids[i]->id);
+				free(res_ids[i]);
+				res_ids[i] = NULL;
+			}
+			return res;
+		}
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_put_frag(handle, frag_record, res_id);
+	return OPH_IOSTORAGE_SUCCESS;
 }
 
-int oph_iostore_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+int oph_iostore_delete_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num)
 {
 	if (!handle) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
@@ -343,28 +516,30 @@ int oph_iostore_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_i
 		return OPH_IOSTORAGE_NULL_HANDLE;
 	}
 
-	if (!handle->dlh || !handle->device) {
+	if (!handle->dlh || !handle->api.delete_frag) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_PLUGIN_ERROR);
 		return OPH_IOSTORAGE_DLOPEN_ERR;
 	}
 
-	char func_name[OPH_IOSTORAGE_BUFLEN] = { '\0' };
-	snprintf(func_name, OPH_IOSTORAGE_BUFLEN, OPH_IOSTORAGE_DELETE_FRAG_FUNC, handle->device);
-
-	pthread_mutex_lock(&libtool_lock);
-	if (!(_DEVICE_delete_frag = (int (*)(oph_iostore_handler *, oph_iostore_resource_id *)) lt_dlsym(handle->dlh, func_name))) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_LOAD_FUNC_ERROR, lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
-		return OPH_IOSTORAGE_DLSYM_ERR;
+	if (!res_ids || frag_num < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
 	}
-	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_delete_frag(handle, res_id);
+	if (handle->api.delete_frags)
+		return handle->api.delete_frags(handle, res_ids, frag_num);
+
+	int i, res = OPH_IOSTORAGE_SUCCESS;
+	for (i = 0; i < frag_num; i++)
+		if (handle->api.delete_frag(handle, res_ids[i]))
+			res = OPH_IOSTORAGE_INVALID_PARAM;
+
+	return res;
 }
 
-static int oph_iostore_find_device(const char *device, char **dyn_lib, unsigned short int *is_persistent)
+static int oph_iostore_find_device(const char *device, char **dyn_lib, unsigned short int *is_persistent, oph_iostore_frag_layout * layout)
 {
 	FILE *fp = NULL;
 	char line[OPH_IOSTORAGE_BUFLEN] = { '\0' };
@@ -372,7 +547,7 @@ static int oph_iostore_find_device(const char *device, char **dyn_lib, unsigned
 	char dyn_lib_str[OPH_IOSTORAGE_BUFLEN] = { '\0' };
 	char *res_string = NULL;
 
-	if (!device || !dyn_lib) {
+	if (!device || !dyn_lib || !is_persistent || !layout) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
 		return -1;
@@ -415,11 +590,15 @@ static int oph_iostore_find_device(const char *device, char **dyn_lib, unsigned
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
 				return -2;
 			}
-			sscanf(line, "%[^\n]", value);
-			if (STRCMP(value, OPH_IOSTORAGE_PERSISTENT_DEV) == 0) {
-				*is_persistent = 1;
-			} else {
-				*is_persistent = 0;
+			//Persistence flag is on the line following the library path
+			*is_persistent = 0;
+			*layout = OPH_IOSTORE_ROW_LAYOUT;
+			if (fgets(line, OPH_IOSTORAGE_BUFLEN, fp) && sscanf(line, "%[^\n]", value) == 1 && value[0] != '[') {
+				if (STRCMP(value, OPH_IOSTORAGE_PERSISTENT_DEV) == 0)
+					*is_persistent = 1;
+				//Optional record set layout
+				if (fgets(line, OPH_IOSTORAGE_BUFLEN, fp) && sscanf(line, "%[^\n]", value) == 1 && STRCMP(value, OPH_IOSTORAGE_COLUMN_LAYOUT) == 0)
+					*layout = OPH_IOSTORE_COLUMN_LAYOUT;
 			}
 			fclose(fp);
 			return 0;
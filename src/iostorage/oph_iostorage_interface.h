@@ -29,6 +29,11 @@
 #define OPH_IOSTORAGE_PERSISTENT_DEV    "persistent"
 #define OPH_IOSTORAGE_TRANSIENT_DEV     "transient"
 
+#define OPH_IOSTORAGE_ROW_LAYOUT        "row"
+#define OPH_IOSTORAGE_COLUMN_LAYOUT     "columnar"
+
+#define OPH_IOSTORAGE_DATA_DIR          "%s/var/%s"
+
 #define OPH_IOSTORAGE_SETUP_FUNC        "_%s_setup"
 #define OPH_IOSTORAGE_CLEANUP_FUNC      "_%s_cleanup"
 #define OPH_IOSTORAGE_GET_DB_FUNC       "_%s_get_db"
@@ -37,63 +42,112 @@
 #define OPH_IOSTORAGE_GET_FRAG_FUNC     "_%s_get_frag"
 #define OPH_IOSTORAGE_PUT_FRAG_FUNC     "_%s_put_frag"
 #define OPH_IOSTORAGE_DELETE_FRAG_FUNC  "_%s_delete_frag"
+#define OPH_IOSTORAGE_GET_FRAGS_FUNC    "_%s_get_frags"
+#define OPH_IOSTORAGE_PUT_FRAGS_FUNC    "_%s_put_frags"
+#define OPH_IOSTORAGE_DELETE_FRAGS_FUNC "_%s_delete_frags"
 
 //****************Handle******************//
 
+typedef struct _oph_iostore_handler oph_iostore_handler;
+
+//****************Plugin Interface******************//
+
 /**
- * \brief                 Handle structure with dynamic storage device library parameters
+ * \brief               Functions exported by a storage device library, resolved once when the device is loaded
+ * \param setup         Function to initialize storage library
+ * \param cleanup       Function to finalize the storage library and release all dynamic loading resources
+ * \param get_db        Function to retrieve a DB record from storage device
+ * \param put_db        Function to insert a DB record into storage device
+ * \param delete_db     Function to delete a DB from a storage device
+ * \param get_frag      Function to retrieve a fragment record from storage device
+ * \param put_frag      Function to insert a fragment record into storage device
+ * \param delete_frag   Function to delete a fragment from a storage device
+ * \param get_frags     Function to retrieve several fragment records at once (optional, NULL if not provided by the device)
+ * \param put_frags     Function to insert several fragment records at once (optional, NULL if not provided by the device)
+ * \param delete_frags  Function to delete several fragments at once (optional, NULL if not provided by the device)
+ */
+typedef struct {
+	int (*setup) (oph_iostore_handler * handle);
+	int (*cleanup) (oph_iostore_handler * handle);
+	int (*get_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
+	int (*put_db) (oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
+	int (*delete_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+	int (*get_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
+	int (*put_frag) (oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
+	int (*delete_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+	int (*get_frags) (oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num, oph_iostore_frag_record_set ** frag_records);
+	int (*put_frags) (oph_iostore_handler * handle, oph_iostore_frag_record_set ** frag_records, int frag_num, oph_iostore_resource_id ** res_ids);
+	int (*delete_frags) (oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num);
+} oph_iostore_device_api;
+
+/**
+ * \brief                 Handle structure with dynamic storage device library parameters (one handle per device is shared by the whole server)
  * \param device          Name of storage device used within the server
  * \param is_persistent   Flag that indicates if the device is persistent or transient
  * \param lib             Dynamic library path
  * \param dlh             Libtool handler to dynamic library
  * \param connection      Variable to hold generic storage device connection status info
+ * \param layout          Layout used to store fragments in the device (row or columnar)
+ * \param data_dir        Directory reserved to the device for its own files (used by persistent devices)
+ * \param memory_budget   Maximum number of bytes a transient device keeps in memory before spilling fragments to data_dir (0 means no limit)
+ * \param compression_delay Number of seconds after which a transient device compresses a fragment not accessed (0 means never)
+ * \param api             Functions of the device library
  */
-typedef struct {
+struct _oph_iostore_handler {
 	char *device;
 	short unsigned int is_persistent;
 	char *lib;
 	void *dlh;
 	void *connection;
-} oph_iostore_handler;
-
-//****************Plugin Interface******************//
-
-//Function to initialize storage library.
-int (*_DEVICE_setup) (oph_iostore_handler * handle);
-
-//Function to finalize the storage library and release all dynamic loading resources.
-int (*_DEVICE_cleanup) (oph_iostore_handler * handle);
+	oph_iostore_frag_layout layout;
+	char *data_dir;
+	unsigned long long memory_budget;
+	unsigned int compression_delay;
+	oph_iostore_device_api api;
+};
 
-//Function to retrieve a DB record from storage device
-int (*_DEVICE_get_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
-
-//Function to insert a DB record into storage device
-int (*_DEVICE_put_db) (oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
+//*****************Internal Functions (used by query engine library)***************//
 
-//Function to delete a DB from a storage device
-int (*_DEVICE_delete_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+/**
+ * \brief               Function to set the prefix of the directories where devices store their data
+ * \param p             Base directory of the server
+ */
+void oph_iostore_set_data_prefix(char *p);
 
-//Function to retrieve a fragment record from storage device
-int (*_DEVICE_get_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
+/**
+ * \brief               Function to set the memory budget of transient devices
+ * \param budget        Maximum number of bytes kept in memory (0 means no limit)
+ */
+void oph_iostore_set_memory_budget(unsigned long long budget);
 
-//Function to insert a fragment record into storage device
-int (*_DEVICE_put_frag) (oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
+/**
+ * \brief               Function to set the delay after which transient devices compress fragments not accessed
+ * \param delay         Number of seconds (0 disables compression)
+ */
+void oph_iostore_set_compression_delay(unsigned int delay);
 
-//Function to delete a fragment from a storage device
-int (*_DEVICE_delete_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+/**
+ * \brief               Function to load every device listed in the device file. It should be called at server startup, after the device parameters have been set.
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_load_devices();
 
-//*****************Internal Functions (used by query engine library)***************//
+/**
+ * \brief               Function to release the devices loaded by the server and all dynamic loading resources.
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_unload_devices();
 
 /**
- * \brief               Function to initialize data storage library. This function should be called before any other function to initialize the dynamic library.
+ * \brief               Function to get the handle of a storage device. A device not loaded at startup is loaded upon the first request.
  * \param device        String with the name of storage device plugin to use
- * \param handle        Address to pointer for dynamic device plugin handle
+ * \param handle        Address to pointer for dynamic device plugin handle (it is shared and must not be modified)
  * \return              0 if successfull, non-0 otherwise
  */
 int oph_iostore_setup(const char *device, oph_iostore_handler ** handle);
 
 /**
- * \brief               Function to finalize library of data storage and release all dynamic loading resources.
+ * \brief               Function to release a handle got with oph_iostore_setup (the device stays loaded until oph_iostore_unload_devices).
  * \param handle        Dynamic I/O storage plugin handle
  * \return              0 if successfull, non-0 otherwise
  */
@@ -129,7 +183,7 @@ int oph_iostore_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id
  * \brief               Function to retrieve a fragment record from storage device
  * \param handle        Dynamic I/O storage plugin handle
  * \param res_id        ID of resource being fetched
- * \param frag_record   Record contains a copy of a frag if device is persisten (it should be deleted outside), or a pointer to the record if device is transient
+ * \param frag_record   Record contains a copy of a frag if device is persisten, or a reference to the record if device is transient (in both cases it should be deleted outside)
  * \return              0 if successfull, non-0 otherwise
  */
 int oph_iostore_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
@@ -151,4 +205,33 @@ int oph_iostore_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_s
  */
 int oph_iostore_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
 
+/**
+ * \brief               Function to retrieve several fragment records from storage device with a single call
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_ids       Array with the IDs of resources being fetched
+ * \param frag_num      Number of resources being fetched
+ * \param frag_records  Array filled with the records, as returned by oph_iostore_get_frag (all of them are NULL in case of error)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_get_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num, oph_iostore_frag_record_set ** frag_records);
+
+/**
+ * \brief               Function to insert several fragment records into storage device with a single call
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param frag_records  Array of records, handled as by oph_iostore_put_frag (in case of error transient devices do not keep any of them)
+ * \param frag_num      Number of records to insert
+ * \param res_ids       Array filled with the IDs of resources created
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_put_frags(oph_iostore_handler * handle, oph_iostore_frag_record_set ** frag_records, int frag_num, oph_iostore_resource_id ** res_ids);
+
+/**
+ * \brief               Function to delete several fragments from a storage device with a single call
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param res_ids       Array with the IDs of resources to delete
+ * \param frag_num      Number of resources to delete
+ * \return              0 if successfull, non-0 otherwise (the other fragments are deleted anyway)
+ */
+int oph_iostore_delete_frags(oph_iostore_handler * handle, oph_iostore_resource_id ** res_ids, int frag_num);
+
 #endif				//__OPH_IOSTORAGE_INTERFACE_H
@@ -65,5 +65,11 @@
 #define OPH_IOSTORAGE_LOG_FILE_NOT_FOUND    "IO server file not found %s\n"
 #define OPH_IOSTORAGE_LOG_READ_LINE_ERROR   "Unable to read file line\n"
 #define OPH_IOSTORAGE_LOG_MEMORY_ERROR      "Memory allocation error\n"
+#define OPH_IOSTORAGE_LOG_IMAGE_ERROR       "Fragment image is not valid\n"
+#define OPH_IOSTORAGE_LOG_APPEND_ERROR      "Columns cannot be appended to the record set\n"
+#define OPH_IOSTORAGE_LOG_DEVICE_ERROR      "Unable to load device %s\n"
+#define OPH_IOSTORAGE_LOG_NO_NUMA           "NUMA is not supported: default memory placement will be used\n"
+#define OPH_IOSTORAGE_LOG_NUMA_NODE_ERROR   "Unable to run on NUMA node %d\n"
+#define OPH_IOSTORAGE_LOG_PATH_TOO_LONG     "Data directory path of device %s is too long\n"
 
 #endif				//__OPH_IOSTORAGE_LOG_ERROR_CODES_H
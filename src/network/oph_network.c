@@ -24,12 +24,20 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <strings.h>
+#include <string.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include "debug.h"
 #include <errno.h>
 #include <signal.h>
 
 #define	OPH_NET_LISTEN_QUEUE		512	/* 2nd argument to listen() */
+#define	OPH_NET_ZEROCOPY_TIMEOUT	5000	/* ms to wait for a zero-copy notification */
 
 /* Read "n" bytes from a descriptor. */
 ssize_t oph_net_readn(int fd, void *buffer, size_t n)
@@ -57,6 +65,130 @@ ssize_t oph_net_readn(int fd, void *buffer, size_t n)
 	return (n - nleft);	/* return >= 0 */
 }
 
+/* Write "n" bytes to a descriptor. */
+ssize_t oph_net_writen(int fd, const void *buffer, size_t n)
+{
+	size_t nleft;
+	ssize_t nwritten;
+	const char *ptr;
+
+	ptr = buffer;
+	nleft = n;
+	while (nleft > 0) {
+		if ((nwritten = write(fd, ptr, nleft)) <= 0) {
+			if (nwritten < 0 && errno == EINTR)
+				nwritten = 0;	/* and call write() again */
+			else
+				return OPH_NETWORK_ERROR;
+		}
+
+		nleft -= nwritten;
+		ptr += nwritten;
+	}
+	return n;
+}
+
+/* Write a list of buffers to a descriptor. */
+ssize_t oph_net_writev(int fd, struct iovec *iov, int iovcnt, int zerocopy, unsigned int *zc_calls)
+{
+	struct msghdr msg;
+	ssize_t nwritten, total = 0;
+	int flags = 0;
+
+#ifdef MSG_ZEROCOPY
+	if (zerocopy && zc_calls)
+		flags |= MSG_ZEROCOPY;
+#endif
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+	while (msg.msg_iovlen > 0) {
+		if ((nwritten = sendmsg(fd, &msg, flags)) < 0) {
+			if (errno == EINTR)
+				continue;	/* and call sendmsg() again */
+			if (flags && errno == ENOBUFS) {
+				flags = 0;	/* out of optmem: fall back to copy */
+				continue;
+			}
+			return OPH_NETWORK_ERROR;
+		}
+		if (flags)
+			(*zc_calls)++;
+
+		total += nwritten;
+		/* Skip the buffers already sent */
+		while (msg.msg_iovlen > 0 && (size_t) nwritten >= msg.msg_iov->iov_len) {
+			nwritten -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen > 0) {
+			msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + nwritten;
+			msg.msg_iov->iov_len -= nwritten;
+		}
+	}
+	return total;
+}
+
+int oph_net_enable_zerocopy(int fd)
+{
+#ifdef SO_ZEROCOPY
+	int one = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+		return OPH_NETWORK_SUCCESS;
+#else
+	(void) fd;
+#endif
+	return OPH_NETWORK_ERROR;
+}
+
+int oph_net_wait_zerocopy(int fd, unsigned int zc_calls)
+{
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+	unsigned int completed = 0;
+	int ready;
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct sock_extended_err *serr;
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = 0;		/* POLLERR is always reported */
+
+	while (completed < zc_calls) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return OPH_NETWORK_ERROR;
+			ready = poll(&pfd, 1, OPH_NET_ZEROCOPY_TIMEOUT);
+			if (!ready || (ready < 0 && errno != EINTR)) {
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Zero-copy notifications not received: %u of %u\n", completed, zc_calls);
+				return OPH_NETWORK_ERROR;
+			}
+			continue;
+		}
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+				continue;
+			serr = (struct sock_extended_err *) CMSG_DATA(cm);
+			if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+				completed += serr->ee_data - serr->ee_info + 1;	/* range of acknowledged sends */
+		}
+	}
+#else
+	(void) fd;
+	if (zc_calls)
+		return OPH_NETWORK_ERROR;
+#endif
+	return OPH_NETWORK_SUCCESS;
+}
+
 int oph_net_connect(const char *host, const char *port, int *fd)
 {
 	/* Adapted from Stevens et al. UNP Vol. 1, 3rd Ed. source code - http://www.unpbook.com/src.html */
@@ -179,6 +311,76 @@ int oph_net_listen(const char *host, const char *port, socklen_t * addrlenp, int
 	return OPH_NETWORK_SUCCESS;
 }
 
+int oph_net_connect_unix(const char *path, int *fd)
+{
+	int sockfd;
+	struct sockaddr_un addr;
+	*fd = 0;
+
+	if (!path || strlen(path) >= sizeof(addr.sun_path)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Invalid socket path\n");
+		return OPH_NETWORK_ERROR;
+	}
+
+	bzero(&addr, sizeof(struct sockaddr_un));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((sockfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create socket\n");
+		return OPH_NETWORK_ERROR;
+	}
+
+	if (connect(sockfd, (struct sockaddr *) &addr, sizeof(struct sockaddr_un)) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "unix_connect error for %s\n", path);
+		close(sockfd);
+		return OPH_NETWORK_ERROR;
+	}
+
+	*fd = sockfd;
+	return OPH_NETWORK_SUCCESS;
+}
+
+int oph_net_listen_unix(const char *path, int *out_fd)
+{
+	int listenfd;
+	struct sockaddr_un addr;
+	*out_fd = 0;
+
+	if (!path || strlen(path) >= sizeof(addr.sun_path)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Invalid socket path\n");
+		return OPH_NETWORK_ERROR;
+	}
+
+	bzero(&addr, sizeof(struct sockaddr_un));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((listenfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create socket\n");
+		return OPH_NETWORK_ERROR;
+	}
+
+	//The socket file of a previous run would make bind fail
+	unlink(path);
+
+	if (bind(listenfd, (struct sockaddr *) &addr, sizeof(struct sockaddr_un)) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "unix_listen error for %s\n", path);
+		close(listenfd);
+		return OPH_NETWORK_ERROR;
+	}
+
+	if (listen(listenfd, OPH_NET_LISTEN_QUEUE) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while listening socket!\n");
+		close(listenfd);
+		return OPH_NETWORK_ERROR;
+	}
+
+	*out_fd = listenfd;
+
+	return OPH_NETWORK_SUCCESS;
+}
+
 int oph_net_signal(int signo, void *func)
 {
 	/* Adapted from Stevens et al. UNP Vol. 1, 3rd Ed. source code - http://www.unpbook.com/src.html */
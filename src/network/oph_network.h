@@ -24,6 +24,7 @@
 #define OPH_NETWORK_ERROR                              -1
 
 #include <netdb.h>
+#include <sys/uio.h>
 
 // Prototypes
 
@@ -36,6 +37,41 @@
  */
 ssize_t oph_net_readn(int fd, void *buffer, size_t n);
 
+/**
+ * \brief               Function to write n bytes to socket (partial writes are resumed)
+ * \param fd            Socket being written
+ * \param buffer        Data to be written
+ * \param n             Number of bytes to be written
+ * \return              n if successfull, -1 otherwise
+ */
+ssize_t oph_net_writen(int fd, const void *buffer, size_t n);
+
+/**
+ * \brief               Function to write a list of buffers to socket (partial writes are resumed; iov is modified)
+ * \param fd            Socket being written
+ * \param iov           Array of buffers to be written
+ * \param iovcnt        Number of buffers
+ * \param zerocopy      If set, MSG_ZEROCOPY is requested; buffers must be left untouched until oph_net_wait_zerocopy returns
+ * \param zc_calls      Counter increased by the number of zero-copy sends to be acknowledged (it can be NULL if zerocopy is not set)
+ * \return              number of bytes written if successfull, -1 otherwise
+ */
+ssize_t oph_net_writev(int fd, struct iovec *iov, int iovcnt, int zerocopy, unsigned int *zc_calls);
+
+/**
+ * \brief               Function to enable zero-copy transmission on a socket
+ * \param fd            Socket descriptor
+ * \return              0 if successfull, -1 otherwise (e.g. not supported by the kernel)
+ */
+int oph_net_enable_zerocopy(int fd);
+
+/**
+ * \brief               Function to wait until the kernel has released the buffers of zero-copy sends
+ * \param fd            Socket descriptor
+ * \param zc_calls      Number of zero-copy sends to be acknowledged
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_wait_zerocopy(int fd, unsigned int zc_calls);
+
 /**
  * \brief               Function to connect to hostname:port 
  * \param host          Server hostname
@@ -65,6 +101,22 @@ int oph_net_accept(int in_fd, struct sockaddr *sa, socklen_t * salenptr, int *ou
  */
 int oph_net_listen(const char *host, const char *port, socklen_t * addrlenp, int *fd);
 
+/**
+ * \brief               Function to connect to a Unix domain socket
+ * \param path          Path of the socket
+ * \param fd            Fd descriptor of the new socket
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_connect_unix(const char *path, int *fd);
+
+/**
+ * \brief               Function to listen to a Unix domain socket (a stale socket file is removed)
+ * \param path          Path of the socket
+ * \param fd            Descriptor of socket for listened socket
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_listen_unix(const char *path, int *fd);
+
 /**
  * \brief               Function used to set a handler function for a signal
  * \param signo         Signal to be catched
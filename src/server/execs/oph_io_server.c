@@ -17,10 +17,13 @@
 */
 
 #include "oph_io_server_thread.h"
+#include "oph_io_server_query_manager.h"
 
 #include <signal.h>
 #include <unistd.h>
 #include <malloc.h>
+#include <strings.h>
+#include <errno.h>
 #include "debug.h"
 
 #include "hashtbl.h"
@@ -37,15 +40,22 @@
 #include <esdm.h>
 #endif
 
+#define MB_SIZE 1048576
+
 //TODO put globals into global struct 
 //Global server variables (read-only)
 unsigned long long max_packet_length = 0;
 unsigned short omp_threads = 0;
 unsigned short client_ttl = 0;
+unsigned short worker_threads = OPH_IO_SERVER_DEFAULT_WORKERS;
+unsigned long long shm_ring_size = 0;
+unsigned long long max_bulk_length = OPH_IO_SERVER_DEFAULT_MAX_BULK_LEN * (unsigned long long) MB_SIZE;
 unsigned short disable_mem_check = 0;
 unsigned long long memory_buffer = 0;
 unsigned short cache_line_size = 0;
 unsigned long long cache_size = 0;
+unsigned long snapshot_interval = 0;
+char snapshot_file[OPH_SERVER_CONF_LINE_LEN] = { '\0' };
 
 pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
 pthread_mutex_t libtool_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -68,11 +78,11 @@ int main(int argc, char *argv[])
 	int msglevel = LOG_INFO_T;
 #endif
 
-	int listenfd, tmpconnfd, *connfd = NULL;
+	int listenfd, local_listenfd = -1;
 	void release(int);
-	void *server_child(void *);
+	void *snapshot_child(void *);
 	pthread_t tid;
-	socklen_t clilen, addrlen;
+	socklen_t addrlen;
 	set_debug_level(msglevel);
 
 	int ch;
@@ -139,6 +149,16 @@ int main(int argc, char *argv[])
 	char *cache_line = 0;
 	char *cache = 0;
 	char *working_dir = 0;
+	char *snapshot = 0;
+	char *memory_budget = 0;
+	char *compression_delay = 0;
+	char *huge_pages = 0;
+	char *numa_policy = 0;
+	char *workers = 0;
+	char *unix_socket = 0;
+	char *shm_ring = 0;
+	char *query_cache = 0;
+	char *max_bulk = 0;
 
 	if (oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_DIR, &dir)) {
 		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to get server dir param\n");
@@ -147,9 +167,10 @@ int main(int argc, char *argv[])
 		//return -1;
 		dir = OPH_IO_SERVER_PREFIX;
 	}
-	//Setup debug and MetaDB directories
+	//Setup debug, MetaDB and device directories
 	set_log_prefix(dir);
 	oph_metadb_set_data_prefix(dir);
+	oph_iostore_set_data_prefix(dir);
 
 	if (oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_HOSTNAME, &hostname)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to get hostname param\n");
@@ -192,6 +213,22 @@ int main(int argc, char *argv[])
 
 	omp_threads = strtol(omp, NULL, 10);
 
+	//Size of the pool of threads serving client requests
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_WORKER_THREADS, &workers) && workers && strtol(workers, NULL, 10) > 0)
+		worker_threads = strtol(workers, NULL, 10);
+
+	//Size (in MB) of the shared memory ring offered to clients connected through the Unix domain socket (0 to disable it)
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_SHM_RING_SIZE, &shm_ring) && shm_ring)
+		shm_ring_size = strtoull(shm_ring, NULL, 10) * (unsigned long long) MB_SIZE;
+
+	//Number of parsed statements kept for reuse (0 to disable the cache)
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_QUERY_CACHE_SIZE, &query_cache) && query_cache)
+		oph_io_server_set_query_cache_size(strtoul(query_cache, NULL, 10));
+
+	//Maximum size (in MB) of the columns received with a single bulk insert
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_MAX_BULK_LEN, &max_bulk) && max_bulk && strtoull(max_bulk, NULL, 10) > 0)
+		max_bulk_length = strtoull(max_bulk, NULL, 10) * (unsigned long long) MB_SIZE;
+
 	if (oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_MEMORY_BUFFER, &mem_buf)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to get memory buffer param\n");
 		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to get memory buffer param\n");
@@ -226,6 +263,48 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_SNAPSHOT_INTERVAL, &snapshot) && snapshot)
+		snapshot_interval = strtoul(snapshot, NULL, 10);
+
+	//Memory budget of transient devices (in MB)
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_MEMORY_BUDGET, &memory_budget) && memory_budget)
+		oph_iostore_set_memory_budget(strtoull(memory_budget, NULL, 10) * (unsigned long long) MB_SIZE);
+
+	//Fragments of transient devices not accessed for this number of seconds are compressed
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_COMPRESSION_DELAY, &compression_delay) && compression_delay)
+		oph_iostore_set_compression_delay(strtoul(compression_delay, NULL, 10));
+
+	//Placement of fragment memory: huge pages (no, transparent, explicit) and NUMA policy (default, local, interleave, bind)
+	oph_iostore_huge_pages huge_page_policy = OPH_IOSTORE_HUGE_PAGES_NONE;
+	oph_iostore_numa_policy numa_node_policy = OPH_IOSTORE_NUMA_DEFAULT;
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_HUGE_PAGES, &huge_pages) && huge_pages) {
+		if (!strcasecmp(huge_pages, "transparent"))
+			huge_page_policy = OPH_IOSTORE_HUGE_PAGES_TRANSPARENT;
+		else if (!strcasecmp(huge_pages, "explicit"))
+			huge_page_policy = OPH_IOSTORE_HUGE_PAGES_EXPLICIT;
+		else if (strcasecmp(huge_pages, "no"))
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unknown huge page policy %s: huge pages are not used\n", huge_pages);
+	}
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_NUMA_POLICY, &numa_policy) && numa_policy) {
+		if (!strcasecmp(numa_policy, "local"))
+			numa_node_policy = OPH_IOSTORE_NUMA_LOCAL;
+		else if (!strcasecmp(numa_policy, "interleave"))
+			numa_node_policy = OPH_IOSTORE_NUMA_INTERLEAVE;
+		else if (!strcasecmp(numa_policy, "bind"))
+			numa_node_policy = OPH_IOSTORE_NUMA_BIND;
+		else if (strcasecmp(numa_policy, "default"))
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unknown NUMA policy %s: default placement is used\n", numa_policy);
+	}
+	oph_iostore_set_memory_policy(huge_page_policy, numa_node_policy);
+
+	//Device libraries are loaded once and shared by all the queries
+	if (oph_iostore_load_devices()) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to load device list\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to load device list\n");
+		oph_server_conf_unload(&conf_db);
+		return -1;
+	}
+
 	if (oph_load_plugins(&plugin_table, &oph_function_table)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to load plugin table\n");
 		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to load plugin table\n");
@@ -242,6 +321,12 @@ int main(int argc, char *argv[])
 		oph_server_conf_unload(&conf_db);
 		return -1;
 	}
+	//Restore transient fragments saved by the last snapshot
+	snprintf(snapshot_file, OPH_SERVER_CONF_LINE_LEN, OPH_SERVER_SNAPSHOT, dir);
+	if (oph_io_server_load_snapshot(&db_table, snapshot_file, omp_threads)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to restore snapshot %s completely\n", snapshot_file);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to restore snapshot %s completely\n", snapshot_file);
+	}
 	//Startup TCP/IP listening
 	if (oph_net_listen(hostname, port, &addrlen, &listenfd) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while listening TCP socket\n");
@@ -252,6 +337,15 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	//Clients on the same node can also connect through a Unix domain socket
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_UNIX_SOCKET, &unix_socket) && unix_socket && *unix_socket) {
+		if (oph_net_listen_unix(unix_socket, &local_listenfd) != 0) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to listen Unix domain socket %s\n", unix_socket);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to listen Unix domain socket %s\n", unix_socket);
+			local_listenfd = -1;
+		}
+	}
+
 	cliaddr = (struct sockaddr *) malloc(addrlen);
 	if (cliaddr == NULL) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for client address\n");
@@ -267,6 +361,18 @@ int main(int argc, char *argv[])
 	oph_net_signal(SIGQUIT, release);
 	oph_net_signal(SIGPIPE, SIG_IGN);
 
+	//SIGUSR1 is only received by the snapshot thread
+	sigset_t snapshot_set;
+	sigemptyset(&snapshot_set);
+	sigaddset(&snapshot_set, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &snapshot_set, NULL);
+	if (pthread_create(&tid, NULL, &snapshot_child, NULL) != 0) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Error creating snapshot thread\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Error creating snapshot thread\n");
+	}
+	//Dropped fragments are released in background
+	oph_io_server_start_reclaimer();
+
 #ifdef OPH_IO_SERVER_ESDM
 	if (esdm_init()) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "ESDM cannot be initialized\n");
@@ -278,69 +384,54 @@ int main(int argc, char *argv[])
 	}
 #endif
 
-	//Startup client connections
-	for (;;) {
-		clilen = addrlen;
-
-
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a request...\n");
-		logging(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a request...\n");
-
-		if (oph_net_accept(listenfd, cliaddr, &clilen, &tmpconnfd) != 0) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
-			logging(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
-			continue;
-		}
-
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", tmpconnfd);
-		logging(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", tmpconnfd);
-
-		//TODO Manage multiple connections with poll
-
-		connfd = (int *) malloc(sizeof(int));
-		*connfd = tmpconnfd;
-		if (pthread_create(&tid, NULL, &server_child, (void *) connfd) != 0) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
-			logging(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
-			continue;
-		}
-		connfd = NULL;
-
+	//Client connections are multiplexed by the reactor and served by a fixed pool of workers
+	if (oph_io_server_reactor(listenfd, local_listenfd, cliaddr, addrlen, worker_threads)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to handle client connections\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to handle client connections\n");
 	}
 
 	//Cleanup procedures
 	free(cliaddr);
+	oph_io_server_stop_reclaimer();
+	oph_io_server_clear_query_cache();
 	oph_metadb_unload_schema(db_table);
 	oph_server_conf_unload(&conf_db);
 	oph_unload_plugins(&plugin_table, &oph_function_table);
+	oph_iostore_unload_devices();
 
 	return 0;
 }
 
-void *server_child(void *arg)
+//Write a snapshot every snapshot_interval seconds (if set) or upon SIGUSR1
+void *snapshot_child(void *arg)
 {
-	void oph_io_server_thread(int, pthread_t);
+	(void) arg;
 
 	if (pthread_detach(pthread_self()) != 0)
 		return (NULL);
 
-	pthread_t tid = pthread_self();
-
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "LAUNCHING THREAD...\n");
-	oph_io_server_thread(*((int *) arg), tid);
-
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection...\n");
-	logging(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection...\n");
-
-	if (close(*((int *) arg)) == -1)
-		pmesg(LOG_WARNING, __FILE__, __LINE__, "Error while closing connection!\n");
+	sigset_t snapshot_set;
+	sigemptyset(&snapshot_set);
+	sigaddset(&snapshot_set, SIGUSR1);
+	struct timespec timeout;
+	timeout.tv_sec = snapshot_interval;
+	timeout.tv_nsec = 0;
 
-	free((int *) arg);
+	for (;;) {
+		if (snapshot_interval) {
+			if (sigtimedwait(&snapshot_set, NULL, &timeout) < 0 && errno != EAGAIN)
+				continue;
+		} else if (sigwaitinfo(&snapshot_set, NULL) < 0)
+			continue;
 
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection closed\n");
-	logging(LOG_DEBUG, __FILE__, __LINE__, "Connection closed\n");
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Writing snapshot %s\n", snapshot_file);
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Writing snapshot %s\n", snapshot_file);
+		if (oph_io_server_save_snapshot(&db_table, snapshot_file)) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to write snapshot %s\n", snapshot_file);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to write snapshot %s\n", snapshot_file);
+		}
+	}
 
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "CLOSING THREAD...\n");
 	return (NULL);
 }
 
@@ -350,9 +441,12 @@ void release(int signo)
 	//Cleanup procedures
 	logging(LOG_DEBUG, __FILE__, __LINE__, "Catched signal %d\n", signo);
 	free(cliaddr);
+	oph_io_server_stop_reclaimer();
+	oph_io_server_clear_query_cache();
 	oph_metadb_unload_schema(db_table);
 	oph_unload_plugins(&plugin_table, &oph_function_table);
 	oph_server_conf_unload(&conf_db);
+	oph_iostore_unload_devices();
 
 #ifdef OPH_IO_SERVER_ESDM
 	esdm_finalize();
@@ -20,10 +20,17 @@
 
 #include "oph_io_server_thread.h"
 
-#include <poll.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include "debug.h"
 #include "taketime.h"
 
@@ -38,14 +45,12 @@
 
 extern int msglevel;
 
-//TODO thread management operations
-//TODO save info related to threads
-//TODO save connection status
-
 //Global server variables (read-only)
 extern unsigned long long max_packet_length;
 extern unsigned short omp_threads;
 extern unsigned short client_ttl;
+extern unsigned long long shm_ring_size;
+extern unsigned long long max_bulk_length;
 extern HASHTBL *plugin_table;
 
 extern pthread_rwlock_t rwlock;
@@ -53,6 +58,58 @@ extern oph_metadb_db_row *db_table;
 
 //#define DEBUG
 
+//Open connections, connections waiting for a worker and epoll instance of the reactor
+static pthread_mutex_t conn_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t conn_cond = PTHREAD_COND_INITIALIZER;
+static oph_io_server_connection *conn_list = NULL;
+static oph_io_server_connection *ready_head = NULL;
+static oph_io_server_connection *ready_tail = NULL;
+static int epoll_fd = -1;
+
+//Markers of the listening sockets in epoll events (connections are identified by their own pointer)
+static char tcp_listener, local_listener;
+
+//The segment is marked for removal as soon as the server has attached it: Linux still lets the client attach it
+//and the kernel releases it once both have detached, even if they terminate abnormally
+static int _oph_io_server_create_ring(oph_io_server_ring ** ring, unsigned long long size)
+{
+	oph_io_server_ring *tmp = (oph_io_server_ring *) calloc(1, sizeof(oph_io_server_ring));
+	if (!tmp) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate shared memory ring\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate shared memory ring\n");
+		return -1;
+	}
+
+	tmp->shm_id = shmget(IPC_PRIVATE, OPH_IO_SERVER_RING_HEADER_LEN + size, IPC_CREAT | 0600);
+	if (tmp->shm_id < 0) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to create shared memory segment: %d\n", errno);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to create shared memory segment: %d\n", errno);
+		free(tmp);
+		return -1;
+	}
+	tmp->addr = (char *) shmat(tmp->shm_id, NULL, 0);
+	shmctl(tmp->shm_id, IPC_RMID, NULL);
+	if (tmp->addr == (char *) -1) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to attach shared memory segment: %d\n", errno);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to attach shared memory segment: %d\n", errno);
+		free(tmp);
+		return -1;
+	}
+	tmp->size = size;
+	tmp->head = 0;
+	*ring = tmp;
+
+	return 0;
+}
+
+static void _oph_io_server_destroy_ring(oph_io_server_ring ** ring)
+{
+	if (shmdt((*ring)->addr))
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to detach shared memory segment\n");
+	free(*ring);
+	*ring = NULL;
+}
+
 int oph_io_server_free_status(oph_io_server_thread_status * status)
 {
 
@@ -79,6 +136,9 @@ int oph_io_server_free_status(oph_io_server_thread_status * status)
 	status->last_result_set = NULL;
 	status->delete_only_rs = 0;
 
+	if (status->ring != NULL)
+		_oph_io_server_destroy_ring(&(status->ring));
+
 	return 0;
 }
 
@@ -98,6 +158,372 @@ int oph_io_server_send_error(int sockfd)
 }
 
 
+//Frame of a result set: small cells are copied in the buffer, whose first OPH_IO_SERVER_MSG_LONG_LEN bytes are reserved to the frame length,
+//while large cells are referenced directly by the iovec list. With a ring, the buffer is the free area of the ring where the next frame is built.
+typedef struct {
+	int sockfd;
+	char *buffer;
+	unsigned long long size;
+	unsigned long long used;
+	unsigned long long segment;
+	unsigned long long length;
+	unsigned long long direct;
+	struct iovec iov[OPH_IO_SERVER_FRAME_IOV];
+	int iov_num;
+	int zerocopy;
+	unsigned int zc_calls;
+	oph_io_server_ring *ring;
+} _oph_io_server_result_frame;
+
+#define _OPH_IO_SERVER_FRAME_IN_BUFFER(frame, ptr) ((char *) (ptr) >= (frame)->buffer && (char *) (ptr) < (frame)->buffer + (frame)->size)
+
+static void _oph_io_server_reset_frame(_oph_io_server_result_frame * frame)
+{
+	//The area of the next ring frame is acquired only when there are data to be written
+	if (frame->ring) {
+		frame->buffer = NULL;
+		frame->size = frame->used = frame->length = frame->direct = 0;
+		return;
+	}
+	frame->iov[0].iov_base = frame->buffer;
+	frame->iov[0].iov_len = OPH_IO_SERVER_MSG_LONG_LEN;
+	frame->iov_num = 1;
+	frame->used = frame->segment = OPH_IO_SERVER_MSG_LONG_LEN;
+	frame->length = frame->direct = 0;
+}
+
+//Close the segment of the buffer filled since the last direct reference
+static void _oph_io_server_close_segment(_oph_io_server_result_frame * frame)
+{
+	if (frame->used > frame->segment) {
+		frame->iov[frame->iov_num].iov_base = frame->buffer + frame->segment;
+		frame->iov[frame->iov_num].iov_len = frame->used - frame->segment;
+		frame->iov_num++;
+		frame->segment = frame->used;
+	}
+}
+
+//Frames are contiguous in the ring: the end of the ring is skipped if it cannot hold a whole frame
+static int _oph_io_server_acquire_ring(_oph_io_server_result_frame * frame)
+{
+	oph_io_server_ring *ring = frame->ring;
+	unsigned long long cap = ring->size / OPH_IO_SERVER_RING_SLOTS, offset = ring->head % ring->size;
+	if (ring->size - offset < cap) {
+		ring->head += ring->size - offset;
+		offset = 0;
+	}
+
+	//Wait until the client has consumed enough frames
+	unsigned int spins = 0;
+	time_t start = 0;
+	struct timespec pause;
+	pause.tv_sec = 0;
+	pause.tv_nsec = OPH_IO_SERVER_RING_PAUSE;
+	while (ring->head + cap - __atomic_load_n((unsigned long long *) ring->addr, __ATOMIC_ACQUIRE) > ring->size) {
+		if (++spins < OPH_IO_SERVER_RING_SPINS) {
+			sched_yield();
+			continue;
+		}
+		if (!start)
+			start = time(NULL);
+		else if (time(NULL) - start > OPH_IO_SERVER_RING_TIMEOUT) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Shared memory ring is not consumed by the client\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Shared memory ring is not consumed by the client\n");
+			return -1;
+		}
+		nanosleep(&pause, NULL);
+	}
+
+	frame->buffer = ring->addr + OPH_IO_SERVER_RING_HEADER_LEN + offset;
+	frame->size = cap;
+	frame->used = frame->length = 0;
+
+	return 0;
+}
+
+//Only the position of the frame in the ring is sent through the socket
+static int _oph_io_server_publish_ring(_oph_io_server_result_frame * frame)
+{
+	unsigned long long notice[2] = { frame->length, frame->ring->head };
+	frame->ring->head += frame->length;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (oph_net_writen(frame->sockfd, notice, sizeof(notice)) != (ssize_t) sizeof(notice))
+		return -1;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Written frame of %llu bytes in shared memory at %llu\n", notice[0], notice[1]);
+	_oph_io_server_reset_frame(frame);
+
+	return 0;
+}
+
+static int _oph_io_server_flush_frame(_oph_io_server_result_frame * frame)
+{
+	if (!frame->length)
+		return 0;
+	if (frame->ring)
+		return _oph_io_server_publish_ring(frame);
+
+	_oph_io_server_close_segment(frame);
+	memcpy(frame->buffer, (void *) &(frame->length), OPH_IO_SERVER_MSG_LONG_LEN);
+
+	//Zero-copy pays off only for large amounts of data
+	char zerocopy = 0;
+	if (frame->direct >= OPH_IO_SERVER_ZEROCOPY_LEN && frame->zerocopy >= 0) {
+		if (!frame->zerocopy)
+			frame->zerocopy = oph_net_enable_zerocopy(frame->sockfd) ? -1 : 1;
+		zerocopy = frame->zerocopy > 0;
+	}
+	if (!zerocopy) {
+		if (oph_net_writev(frame->sockfd, frame->iov, frame->iov_num, 0, NULL) != (ssize_t) (frame->length + OPH_IO_SERVER_MSG_LONG_LEN))
+			return -1;
+	} else {
+		//The buffer is reused by next frames, so only referenced cells can be sent without copy
+		int start = 0, end = 0;
+		char direct = 0;
+		ssize_t sent = 0, res = 0;
+		while (start < frame->iov_num) {
+			direct = !_OPH_IO_SERVER_FRAME_IN_BUFFER(frame, frame->iov[start].iov_base);
+			for (end = start + 1; end < frame->iov_num && direct == !_OPH_IO_SERVER_FRAME_IN_BUFFER(frame, frame->iov[end].iov_base); end++);
+			if ((res = oph_net_writev(frame->sockfd, frame->iov + start, end - start, direct, &(frame->zc_calls))) < 0)
+				return -1;
+			sent += res;
+			start = end;
+		}
+		if (sent != (ssize_t) (frame->length + OPH_IO_SERVER_MSG_LONG_LEN))
+			return -1;
+	}
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sent frame of %llu bytes (%llu referenced)\n", frame->length, frame->direct);
+	_oph_io_server_reset_frame(frame);
+
+	return 0;
+}
+
+//Values larger than the free space are split over several frames
+static int _oph_io_server_append_frame(_oph_io_server_result_frame * frame, const void *data, unsigned long long length)
+{
+	const char *ptr = (const char *) data;
+	unsigned long long chunk = 0;
+
+	while (length) {
+		if (frame->used == frame->size && (_oph_io_server_flush_frame(frame) || (frame->ring && _oph_io_server_acquire_ring(frame))))
+			return -1;
+		chunk = frame->size - frame->used < length ? frame->size - frame->used : length;
+		memcpy(frame->buffer + frame->used, ptr, chunk);
+		frame->used += chunk;
+		frame->length += chunk;
+		ptr += chunk;
+		length -= chunk;
+	}
+
+	return 0;
+}
+
+//Large values are sent straight from fragment memory
+static int _oph_io_server_reference_frame(_oph_io_server_result_frame * frame, const void *data, unsigned long long length)
+{
+	//Keep room for the current segment, this reference and the next segment
+	if (frame->iov_num + 3 > OPH_IO_SERVER_FRAME_IOV && _oph_io_server_flush_frame(frame))
+		return -1;
+
+	_oph_io_server_close_segment(frame);
+	frame->iov[frame->iov_num].iov_base = (void *) data;
+	frame->iov[frame->iov_num].iov_len = length;
+	frame->iov_num++;
+	frame->length += length;
+	frame->direct += length;
+
+	return 0;
+}
+
+int oph_io_server_send_result_frames(int sockfd, oph_iostore_frag_record_set * record_set, char *buffer, unsigned long long size, unsigned int protocol, oph_io_server_ring * ring)
+{
+	if (!record_set || !buffer || size <= OPH_IO_SERVER_MSG_LONG_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return -1;
+	}
+
+	unsigned long long num_rows = 0, i = 0, length = 0;
+	unsigned int j = 0, num_fields = record_set->field_num;
+	char value[OPH_IO_SERVER_MAX_DOUBLE_LEN];
+	const void *data = NULL;
+	char binary = (protocol & OPH_IO_SERVER_PROTOCOL_BINARY_NUMERIC) ? 1 : 0;
+	uint64_t number = 0;
+
+	if (record_set->record_set)
+		while (record_set->record_set[num_rows])
+			num_rows++;
+
+	//Send header TYPE|NUM_ROWS|NUM_FIELDS
+	char header[OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_LONG_LEN + OPH_IO_SERVER_MSG_SHORT_LEN];
+	memcpy(header, OPH_IO_SERVER_MSG_RESULT_FRAMES, OPH_IO_SERVER_MSG_TYPE_LEN);
+	memcpy(header + OPH_IO_SERVER_MSG_TYPE_LEN, (void *) &num_rows, OPH_IO_SERVER_MSG_LONG_LEN);
+	memcpy(header + OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_LONG_LEN, (void *) &num_fields, OPH_IO_SERVER_MSG_SHORT_LEN);
+	if (oph_net_writen(sockfd, header, sizeof(header)) != (ssize_t) sizeof(header))
+		return -1;
+
+	//Binary numeric cells can be decoded only if the client knows the field types
+	if (binary && num_fields) {
+		char types[num_fields];
+		for (j = 0; j < num_fields; j++)
+			types[j] = record_set->field_type[j] == OPH_IOSTORE_LONG_TYPE ? OPH_IO_SERVER_FIELD_LONG : (record_set->field_type[j] == OPH_IOSTORE_REAL_TYPE ? OPH_IO_SERVER_FIELD_REAL : OPH_IO_SERVER_FIELD_STRING);
+		if (oph_net_writen(sockfd, types, num_fields) != (ssize_t) num_fields)
+			return -1;
+	}
+
+	//Cells FIELD_LEN|FIELD are sent in frames FRAME_LEN|DATA as soon as the buffer (or the iovec list) is full
+	_oph_io_server_result_frame frame;
+	frame.sockfd = sockfd;
+	frame.buffer = buffer;
+	frame.size = size;
+	frame.zerocopy = 0;
+	frame.zc_calls = 0;
+	frame.ring = (protocol & OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY) ? ring : NULL;
+	_oph_io_server_reset_frame(&frame);
+
+	for (i = 0; i < num_rows; i++) {
+		for (j = 0; j < num_fields; j++) {
+			if (binary && record_set->field_type[j] != OPH_IOSTORE_STRING_TYPE) {
+				//Send raw values in little-endian order
+				if (record_set->field_type[j] == OPH_IOSTORE_LONG_TYPE && OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j))
+					number = (uint64_t) OPH_IOSTORE_RECORD_ID(record_set, record_set->record_set[i]);
+				else
+					memcpy(&number, record_set->record_set[i]->field[j], sizeof(uint64_t));
+				number = htole64(number);
+				length = sizeof(uint64_t);
+				data = &number;
+			} else if (record_set->field_type[j] != OPH_IOSTORE_STRING_TYPE) {
+				//Convert to string
+				if (record_set->field_type[j] == OPH_IOSTORE_LONG_TYPE) {
+					if (OPH_IOSTORE_IS_IMPLICIT_ID(record_set, j))
+						snprintf(value, OPH_IO_SERVER_MAX_LONG_LEN, "%llu", (unsigned long long) OPH_IOSTORE_RECORD_ID(record_set, record_set->record_set[i]));
+					else
+						snprintf(value, OPH_IO_SERVER_MAX_LONG_LEN, "%llu", *((unsigned long long *) record_set->record_set[i]->field[j]));
+				} else
+					snprintf(value, OPH_IO_SERVER_MAX_DOUBLE_LEN, "%f", *((double *) record_set->record_set[i]->field[j]));
+				length = strlen(value) + 1;
+				data = value;
+			} else {
+				//String and binary values are already char*
+				length = record_set->record_set[i]->field_length[j];
+				data = record_set->record_set[i]->field[j];
+			}
+			if (_oph_io_server_append_frame(&frame, (void *) &length, OPH_IO_SERVER_MSG_LONG_LEN))
+				return -1;
+			if (data == value || data == &number || length < OPH_IO_SERVER_DIRECT_CELL_LEN || frame.ring) {
+				if (_oph_io_server_append_frame(&frame, data, length))
+					return -1;
+			} else if (_oph_io_server_reference_frame(&frame, data, length))
+				return -1;
+		}
+	}
+
+	//An empty frame closes the result set
+	if (_oph_io_server_flush_frame(&frame))
+		return -1;
+	length = 0;
+	if (oph_net_writen(sockfd, (void *) &length, OPH_IO_SERVER_MSG_LONG_LEN) != (ssize_t) OPH_IO_SERVER_MSG_LONG_LEN)
+		return -1;
+
+	//Fragment memory must not be released while the kernel is still sending it
+	if (frame.zc_calls && oph_net_wait_zerocopy(sockfd, frame.zc_calls)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while waiting for zero-copy transmission\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Error while waiting for zero-copy transmission\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int oph_io_server_recv_bulk_columns(int sockfd, oph_iostore_frag_record_set * record_set, unsigned long long row_num, oph_iostore_frag_column * column)
+{
+	if (!record_set || !column) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return -1;
+	}
+	//Every column holds at least one 8-byte value or length per row
+	if (row_num > max_bulk_length / OPH_IO_SERVER_MSG_LONG_LEN / (record_set->field_num ? record_set->field_num : 1)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Number of rows is too big: %llu\n", row_num);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Number of rows is too big: %llu\n", row_num);
+		return -1;
+	}
+
+	unsigned long long i, data_len, total_len = 0;
+	unsigned short j;
+	char type, expected;
+
+	for (j = 0; j < record_set->field_num; j++) {
+		if (oph_net_readn(sockfd, &type, 1) != 1 || oph_net_readn(sockfd, (void *) &data_len, OPH_IO_SERVER_MSG_LONG_LEN) != (ssize_t) OPH_IO_SERVER_MSG_LONG_LEN)
+			break;
+		switch (record_set->field_type[j]) {
+			case OPH_IOSTORE_LONG_TYPE:
+				expected = OPH_IO_SERVER_FIELD_LONG;
+				break;
+			case OPH_IOSTORE_REAL_TYPE:
+				expected = OPH_IO_SERVER_FIELD_REAL;
+				break;
+			default:
+				expected = OPH_IO_SERVER_FIELD_STRING;
+		}
+		if (type != expected) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Type of column %u does not correspond to the fragment\n", j);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Type of column %u does not correspond to the fragment\n", j);
+			break;
+		}
+		//The frame is rejected before its buffers are allocated
+		total_len += type == OPH_IO_SERVER_FIELD_STRING ? row_num * OPH_IO_SERVER_MSG_LONG_LEN : 0;
+		if (data_len > max_bulk_length || (total_len += data_len) > max_bulk_length) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Size of column %u is too big: %llu\n", j, data_len);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Size of column %u is too big: %llu\n", j, data_len);
+			break;
+		}
+
+		column[j].offset = (unsigned long long *) malloc((row_num + 1) * sizeof(unsigned long long));
+		if (!column[j].offset) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			break;
+		}
+		column[j].offset[0] = 0;
+		if (type == OPH_IO_SERVER_FIELD_STRING) {
+			//Cell lengths are turned into offsets in place
+			if (row_num && oph_net_readn(sockfd, (void *) (column[j].offset + 1), row_num * OPH_IO_SERVER_MSG_LONG_LEN) != (ssize_t) (row_num * OPH_IO_SERVER_MSG_LONG_LEN))
+				break;
+			for (i = 1; i <= row_num; i++)
+				if ((column[j].offset[i] += column[j].offset[i - 1]) < column[j].offset[i - 1])
+					break;
+			if (i <= row_num || column[j].offset[row_num] != data_len) {
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Cell lengths of column %u do not match its size\n", j);
+				logging(LOG_WARNING, __FILE__, __LINE__, "Cell lengths of column %u do not match its size\n", j);
+				break;
+			}
+		} else {
+			if (data_len != row_num * OPH_IO_SERVER_MSG_LONG_LEN) {
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Cell lengths of column %u do not match its size\n", j);
+				logging(LOG_WARNING, __FILE__, __LINE__, "Cell lengths of column %u do not match its size\n", j);
+				break;
+			}
+			for (i = 1; i <= row_num; i++)
+				column[j].offset[i] = i * OPH_IO_SERVER_MSG_LONG_LEN;
+		}
+
+		column[j].data = (char *) oph_iostore_mem_alloc(data_len ? data_len : 1, record_set->numa_node);
+		if (!column[j].data) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			break;
+		}
+		if (data_len && oph_net_readn(sockfd, (void *) column[j].data, data_len) != (ssize_t) data_len)
+			break;
+	}
+	if (j < record_set->field_num) {
+		oph_iostore_free_frag_columns(column, record_set->field_num);
+		return -1;
+	}
+
+	return 0;
+}
+
 int oph_io_server_free_query_args(oph_query_arg ** args, unsigned int arg_count)
 {
 
@@ -116,25 +542,19 @@ int oph_io_server_free_query_args(oph_query_arg ** args, unsigned int arg_count)
 	return 0;
 }
 
-void oph_io_server_thread(int sockfd, pthread_t tid)
+int oph_io_server_serve_request(oph_io_server_connection * conn, char *line, char *result)
 {
-	char *line = (char *) calloc(max_packet_length, sizeof(char));
-	if (!line) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-		return;
-	}
-	char *result = (char *) calloc(max_packet_length, sizeof(char));
-	if (!result) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-		free(result);
-		return;
+	if (!conn || !line || !result) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return -1;
 	}
 
 	char header[OPH_IO_SERVER_MSG_TYPE_LEN + 1], buffer[OPH_IO_SERVER_MAX_DOUBLE_LEN];
 	int res;
 	int m = 0;
+	int sockfd = conn->sockfd;
+	char keep_alive = 0;
 
 #ifdef DEBUG
 	//Total Exec time evaluate
@@ -143,23 +563,11 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 	struct timeval s_time, e_time, t_time;
 #endif
 
-	//Status of thread
-	oph_io_server_thread_status global_status;
-	global_status.current_db = NULL;
-	global_status.last_result_set = NULL;
-	global_status.delete_only_rs = 0;
-	global_status.device = NULL;
-	global_status.curr_stmt = NULL;
+	//Status of connection
+	oph_io_server_thread_status *status = &(conn->status);
 
 	oph_metadb_db_row *db_row = NULL;
 
-	//Poll socket 
-	int rv;
-	struct pollfd ufds[1];
-
-	ufds[0].fd = sockfd;
-	ufds[0].events = POLLIN;	// check for normal or out-of-band
-
 	unsigned long long current_threshold = 0;
 	char *result_buffer = NULL;
 	char *tmp_buffer = NULL;
@@ -171,31 +579,12 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 	unsigned int arg_count = 0;
 	unsigned long long tot_run = 0, curr_run = 0;
 
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a query from socket %d...\n", sockfd);
-	logging(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a query from socket %d...\n", sockfd);
-	for (;;) {
 #ifdef DEBUG
-		//Get time from first call
-		gettimeofday(&start_time, NULL);
+	//Get time from first call
+	gettimeofday(&start_time, NULL);
 #endif
-		// wait for events on the sockets, ttl second timeout
-		rv = poll(ufds, 1, client_ttl * 1000);
-
-		if (rv == -1) {
-			pmesg(LOG_WARNING, __FILE__, __LINE__, "Error in polling socket: %d\n", errno);
-			logging(LOG_WARNING, __FILE__, __LINE__, "Error in polling socket: %d\n", errno);
-			break;
-		} else if (rv == 0) {
-			pmesg(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
-			logging(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
-			break;
-		}
-		if (ufds[0].revents != POLLIN) {
-			pmesg(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
-			logging(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
-			break;
-		}
-
+	//Any break leaves the request and closes the connection
+	do {
 		res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_TYPE_LEN);
 		if (res > 0) {
 			//Request Manager section: handle request and call the correct function
@@ -212,6 +601,28 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 			//Decode message and find payload length
 			snprintf(header, OPH_IO_SERVER_MSG_TYPE_LEN + 1, "%s", line);
 
+			//A pipelined request is prefixed by a tag, which is echoed just before the reply
+			if (STRCMP(header, OPH_IO_SERVER_MSG_TAG) == 0) {
+				char tag[OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN];
+				memcpy(tag, OPH_IO_SERVER_MSG_TAG, OPH_IO_SERVER_MSG_TYPE_LEN);
+				res = oph_net_readn(sockfd, tag + OPH_IO_SERVER_MSG_TYPE_LEN, OPH_IO_SERVER_MSG_SHORT_LEN);
+				if (res != OPH_IO_SERVER_MSG_SHORT_LEN)
+					break;
+				//The tag is coalesced with the reply written next
+				if (send(sockfd, tag, sizeof(tag), OPH_IO_SERVER_SEND_MORE) != sizeof(tag)) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					break;
+				}
+				res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_TYPE_LEN);
+				if (res != OPH_IO_SERVER_MSG_TYPE_LEN)
+					break;
+				line[OPH_IO_SERVER_MSG_TYPE_LEN] = 0;
+				snprintf(header, OPH_IO_SERVER_MSG_TYPE_LEN + 1, "%s", line);
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Received pipelined query '%s' with tag %u\n", header, *((unsigned int *) (tag + OPH_IO_SERVER_MSG_TYPE_LEN)));
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Received pipelined query '%s' with tag %u\n", header, *((unsigned int *) (tag + OPH_IO_SERVER_MSG_TYPE_LEN)));
+			}
+
 			//Select operation
 			if (STRCMP(header, OPH_IO_SERVER_MSG_PING) == 0) {
 				//Answer to ping
@@ -224,6 +635,40 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				}
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+			} else if (STRCMP(header, OPH_IO_SERVER_MSG_PROTOCOL) == 0) {
+				//Negotiate protocol options
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Negotiating protocol options...\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Negotiating protocol options...\n");
+				res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_SHORT_LEN);
+				if (res != OPH_IO_SERVER_MSG_SHORT_LEN)
+					break;
+				//Enable only the options known by the server and send them back
+				status->protocol = *((unsigned int *) line) & OPH_IO_SERVER_PROTOCOL_SUPPORTED;
+				//Binary cells and the shared memory ring apply only to result frames
+				if (!(status->protocol & OPH_IO_SERVER_PROTOCOL_RESULT_FRAMES))
+					status->protocol = 0;
+				//The shared memory ring is offered only to clients connected through the Unix domain socket
+				if ((status->protocol & OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY)
+				    && (!conn->is_local || !shm_ring_size || (!status->ring && _oph_io_server_create_ring(&(status->ring), shm_ring_size))))
+					status->protocol &= ~OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY;
+				if (!(status->protocol & OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY) && status->ring)
+					_oph_io_server_destroy_ring(&(status->ring));
+				//Reply TYPE|OPTIONS, followed by SHM_ID|RING_SIZE if the ring is enabled
+				memcpy(result, OPH_IO_SERVER_MSG_PROTOCOL, OPH_IO_SERVER_MSG_TYPE_LEN);
+				memcpy(result + OPH_IO_SERVER_MSG_TYPE_LEN, (void *) &(status->protocol), OPH_IO_SERVER_MSG_SHORT_LEN);
+				m = OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN;
+				if (status->ring) {
+					memcpy(result + m, (void *) &(status->ring->shm_id), OPH_IO_SERVER_MSG_SHORT_LEN);
+					memcpy(result + m + OPH_IO_SERVER_MSG_SHORT_LEN, (void *) &(status->ring->size), OPH_IO_SERVER_MSG_LONG_LEN);
+					m += OPH_IO_SERVER_MSG_SHORT_LEN + OPH_IO_SERVER_MSG_LONG_LEN;
+				}
+				if (oph_net_writen(sockfd, result, m) != (ssize_t) m) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					break;
+				}
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Protocol options set to %u\n", status->protocol);
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Protocol options set to %u\n", status->protocol);
 			} else if (STRCMP(header, OPH_IO_SERVER_MSG_USE_DB) == 0) {
 				//Set database
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Setting default database...\n");
@@ -263,10 +708,10 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Device name: %s\n", result);
 
 				//TODO perform coerence check to verify device existance
-				if (global_status.device)
-					free(global_status.device);
-				global_status.device = (char *) strndup(result, strlen(result));
-				if (global_status.device == NULL) {
+				if (status->device)
+					free(status->device);
+				status->device = (char *) strndup(result, strlen(result));
+				if (status->device == NULL) {
 					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 					break;
@@ -280,7 +725,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				}
 
 				if (db_table != NULL) {
-					if (oph_metadb_find_db(db_table, line, global_status.device, &db_row) || db_row == NULL) {
+					if (oph_metadb_find_db(db_table, line, status->device, &db_row) || db_row == NULL) {
 						if (pthread_rwlock_unlock(&rwlock) != 0) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to unlock mutex\n");
 							logging(LOG_ERROR, __FILE__, __LINE__, "Unable to unlock mutex\n");
@@ -299,10 +744,10 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 							break;
 						}
 						//Set current db name
-						if (global_status.current_db)
-							free(global_status.current_db);
-						global_status.current_db = (char *) strndup(line, strlen(line));
-						if (global_status.current_db == NULL) {
+						if (status->current_db)
+							free(status->current_db);
+						status->current_db = (char *) strndup(line, strlen(line));
+						if (status->current_db == NULL) {
 							pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 							logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 							oph_io_server_send_error(sockfd);
@@ -337,7 +782,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				//Get resultset
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Retrieving result set...\n");
 
-				if (global_status.last_result_set == NULL) {
+				if (status->last_result_set == NULL) {
 					pmesg(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
 					logging(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
 					oph_io_server_send_error(sockfd);
@@ -360,7 +805,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				i = 0;
 				j = 0;
 				size = 0;
-				num_fields = global_status.last_result_set->field_num;
+				num_fields = status->last_result_set->field_num;
 
 				if (k >= current_threshold) {
 					current_threshold *= 2;
@@ -375,21 +820,25 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 					result_buffer = tmp_buffer;
 				}
 				//If non-empty record set
-				if (global_status.last_result_set->record_set != NULL) {
+				if (status->last_result_set->record_set != NULL) {
 
-					while (global_status.last_result_set->record_set[i]) {
+					while (status->last_result_set->record_set[i]) {
 						//Send each row of result set
 
 						//TODO send also field name
 						for (j = 0; j < num_fields; j++) {
 							//Check field type
-							if (global_status.last_result_set->field_type[j] != OPH_IOSTORE_STRING_TYPE) {
+							if (status->last_result_set->field_type[j] != OPH_IOSTORE_STRING_TYPE) {
 								//Convert to string
-								if (global_status.last_result_set->field_type[j] == OPH_IOSTORE_LONG_TYPE) {
-									snprintf(buffer, OPH_IO_SERVER_MAX_LONG_LEN, "%llu",
-										 *((unsigned long long *) global_status.last_result_set->record_set[i]->field[j]));
+								if (status->last_result_set->field_type[j] == OPH_IOSTORE_LONG_TYPE) {
+									if (OPH_IOSTORE_IS_IMPLICIT_ID(status->last_result_set, j))
+										snprintf(buffer, OPH_IO_SERVER_MAX_LONG_LEN, "%llu",
+											 (unsigned long long) OPH_IOSTORE_RECORD_ID(status->last_result_set, status->last_result_set->record_set[i]));
+									else
+										snprintf(buffer, OPH_IO_SERVER_MAX_LONG_LEN, "%llu",
+											 *((unsigned long long *) status->last_result_set->record_set[i]->field[j]));
 								} else {
-									snprintf(buffer, OPH_IO_SERVER_MAX_DOUBLE_LEN, "%f", *((double *) global_status.last_result_set->record_set[i]->field[j]));
+									snprintf(buffer, OPH_IO_SERVER_MAX_DOUBLE_LEN, "%f", *((double *) status->last_result_set->record_set[i]->field[j]));
 								}
 								size = strlen(buffer) + 1;
 
@@ -415,7 +864,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 								//String and binary values are already char*
 
 								//Check current size
-								if ((k + global_status.last_result_set->record_set[i]->field_length[j] + sizeof(unsigned long long)) >= current_threshold) {
+								if ((k + status->last_result_set->record_set[i]->field_length[j] + sizeof(unsigned long long)) >= current_threshold) {
 									current_threshold *= 2;
 									tmp_buffer = (char *) realloc(result_buffer, current_threshold * sizeof(char));
 									if (!tmp_buffer) {
@@ -428,11 +877,11 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 									result_buffer = tmp_buffer;
 								}
 
-								memcpy(result_buffer + k, (void *) &(global_status.last_result_set->record_set[i]->field_length[j]), sizeof(unsigned long long));
+								memcpy(result_buffer + k, (void *) &(status->last_result_set->record_set[i]->field_length[j]), sizeof(unsigned long long));
 								k += sizeof(unsigned long long);
-								memcpy(result_buffer + k, (void *) (global_status.last_result_set->record_set[i]->field[j]),
-								       global_status.last_result_set->record_set[i]->field_length[j]);
-								k += global_status.last_result_set->record_set[i]->field_length[j];
+								memcpy(result_buffer + k, (void *) (status->last_result_set->record_set[i]->field[j]),
+								       status->last_result_set->record_set[i]->field_length[j]);
+								k += status->last_result_set->record_set[i]->field_length[j];
 							}
 							pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg[%d] progressive length is: %lld\n", j, k);
 						}
@@ -460,6 +909,105 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
 
 				free(result_buffer);
+			} else if (STRCMP(header, OPH_IO_SERVER_MSG_RESULT_FRAMES) == 0) {
+				//Stream resultset in frames of at most max_packet_length bytes
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Streaming result set...\n");
+
+				if (status->last_result_set == NULL) {
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
+					logging(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
+					oph_io_server_send_error(sockfd);
+					break;
+				}
+				//The worker buffer holds one frame at a time
+				if (oph_io_server_send_result_frames(sockfd, status->last_result_set, result, max_packet_length, status->protocol, status->ring)) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					break;
+				}
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+			} else if (STRCMP(header, OPH_IO_SERVER_MSG_BULK_INSERT) == 0) {
+				//Append a batch of rows to the fragment being created
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Receiving bulk insert...\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Receiving bulk insert...\n");
+				//Read number of rows, number of fields and final flag
+				res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_LONG_LEN + 2 * OPH_IO_SERVER_MSG_SHORT_LEN);
+				if (res != (int) (OPH_IO_SERVER_MSG_LONG_LEN + 2 * OPH_IO_SERVER_MSG_SHORT_LEN))
+					break;
+				size = *((unsigned long long *) line);
+				num_fields = *((unsigned int *) (line + OPH_IO_SERVER_MSG_LONG_LEN));
+				n = *((unsigned int *) (line + OPH_IO_SERVER_MSG_LONG_LEN + OPH_IO_SERVER_MSG_SHORT_LEN));
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Number of rows: %llu - number of fields: %u\n", size, num_fields);
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Number of rows: %llu - number of fields: %u\n", size, num_fields);
+
+				//Read fragment name
+				res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_LONG_LEN);
+				if (res != OPH_IO_SERVER_MSG_LONG_LEN)
+					break;
+				payload_len = *((unsigned long long *) line);
+				if (payload_len >= max_packet_length) {
+					//Request too long
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Request length is too big ...\n");
+					logging(LOG_WARNING, __FILE__, __LINE__, "Request length is too big ...\n");
+					oph_io_server_send_error(sockfd);
+					break;
+				}
+				res = oph_net_readn(sockfd, line, payload_len);
+				if (res <= 0)
+					break;
+				line[payload_len] = 0;
+
+				//Columns are decoded according to the fragment created by the running statement
+				if (!status->curr_stmt || !status->curr_stmt->partial_result_set || status->curr_stmt->partial_result_set->field_num != num_fields) {
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
+					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
+					oph_io_server_send_error(sockfd);
+					break;
+				}
+				oph_iostore_frag_column *column = (oph_iostore_frag_column *) calloc(num_fields, sizeof(oph_iostore_frag_column));
+				if (!column) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+					logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+					oph_io_server_send_error(sockfd);
+					break;
+				}
+				if (oph_io_server_recv_bulk_columns(sockfd, status->curr_stmt->partial_result_set, size, column)) {
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to receive columns of fragment %s\n", line);
+					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to receive columns of fragment %s\n", line);
+					free(column);
+					oph_io_server_send_error(sockfd);
+					break;
+				}
+
+				oph_iostore_handler *dev_handle = NULL;
+				if (!status->device || oph_iostore_setup(status->device, &dev_handle) != 0) {
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
+					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
+					oph_iostore_free_frag_columns(column, num_fields);
+					free(column);
+					oph_io_server_send_error(sockfd);
+					break;
+				}
+				res = oph_io_server_run_bulk_insert(&db_table, dev_handle, status, line, size, column, n ? 1 : 0);
+				oph_iostore_cleanup(dev_handle);
+				//Columns not adopted by the fragment are released
+				oph_iostore_free_frag_columns(column, num_fields);
+				free(column);
+				if (res) {
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
+					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
+					oph_io_server_send_error(sockfd);
+					break;
+				}
+
+				if (write(sockfd, (void *) OPH_IO_SERVER_MSG_BULK_INSERT, strlen(OPH_IO_SERVER_MSG_BULK_INSERT)) != strlen(OPH_IO_SERVER_MSG_BULK_INSERT)) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					break;
+				}
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
 			} else if (STRCMP(header, OPH_IO_SERVER_MSG_EXEC_QUERY) == 0) {
 
 #ifdef DEBUG
@@ -491,7 +1039,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				if (res <= 0)
 					break;
 				line[payload_len] = 0;
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query is: %s - threadID: %lu\n", line, tid);
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query is: %s - threadID: %lu\n", line, pthread_self());
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Query is: %s\n", line);
 
 				//Read payload len
@@ -519,10 +1067,10 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Device name: %s\n", result);
 
 				//TODO perform coerence check to verify device existance
-				if (global_status.device)
-					free(global_status.device);
-				global_status.device = (char *) strndup(result, strlen(result));
-				if (global_status.device == NULL) {
+				if (status->device)
+					free(status->device);
+				status->device = (char *) strndup(result, strlen(result));
+				if (status->device == NULL) {
 					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 					break;
@@ -556,7 +1104,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 					logging(LOG_DEBUG, __FILE__, __LINE__, "Current run: %llu\n", curr_run);
 
 					//Check if current statement is already in progress
-					if (global_status.curr_stmt != NULL) {
+					if (status->curr_stmt != NULL) {
 						if (curr_run > tot_run) {
 							//Corrupted section then exit
 							pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
@@ -565,8 +1113,8 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 							break;
 						} else {
 							//Decode message and update statement status
-							global_status.curr_stmt->curr_run = curr_run;
-							global_status.curr_stmt->tot_run = tot_run;
+							status->curr_stmt->curr_run = curr_run;
+							status->curr_stmt->tot_run = tot_run;
 
 							args = (oph_query_arg **) calloc(arg_count + 1, sizeof(oph_query_arg *));
 							if (!args) {
@@ -652,14 +1200,14 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 							break;
 						} else {
 							//Create first struct 
-							global_status.curr_stmt = (oph_io_server_running_stmt *) malloc(1 * sizeof(oph_io_server_running_stmt));
-							global_status.curr_stmt->tot_run = tot_run;
-							global_status.curr_stmt->curr_run = curr_run;
-							global_status.curr_stmt->partial_result_set = NULL;
-							global_status.curr_stmt->device = NULL;
-							global_status.curr_stmt->frag = NULL;
-							global_status.curr_stmt->size = 0;
-							global_status.curr_stmt->mi_prev_rows = 0;
+							status->curr_stmt = (oph_io_server_running_stmt *) malloc(1 * sizeof(oph_io_server_running_stmt));
+							status->curr_stmt->tot_run = tot_run;
+							status->curr_stmt->curr_run = curr_run;
+							status->curr_stmt->partial_result_set = NULL;
+							status->curr_stmt->device = NULL;
+							status->curr_stmt->frag = NULL;
+							status->curr_stmt->size = 0;
+							status->curr_stmt->mi_prev_rows = 0;
 
 							args = (oph_query_arg **) calloc(arg_count + 1, sizeof(oph_query_arg *));
 
@@ -739,7 +1287,8 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				//Define global variables
 				HASHTBL *query_args = NULL;
 
-				if (oph_query_parser(line, &query_args)) {
+				//Statements already parsed are taken from the cache
+				if (oph_io_server_parse_query(line, &query_args)) {
 					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
 					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
 					oph_io_server_send_error(sockfd);
@@ -755,7 +1304,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 
 				oph_iostore_handler *dev_handle = NULL;
 
-				if (oph_iostore_setup(global_status.device, &dev_handle) != 0) {
+				if (oph_iostore_setup(status->device, &dev_handle) != 0) {
 					hashtbl_destroy(query_args);
 					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
 					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
@@ -764,7 +1313,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 					break;
 				}
 				//TODO if query is SELECT then set globally last result set
-				if (oph_io_server_dispatcher(&db_table, dev_handle, &global_status, args, query_args, plugin_table)) {
+				if (oph_io_server_dispatcher(&db_table, dev_handle, status, args, query_args, plugin_table)) {
 
 					oph_iostore_cleanup(dev_handle);
 					hashtbl_destroy(query_args);
@@ -814,15 +1363,287 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 		} else if (res <= 0)
 			break;
 
+		keep_alive = 1;
+	} while (0);
+
 #ifdef DEBUG
-		gettimeofday(&end_time, NULL);
-		timeval_subtract(&total_time, &end_time, &start_time);
-		pmesg(LOG_INFO, __FILE__, __LINE__, "Total reply:\t Time %d,%06d sec\n", (int) total_time.tv_sec, (int) total_time.tv_usec);
+	gettimeofday(&end_time, NULL);
+	timeval_subtract(&total_time, &end_time, &start_time);
+	pmesg(LOG_INFO, __FILE__, __LINE__, "Total reply:\t Time %d,%06d sec\n", (int) total_time.tv_sec, (int) total_time.tv_usec);
 #endif
+
+	return keep_alive ? 0 : -1;
+}
+
+//Close a connection already removed from the list (conn_lock must not be held)
+static void _oph_io_server_close_connection(oph_io_server_connection * conn)
+{
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection on socket %d...\n", conn->sockfd);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection on socket %d...\n", conn->sockfd);
+
+	if (close(conn->sockfd) == -1)
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Error while closing connection!\n");
+	oph_io_server_free_status(&(conn->status));
+	free(conn);
+}
+
+static void _oph_io_server_unlink_connection(oph_io_server_connection * conn)
+{
+	if (conn->prev)
+		conn->prev->next = conn->next;
+	else
+		conn_list = conn->next;
+	if (conn->next)
+		conn->next->prev = conn->prev;
+	conn->prev = conn->next = NULL;
+}
+
+//Serve the requests dispatched by the reactor, one at a time
+static void *_oph_io_server_worker(void *arg)
+{
+	(void) arg;
+
+	if (pthread_detach(pthread_self()) != 0)
+		return (NULL);
+
+	char *line = (char *) calloc(max_packet_length, sizeof(char));
+	char *result = (char *) calloc(max_packet_length, sizeof(char));
+	if (!line || !result) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+		free(line);
+		free(result);
+		return (NULL);
+	}
+
+	oph_io_server_connection *conn = NULL;
+	struct epoll_event event;
+	int res, n;
+	char pending;
+
+	for (;;) {
+		pthread_mutex_lock(&conn_lock);
+		while (!ready_head)
+			pthread_cond_wait(&conn_cond, &conn_lock);
+		conn = ready_head;
+		ready_head = conn->next_ready;
+		if (!ready_head)
+			ready_tail = NULL;
+		conn->next_ready = NULL;
+		pthread_mutex_unlock(&conn_lock);
+
+		if ((conn->events & (EPOLLERR | EPOLLHUP)) || !(conn->events & EPOLLIN)) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
+			logging(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
+			res = -1;
+		} else {
+			//Serve the requests already queued by a pipelining client before rearming the socket
+			n = 0;
+			do
+				res = oph_io_server_serve_request(conn, line, result);
+			while (!res && ++n < OPH_IO_SERVER_PIPELINE_BATCH && recv(conn->sockfd, &pending, 1, MSG_PEEK | MSG_DONTWAIT) > 0);
+		}
+
+		pthread_mutex_lock(&conn_lock);
+		if (!res) {
+			//Wait for the next request of the client
+			conn->busy = 0;
+			conn->last_activity = time(NULL);
+			event.events = EPOLLIN | EPOLLONESHOT;
+			event.data.ptr = conn;
+			res = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->sockfd, &event);
+		}
+		if (res)
+			_oph_io_server_unlink_connection(conn);
+		pthread_mutex_unlock(&conn_lock);
+
+		if (res)
+			_oph_io_server_close_connection(conn);
 	}
 
-	oph_io_server_free_status(&global_status);
 	free(result);
 	free(line);
+	return (NULL);
+}
 
+//Close the connections that have not sent any request for client_ttl seconds (busy connections are released by the receive timeout of the worker)
+static void _oph_io_server_sweep_connections(time_t now)
+{
+	oph_io_server_connection *conn = NULL, *next = NULL, *expired = NULL;
+
+	pthread_mutex_lock(&conn_lock);
+	for (conn = conn_list; conn; conn = next) {
+		next = conn->next;
+		if (conn->busy || conn->last_activity + (time_t) client_ttl > now)
+			continue;
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->sockfd, NULL);
+		_oph_io_server_unlink_connection(conn);
+		conn->next = expired;
+		expired = conn;
+	}
+	pthread_mutex_unlock(&conn_lock);
+
+	for (conn = expired; conn; conn = next) {
+		next = conn->next;
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
+		_oph_io_server_close_connection(conn);
+	}
+}
+
+static void _oph_io_server_accept_connection(int listenfd, struct sockaddr *cliaddr, socklen_t addrlen, char is_local)
+{
+	socklen_t clilen = addrlen;
+	int connfd = 0;
+
+	if (oph_net_accept(listenfd, cliaddr, &clilen, &connfd) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
+		return;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", connfd);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", connfd);
+
+	//A client stalled in the middle of a request releases its worker after client_ttl seconds
+	if (client_ttl) {
+		struct timeval timeout = { client_ttl, 0 };
+		if (setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set receive timeout on socket %d\n", connfd);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set receive timeout on socket %d\n", connfd);
+		}
+	}
+
+	oph_io_server_connection *conn = (oph_io_server_connection *) calloc(1, sizeof(oph_io_server_connection));
+	if (!conn) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate connection status\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate connection status\n");
+		close(connfd);
+		return;
+	}
+	conn->sockfd = connfd;
+	conn->is_local = is_local;
+	conn->last_activity = time(NULL);
+
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = conn;
+
+	pthread_mutex_lock(&conn_lock);
+	conn->next = conn_list;
+	if (conn_list)
+		conn_list->prev = conn;
+	conn_list = conn;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connfd, &event)) {
+		_oph_io_server_unlink_connection(conn);
+		pthread_mutex_unlock(&conn_lock);
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to poll socket %d: %d\n", connfd, errno);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to poll socket %d: %d\n", connfd, errno);
+		_oph_io_server_close_connection(conn);
+		return;
+	}
+	pthread_mutex_unlock(&conn_lock);
+}
+
+int oph_io_server_reactor(int listenfd, int local_listenfd, struct sockaddr *cliaddr, socklen_t addrlen, unsigned short worker_num)
+{
+	if (!cliaddr) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return -1;
+	}
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create epoll instance: %d\n", errno);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to create epoll instance: %d\n", errno);
+		return -1;
+	}
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = &tcp_listener;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listenfd, &event)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to poll listening socket: %d\n", errno);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to poll listening socket: %d\n", errno);
+		close(epoll_fd);
+		epoll_fd = -1;
+		return -1;
+	}
+	event.data.ptr = &local_listener;
+	if (local_listenfd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, local_listenfd, &event)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to poll Unix domain socket: %d\n", errno);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to poll Unix domain socket: %d\n", errno);
+		close(epoll_fd);
+		epoll_fd = -1;
+		return -1;
+	}
+
+	unsigned short w, started = 0;
+	pthread_t tid;
+	if (!worker_num)
+		worker_num = OPH_IO_SERVER_DEFAULT_WORKERS;
+	for (w = 0; w < worker_num; w++) {
+		if (pthread_create(&tid, NULL, &_oph_io_server_worker, NULL) != 0) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Error creating worker thread\n");
+			logging(LOG_WARNING, __FILE__, __LINE__, "Error creating worker thread\n");
+			continue;
+		}
+		started++;
+	}
+	if (!started) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No worker thread is available\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "No worker thread is available\n");
+		close(epoll_fd);
+		epoll_fd = -1;
+		return -1;
+	}
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Started %u worker threads\n", started);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Started %u worker threads\n", started);
+
+	struct epoll_event events[OPH_IO_SERVER_EPOLL_EVENTS];
+	oph_io_server_connection *conn = NULL;
+	time_t now, last_sweep = time(NULL);
+	int e, event_num;
+
+	for (;;) {
+		event_num = epoll_wait(epoll_fd, events, OPH_IO_SERVER_EPOLL_EVENTS, OPH_IO_SERVER_SWEEP_PERIOD * 1000);
+		if (event_num < 0) {
+			if (errno != EINTR) {
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Error in polling sockets: %d\n", errno);
+				logging(LOG_WARNING, __FILE__, __LINE__, "Error in polling sockets: %d\n", errno);
+			}
+			event_num = 0;
+		}
+
+		now = time(NULL);
+		for (e = 0; e < event_num; e++) {
+			if (events[e].data.ptr == &tcp_listener) {
+				_oph_io_server_accept_connection(listenfd, cliaddr, addrlen, 0);
+				continue;
+			}
+			if (events[e].data.ptr == &local_listener) {
+				_oph_io_server_accept_connection(local_listenfd, cliaddr, addrlen, 1);
+				continue;
+			}
+			//The connection is disarmed (one-shot) until its worker has answered
+			conn = (oph_io_server_connection *) events[e].data.ptr;
+			pthread_mutex_lock(&conn_lock);
+			conn->events = events[e].events;
+			conn->busy = 1;
+			if (ready_tail)
+				ready_tail->next_ready = conn;
+			else
+				ready_head = conn;
+			ready_tail = conn;
+			pthread_cond_signal(&conn_cond);
+			pthread_mutex_unlock(&conn_lock);
+		}
+
+		if (client_ttl && now - last_sweep >= OPH_IO_SERVER_SWEEP_PERIOD) {
+			_oph_io_server_sweep_connections(now);
+			last_sweep = now;
+		}
+	}
+
+	return 0;
 }
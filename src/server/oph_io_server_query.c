@@ -187,7 +187,8 @@ int oph_io_server_dispatcher(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 		}
 		free(frag_components);
 
-		if (thread_status->curr_stmt->curr_run == 1 || (thread_status->curr_stmt->curr_run == 0 && thread_status->curr_stmt->tot_run == 0)) {
+		//Rows of columnar fragments are appended to the columns, so no record_set array is needed
+		if (tmp->layout != OPH_IOSTORE_COLUMN_LAYOUT && (thread_status->curr_stmt->curr_run == 1 || (thread_status->curr_stmt->curr_run == 0 && thread_status->curr_stmt->tot_run == 0))) {
 			//0- For first time: create record_set array - Also executed when it is a single run
 			tmp->record_set = (oph_iostore_frag_record **) calloc(1 + (thread_status->curr_stmt->tot_run ? thread_status->curr_stmt->tot_run : 1), sizeof(oph_iostore_frag_record *));
 			if (tmp->record_set == NULL) {
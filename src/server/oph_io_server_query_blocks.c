@@ -448,6 +448,7 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 	}
 
 	unsigned int k;
+	long long curr_row;
 
 	for (k = 0; k < var_count; k++) {
 		if (field_binary[k]) {
@@ -463,13 +464,15 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 				return OPH_IO_SERVER_EXEC_ERROR;
 			}
 		} else {
+			curr_row = (where_start_id ? where_start_id[frag_indexes[k]] + row : row);
 			switch (inputs[frag_indexes[k]]->field_type[field_indexes[k]]) {
 				case OPH_IOSTORE_LONG_TYPE:
 					{
 						if (oph_query_expr_add_long
 						    (var_list[k],
-						     *((long long *) inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]]),
-						     table)) {
+						     (OPH_IOSTORE_IS_IMPLICIT_ID(inputs[frag_indexes[k]], field_indexes[k]) ?
+						      OPH_IOSTORE_ROW_ID(inputs[frag_indexes[k]], curr_row) :
+						      *((long long *) OPH_IOSTORE_FIELD(inputs[frag_indexes[k]], curr_row, field_indexes[k]))), table)) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							return OPH_IO_SERVER_EXEC_ERROR;
@@ -480,7 +483,7 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 					{
 						if (oph_query_expr_add_double
 						    (var_list[k],
-						     *((double *) inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]]),
+						     *((double *) OPH_IOSTORE_FIELD(inputs[frag_indexes[k]], curr_row, field_indexes[k])),
 						     table)) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
@@ -491,9 +494,8 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 					//TODO Check if string and binary can be treated separately
 				case OPH_IOSTORE_STRING_TYPE:
 					{
-						binary_var[k].arg = inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]];
-						binary_var[k].arg_length =
-						    inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field_length[field_indexes[k]];
+						binary_var[k].arg = OPH_IOSTORE_FIELD(inputs[frag_indexes[k]], curr_row, field_indexes[k]);
+						binary_var[k].arg_length = OPH_IOSTORE_FIELD_LENGTH(inputs[frag_indexes[k]], curr_row, field_indexes[k]);
 						if (oph_query_expr_add_binary(var_list[k], &(binary_var[k]), table)) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
@@ -762,6 +764,9 @@ int _oph_io_server_query_order_output(HASHTBL * query_args, oph_iostore_frag_rec
 				//If single row, then no order required
 				if (!rs->record_set[j])
 					break;
+				//Rows taken from a fragment with implicit ids are already ordered by id
+				if (OPH_IOSTORE_IS_IMPLICIT_ID(rs, i))
+					break;
 
 				switch (rs->field_type[i]) {
 					case OPH_IOSTORE_REAL_TYPE:
@@ -817,7 +822,7 @@ int _oph_io_server_query_order_output(HASHTBL * query_args, oph_iostore_frag_rec
 }
 
 
-int _oph_ioserver_query_release_input_record_set(oph_iostore_handler * dev_handle, oph_iostore_frag_record_set ** stored_rs, oph_iostore_frag_record_set ** input_rs)
+int _oph_ioserver_query_release_input_record_set(oph_iostore_handler * dev_handle, oph_iostore_frag_record_set ** stored_rs, oph_iostore_frag_record_set ** input_rs, int table_num)
 {
 	if (!dev_handle) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
@@ -825,20 +830,145 @@ int _oph_ioserver_query_release_input_record_set(oph_iostore_handler * dev_handl
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
 
+	//Lists may have holes (e.g. a fragment not loaded yet), so every slot is checked
 	int l = 0;
 	if (stored_rs) {
-		for (l = 0; stored_rs[l]; l++) {
-			if (dev_handle->is_persistent || stored_rs[l]->tmp_flag != 0)
+		//Both copies and references returned by devices are released
+		for (l = 0; l < table_num; l++)
+			if (stored_rs[l])
 				oph_iostore_destroy_frag_recordset(&(stored_rs[l]));
-		}
 		free(stored_rs);
 	}
 	if (input_rs) {
-		for (l = 0; input_rs[l]; l++) {
-			oph_iostore_destroy_frag_recordset_only(&(input_rs[l]));
-		}
+		for (l = 0; l < table_num; l++)
+			if (input_rs[l])
+				oph_iostore_destroy_frag_recordset_only(&(input_rs[l]));
 		free(input_rs);
 	}
+	//The query is over, so the thread can run on any NUMA node again
+	oph_iostore_run_on_node(-1);
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int _oph_ioserver_query_zone_constant(oph_query_expr_node * e, char long_only, double *value)
+{
+	//Only constants that are exactly representable as doubles are used to compare with zone maps
+	if (!e || e->type != eVALUE)
+		return 0;
+	if (e->value.type == OPH_QUERY_EXPR_TYPE_LONG && e->value.data.long_value >= -OPH_IO_SERVER_ZONE_MAX_EXACT && e->value.data.long_value <= OPH_IO_SERVER_ZONE_MAX_EXACT) {
+		*value = (double) e->value.data.long_value;
+		return 1;
+	}
+	if (!long_only && e->value.type == OPH_QUERY_EXPR_TYPE_DOUBLE && e->value.data.double_value >= -OPH_IO_SERVER_ZONE_MAX_EXACT
+	    && e->value.data.double_value <= OPH_IO_SERVER_ZONE_MAX_EXACT) {
+		*value = e->value.data.double_value;
+		return 1;
+	}
+	return 0;
+}
+
+int _oph_ioserver_query_zone_interval(oph_query_expr_node * e, const char *var, char is_long, double *lo, double *hi)
+{
+	//Return 1 if every row satisfying e has a value of var in [lo, hi], 0 if e does not bound var
+	if (!e)
+		return 0;
+
+	double left_lo, left_hi, right_lo, right_hi;
+	int left, right;
+
+	switch (e->type) {
+		case eAND:
+			left = _oph_ioserver_query_zone_interval(e->left, var, is_long, &left_lo, &left_hi);
+			right = _oph_ioserver_query_zone_interval(e->right, var, is_long, &right_lo, &right_hi);
+			if (!left && !right)
+				return 0;
+			*lo = !right || (left && left_lo > right_lo) ? left_lo : right_lo;
+			*hi = !right || (left && left_hi < right_hi) ? left_hi : right_hi;
+			return 1;
+		case eOR:
+			if (!_oph_ioserver_query_zone_interval(e->left, var, is_long, &left_lo, &left_hi) || !_oph_ioserver_query_zone_interval(e->right, var, is_long, &right_lo, &right_hi))
+				return 0;
+			*lo = left_lo < right_lo ? left_lo : right_lo;
+			*hi = left_hi > right_hi ? left_hi : right_hi;
+			return 1;
+		case eEQUAL:
+			if (e->left && e->left->type == eVAR && !STRCMP(e->left->name, var) && _oph_ioserver_query_zone_constant(e->right, 0, lo)) {
+				*hi = *lo;
+				return 1;
+			}
+			if (e->right && e->right->type == eVAR && !STRCMP(e->right->name, var) && _oph_ioserver_query_zone_constant(e->left, 0, lo)) {
+				*hi = *lo;
+				return 1;
+			}
+			return 0;
+		case eFUN:
+			{
+				//Arguments are linked in reverse order: oph_is_in_subset(id, start, step, stop); id is truncated to a long
+				if (!is_long || !e->name || STRCMP(e->name, "oph_is_in_subset"))
+					return 0;
+				oph_query_expr_node *arg[4], *tmp = e->left;
+				int i;
+				for (i = 3; i >= 0 && tmp && tmp->type == eARG; i--, tmp = tmp->right)
+					arg[i] = tmp->left;
+				if (i >= 0 || tmp || !arg[0] || arg[0]->type != eVAR || STRCMP(arg[0]->name, var))
+					return 0;
+				return _oph_ioserver_query_zone_constant(arg[1], 1, lo) && _oph_ioserver_query_zone_constant(arg[3], 1, hi);
+			}
+		default:
+			return 0;
+	}
+}
+
+int _oph_ioserver_query_zone_prune(oph_query_expr_node * e, char **var_list, int var_count, unsigned int *field_indexes, int *frag_indexes, char *field_binary,
+				   oph_iostore_frag_record_set ** stored_rs, long long *start_row_indexes, long long *first_row, long long *last_row)
+{
+	//Narrow [first_row, last_row] with the zone maps of the columns bounded by the where clause
+	int k;
+	char is_long;
+	double lo, hi, min, max;
+	long long row;
+	oph_iostore_field_stats *stats;
+
+	for (k = 0; k < var_count && *first_row <= *last_row; k++) {
+		if (field_binary[k] || !stored_rs[frag_indexes[k]]->stats)
+			continue;
+		stats = &(stored_rs[frag_indexes[k]]->stats[field_indexes[k]]);
+		is_long = stored_rs[frag_indexes[k]]->field_type[field_indexes[k]] == OPH_IOSTORE_LONG_TYPE;
+		if (!stats->count || !_oph_ioserver_query_zone_interval(e, var_list[k], is_long, &lo, &hi))
+			continue;
+		if (is_long) {
+			min = (double) stats->min.long_value;
+			max = (double) stats->max.long_value;
+		} else {
+			min = stats->min.double_value;
+			max = stats->max.double_value;
+		}
+		//No value of the fragment can satisfy the clause
+		if (lo > hi || hi < min || lo > max) {
+			*last_row = *first_row - 1;
+			break;
+		}
+		//Rows of a sequential column can be computed from the values
+		if (stats->is_sequential && min >= -OPH_IO_SERVER_ZONE_MAX_EXACT && max <= OPH_IO_SERVER_ZONE_MAX_EXACT) {
+			if (lo > min) {
+				row = (long long) lo;
+				if ((double) row < lo)
+					row++;
+				row -= stats->min.long_value + start_row_indexes[frag_indexes[k]];
+				if (row > *first_row)
+					*first_row = row;
+			}
+			if (hi < max) {
+				row = (long long) hi;
+				if ((double) row > hi)
+					row--;
+				row -= stats->min.long_value + start_row_indexes[frag_indexes[k]];
+				if (row < *last_row)
+					*last_row = row;
+			}
+		}
+	}
+
 	return OPH_IO_SERVER_SUCCESS;
 }
 
@@ -851,17 +981,30 @@ int _oph_ioserver_query_multi_table_where_assert(int table_num, short int *id_in
 	}
 	//Assume to have only inner join where clauses with unique and sorted ids 
 	char id_error_flag = 0;
-	long long a, b, j;
+	long long a, b, j, row_num;
 	long long table_min[table_num];
 	long long table_max[table_num];
 	int l;
 
 	for (l = 0; l < table_num; l++) {
-		table_min[l] = *((long long *) in_record_set[l]->record_set[0]->field[id_indexes[l]]);
-		for (j = 1; in_record_set[l]->record_set[j]; j++) {
+		//Implicit ids are sequential by construction
+		if (OPH_IOSTORE_IS_IMPLICIT_ID(in_record_set[l], id_indexes[l])) {
+			table_min[l] = in_record_set[l]->id_start;
+			table_max[l] = in_record_set[l]->id_start + in_record_set[l]->row_num - 1;
+			continue;
+		}
+		//Zone map already proves that ids are sequential
+		if (in_record_set[l]->stats && in_record_set[l]->stats[id_indexes[l]].is_sequential) {
+			table_min[l] = in_record_set[l]->stats[id_indexes[l]].min.long_value;
+			table_max[l] = in_record_set[l]->stats[id_indexes[l]].max.long_value;
+			continue;
+		}
+		table_min[l] = *((long long *) OPH_IOSTORE_FIELD(in_record_set[l], 0, id_indexes[l]));
+		row_num = oph_iostore_get_frag_row_num(in_record_set[l]);
+		for (j = 1; j < row_num; j++) {
 			//Verify order, uniqueness and no values missing
-			b = *((long long *) in_record_set[l]->record_set[j]->field[id_indexes[l]]);
-			a = *((long long *) in_record_set[l]->record_set[j - 1]->field[id_indexes[l]]);
+			b = *((long long *) OPH_IOSTORE_FIELD(in_record_set[l], j, id_indexes[l]));
+			a = *((long long *) OPH_IOSTORE_FIELD(in_record_set[l], j - 1, id_indexes[l]));
 			if ((b <= a) || (b - a) != 1) {
 				id_error_flag = 1;
 				break;
@@ -872,7 +1015,7 @@ int _oph_ioserver_query_multi_table_where_assert(int table_num, short int *id_in
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ID_MULTITABLE_CONSTRAINT_ERROR, in_record_set[l]->frag_name);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
-		table_max[l] = *((long long *) in_record_set[l]->record_set[j - 1]->field[id_indexes[l]]);
+		table_max[l] = *((long long *) OPH_IOSTORE_FIELD(in_record_set[l], j - 1, id_indexes[l]));
 	}
 
 	//Get min and max idvalues
@@ -895,8 +1038,17 @@ int _oph_ioserver_query_multi_table_where_assert(int table_num, short int *id_in
 
 	//Find index of minimum value in each table
 	for (l = 0; l < table_num; l++) {
-		for (j = 0; in_record_set[l]->record_set[j]; j++) {
-			a = *((long long *) in_record_set[l]->record_set[j]->field[id_indexes[l]]);
+		if (OPH_IOSTORE_IS_IMPLICIT_ID(in_record_set[l], id_indexes[l])) {
+			start_row_indexes[l] = tmp_min - in_record_set[l]->id_start;
+			continue;
+		}
+		if (in_record_set[l]->stats && in_record_set[l]->stats[id_indexes[l]].is_sequential) {
+			start_row_indexes[l] = tmp_min - in_record_set[l]->stats[id_indexes[l]].min.long_value;
+			continue;
+		}
+		row_num = oph_iostore_get_frag_row_num(in_record_set[l]);
+		for (j = 0; j < row_num; j++) {
+			a = *((long long *) OPH_IOSTORE_FIELD(in_record_set[l], j, id_indexes[l]));
 			if (a == tmp_min) {
 				start_row_indexes[l] = j;
 				break;
@@ -1012,13 +1164,18 @@ int _oph_ioserver_query_run_where_clause(char *where_string, oph_query_arg ** ar
 		}
 	}
 
+	//Skip the fragments or restrict the scan to the row range allowed by zone maps
+	long long first_row = 0, last_row = (*input_row_num) - 1;
+	if (var_count > 0)
+		_oph_ioserver_query_zone_prune(e, var_list, var_count, field_indexes, frag_indexes, field_binary, stored_rs, start_row_indexes, &first_row, &last_row);
+
 	oph_query_expr_value *res = NULL;
 
 	//TODO Count actual number of string/binary variables
 	oph_query_arg val_b[var_count];
 	long long curr_row = 0;
 
-	for (j = 0; j < (*input_row_num); j++) {
+	for (j = first_row; j <= last_row; j++) {
 
 		if (_oph_ioserver_query_set_parser_variables(args, var_list, var_count, stored_rs, table, field_indexes, frag_indexes, field_binary, val_b, where_string, j, start_row_indexes)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
@@ -1060,7 +1217,7 @@ int _oph_ioserver_query_run_where_clause(char *where_string, oph_query_arg ** ar
 			//Add result to each index table
 			if (result) {
 				for (l = 0; l < table_num; l++) {
-					input_rs[l]->record_set[curr_row] = stored_rs[l]->record_set[start_row_indexes[l] + j];
+					input_rs[l]->record_set[curr_row] = input_rs[l]->view ? &(input_rs[l]->view[start_row_indexes[l] + j]) : stored_rs[l]->record_set[start_row_indexes[l] + j];
 				}
 				curr_row++;
 			}
@@ -1742,10 +1899,10 @@ int _oph_io_server_query_load_from_esdm(oph_metadb_db_row ** meta_db, oph_iostor
 
 
 int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_arg ** args, oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, char *current_db,
-					       oph_iostore_frag_record_set *** stored_rs, long long *input_row_num, oph_iostore_frag_record_set *** input_rs, char *out_db_name, char *out_frag_name,
-					       char file_load_flag)
+					       oph_iostore_frag_record_set *** stored_rs, long long *input_row_num, oph_iostore_frag_record_set *** input_rs, int *input_table_num, char *out_db_name,
+					       char *out_frag_name, char file_load_flag)
 {
-	if (!dev_handle || !query_args || !stored_rs || !input_row_num || !input_rs || !meta_db || !current_db) {
+	if (!dev_handle || !query_args || !stored_rs || !input_row_num || !input_rs || !input_table_num || !meta_db || !current_db) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
@@ -1753,6 +1910,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 
 	*stored_rs = NULL;
 	*input_row_num = 0;
+	*input_table_num = 0;
 	*input_rs = NULL;
 
 	char create_flag = (out_db_name != NULL && out_frag_name != NULL);
@@ -1919,6 +2077,10 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 		}
 	}
 
+	//Fragments are read after their ids have been collected
+	oph_iostore_resource_id *in_frag_ids[table_list_num];
+	int in_frag_num = 0;
+
 	for (l = 0; l < table_list_num; l++) {
 
 		frag = NULL;
@@ -1936,7 +2098,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB find");
 			free(in_frag_names);
 			free(in_db_names);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			return OPH_IO_SERVER_METADB_ERROR;
 		}
 		//Check if Frag exists
@@ -1946,7 +2108,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag find");
 			free(in_frag_names);
 			free(in_db_names);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			return OPH_IO_SERVER_METADB_ERROR;
 		}
 		//TODO Lock table while working with it
@@ -1957,28 +2119,35 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_FRAG_NOT_EXIST_ERROR);
 			free(in_frag_names);
 			free(in_db_names);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
-		//Call API to read Frag
-		if (oph_iostore_get_frag(dev_handle, &(frag->frag_id), &(orig_record_sets[l])) != 0) {
-			pthread_rwlock_unlock(&rwlock);
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag");
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag");
-			free(in_frag_names);
-			free(in_db_names);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
-			return OPH_IO_SERVER_API_ERROR;
-		}
+		in_frag_ids[in_frag_num++] = &(frag->frag_id);
 	}
 	free(in_db_names);
 	free(in_frag_names);
 
+	//Call API to read all Frags at once
+	oph_iostore_frag_record_set *in_record_sets[table_list_num];
+	if (oph_iostore_get_frags(dev_handle, in_frag_ids, in_frag_num, in_record_sets) != 0) {
+		pthread_rwlock_unlock(&rwlock);
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frags");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frags");
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
+		return OPH_IO_SERVER_API_ERROR;
+	}
+	for (l = 0, in_frag_num = 0; l < table_list_num; l++)
+		if (!file_load_flag || file_pos != l)
+			orig_record_sets[l] = in_record_sets[in_frag_num++];
+	//Scan fragments from the CPUs of the node holding them
+	if (in_frag_num)
+		oph_iostore_run_on_node(in_record_sets[0]->numa_node);
+
 	//UNLOCK FROM HERE
 	if (pthread_rwlock_unlock(&rwlock) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 
@@ -1989,7 +2158,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 		if ((file_load_flag == 1) && _oph_io_server_query_load_from_file(meta_db, dev_handle, current_db, query_args, &(orig_record_sets[file_pos]), &frag_size)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to read data from NetCDF file\n");
 			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to read data from NetCDF file\n");
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 #endif
@@ -1997,7 +2166,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 		if ((file_load_flag == 2) && _oph_io_server_query_load_from_esdm(meta_db, dev_handle, current_db, query_args, &(orig_record_sets[file_pos]), &frag_size)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to read data from ESDM dataset\n");
 			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to read data from ESDM dataset\n");
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 #endif
@@ -2008,14 +2177,14 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 	//Build portion of fragments used in selection
 
 	//Count number of rows to compute
-	long long j = 0, total_row_number = 0;
+	long long i, total_row_number = 0;
 
 	//Prepare input record set
 	record_sets = (oph_iostore_frag_record_set **) calloc((table_list_num + 1), sizeof(oph_iostore_frag_record_set *));
 	if (!record_sets) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 		return OPH_IO_SERVER_MEMORY_ERROR;
 	}
 
@@ -2025,7 +2194,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 	if (from_aliases == NULL && table_list_num > 1) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FROM_ALIAS);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FROM_ALIAS);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 
@@ -2033,7 +2202,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 		if (oph_query_parse_multivalue_arg(from_aliases, &alias_list, &alias_num) || !alias_num || alias_num != table_list_num) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FROM_ALIAS);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FROM_ALIAS);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 	}
@@ -2042,16 +2211,14 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 	for (l = 0; l < table_list_num; l++) {
 
 		//Take the biggest row number as reference 
-		partial_tot_row_number = 0;
-		while (orig_record_sets[l]->record_set[partial_tot_row_number])
-			partial_tot_row_number++;
+		partial_tot_row_number = oph_iostore_get_frag_row_num(orig_record_sets[l]);
 		if (partial_tot_row_number > total_row_number)
 			total_row_number = partial_tot_row_number;
 
 		if ((oph_iostore_copy_frag_record_set_only(orig_record_sets[l], &(record_sets[l]), 0, 0) != 0)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			if (alias_list)
 				free(alias_list);
 			return OPH_IO_SERVER_MEMORY_ERROR;
@@ -2064,7 +2231,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 		if (record_sets[l]->frag_name == NULL) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			if (alias_list)
 				free(alias_list);
 			return OPH_IO_SERVER_MEMORY_ERROR;
@@ -2081,14 +2248,16 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 			if (_oph_ioserver_query_run_where_clause(where, args, table_list_num, orig_record_sets, &total_row_number, record_sets)) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, where);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, where);
-				_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+				_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 				return OPH_IO_SERVER_EXEC_ERROR;
 			}
 		} else {
-			//Get all rows
-			for (j = 0; j < total_row_number; j++) {
-				record_sets[0]->record_set[j] = orig_record_sets[0]->record_set[j];
-			}
+			//Get all rows (columnar fragments are read through the views of the copy)
+			if (total_row_number && record_sets[0]->view) {
+				for (i = 0; i < total_row_number; i++)
+					record_sets[0]->record_set[i] = &(record_sets[0]->view[i]);
+			} else if (total_row_number)
+				memcpy(record_sets[0]->record_set, orig_record_sets[0]->record_set, total_row_number * sizeof(oph_iostore_frag_record *));
 		}
 	} else {
 		if (where) {
@@ -2096,14 +2265,14 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 			if (_oph_ioserver_query_run_where_clause(where, args, table_list_num, orig_record_sets, &total_row_number, record_sets)) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, where);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, where);
-				_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+				_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 				return OPH_IO_SERVER_EXEC_ERROR;
 			}
 		} else {
 			//There should be a where clause in case of multitable query
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_WHERE_MULTITABLE);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_WHERE_MULTITABLE);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_list_num);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 	}
@@ -2112,21 +2281,35 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 	*stored_rs = orig_record_sets;
 	*input_row_num = total_row_number;
 	*input_rs = record_sets;
+	*input_table_num = table_list_num;
 
 	return OPH_IO_SERVER_SUCCESS;
 }
 
 int _oph_ioserver_query_build_input_record_set_create(HASHTBL * query_args, oph_query_arg ** args, oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, char *out_db_name,
 						      char *out_frag_name, char *current_db, oph_iostore_frag_record_set *** stored_rs, long long *input_row_num,
-						      oph_iostore_frag_record_set *** input_rs, char file_load_flag)
+						      oph_iostore_frag_record_set *** input_rs, int *input_table_num, char file_load_flag)
 {
-	return _oph_ioserver_query_build_input_record_set(query_args, args, meta_db, dev_handle, current_db, stored_rs, input_row_num, input_rs, out_db_name, out_frag_name, file_load_flag);
+	return _oph_ioserver_query_build_input_record_set(query_args, args, meta_db, dev_handle, current_db, stored_rs, input_row_num, input_rs, input_table_num, out_db_name, out_frag_name,
+							  file_load_flag);
 }
 
 int _oph_ioserver_query_build_input_record_set_select(HASHTBL * query_args, oph_query_arg ** args, oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, char *current_db,
-						      oph_iostore_frag_record_set *** stored_rs, long long *input_row_num, oph_iostore_frag_record_set *** input_rs)
+						      oph_iostore_frag_record_set *** stored_rs, long long *input_row_num, oph_iostore_frag_record_set *** input_rs, int *input_table_num)
 {
-	return _oph_ioserver_query_build_input_record_set(query_args, args, meta_db, dev_handle, current_db, stored_rs, input_row_num, input_rs, NULL, NULL, 0);
+	return _oph_ioserver_query_build_input_record_set(query_args, args, meta_db, dev_handle, current_db, stored_rs, input_row_num, input_rs, input_table_num, NULL, NULL, 0);
+}
+
+//Write a cell of the output record set; cells of a columnar output are appended to their column, so they have to be written in row order
+static int _oph_ioserver_query_set_output_cell(oph_iostore_frag_record_set * output, long long row, int col, const void *value, unsigned long long length)
+{
+	if (output->layout == OPH_IOSTORE_COLUMN_LAYOUT)
+		return oph_iostore_append_frag_cell(output, col, value, length) ? OPH_IO_SERVER_MEMORY_ERROR : OPH_IO_SERVER_SUCCESS;
+
+	output->record_set[row]->field[col] = length ? oph_iostore_alloc_frag_cell(output, value, length) : NULL;
+	output->record_set[row]->field_length[col] = length;
+
+	return length && !output->record_set[row]->field[col] ? OPH_IO_SERVER_MEMORY_ERROR : OPH_IO_SERVER_SUCCESS;
 }
 
 int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_list, int field_list_num, long long offset, long long total_row_number, oph_query_arg ** args,
@@ -2161,6 +2344,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 	oph_query_expr_symtable *table = NULL;
 	oph_query_expr_value *res = NULL;
 	unsigned int binary_index = 0;
+	int cell_error = 0;
 
 	long long actual_rows = 0, rows = 0;
 
@@ -2223,7 +2407,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || _oph_ioserver_query_set_output_cell(output, j, i, &val_d, sizeof(double))) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							if (group_lists) {
@@ -2234,9 +2418,6 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 							}
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) &val_d, sizeof(double));
-						output->record_set[j]->field_length[i] = sizeof(double);
 					}
 					output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
 					break;
@@ -2247,7 +2428,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || _oph_ioserver_query_set_output_cell(output, j, i, &val_l, sizeof(unsigned long long))) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							if (group_lists) {
@@ -2258,9 +2439,6 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 							}
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) &val_l, sizeof(unsigned long long));
-						output->record_set[j]->field_length[i] = sizeof(unsigned long long);
 					}
 					output->field_type[i] = OPH_IOSTORE_LONG_TYPE;
 					break;
@@ -2270,7 +2448,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || _oph_ioserver_query_set_output_cell(output, j, i, field_list[i], strlen(field_list[i]) + 1)) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							if (group_lists) {
@@ -2281,9 +2459,6 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 							}
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) (field_list[i]), strlen(field_list[i]) + 1);
-						output->record_set[j]->field_length[i] = strlen(field_list[i]) + 1;
 					}
 					output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
 					break;
@@ -2305,7 +2480,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || _oph_ioserver_query_set_output_cell(output, j, i, args[binary_index]->arg, args[binary_index]->arg_length)) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							if (group_lists) {
@@ -2316,9 +2491,6 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 							}
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) (args[binary_index]->arg), args[binary_index]->arg_length);
-						output->record_set[j]->field_length[i] = args[binary_index]->arg_length;
 					}
 					switch (args[binary_index]->arg_type) {
 						case OPH_QUERY_TYPE_LONG:
@@ -2413,6 +2585,13 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					}
 					free(field_components);
 
+					//Binary cells passed through unchanged are shared with the origin fragment instead of being copied
+					char share_cells = output->arena && output->layout == OPH_IOSTORE_ROW_LAYOUT && inputs[frag_index]->origin && inputs[frag_index]->field_type[field_index] == OPH_IOSTORE_STRING_TYPE
+					    && !oph_iostore_share_frag_recordset(output, inputs[frag_index]->origin);
+
+					//Set the column type before filling it, so that a sequential id column is detected and kept implicit while it is built
+					output->field_type[i] = inputs[frag_index]->field_type[field_index];
+
 					rows = (actual_rows ? actual_rows : total_row_number);
 					if (!use_seq_id) {
 						if (!group_lists) {
@@ -2429,11 +2608,19 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 									}
 									return OPH_IO_SERVER_MEMORY_ERROR;
 								}
-								output->record_set[j]->field[i] =
-								    inputs[frag_index]->record_set[id]->field_length[field_index] ?
-								    memdup(inputs[frag_index]->record_set[id]->field[field_index],
-									   inputs[frag_index]->record_set[id]->field_length[field_index]) : NULL;
-								output->record_set[j]->field_length[i] = inputs[frag_index]->record_set[id]->field_length[field_index];
+								if (OPH_IOSTORE_IS_IMPLICIT_ID(inputs[frag_index], field_index)) {
+									val_l = OPH_IOSTORE_RECORD_ID(inputs[frag_index], inputs[frag_index]->record_set[id]);
+									if (_oph_ioserver_query_set_output_cell(output, j, i, &val_l, sizeof(unsigned long long)))
+										break;
+									continue;
+								}
+								if (share_cells) {
+									output->record_set[j]->field[i] = inputs[frag_index]->record_set[id]->field_length[field_index] ?
+									    inputs[frag_index]->record_set[id]->field[field_index] : NULL;
+									output->record_set[j]->field_length[i] = inputs[frag_index]->record_set[id]->field_length[field_index];
+								} else if (_oph_ioserver_query_set_output_cell
+									   (output, j, i, inputs[frag_index]->record_set[id]->field[field_index], inputs[frag_index]->record_set[id]->field_length[field_index]))
+									break;
 							}
 						} else {
 							//Aggregation is used, no offset allowed
@@ -2449,11 +2636,21 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 									}
 									return OPH_IO_SERVER_MEMORY_ERROR;
 								}
-								output->record_set[j]->field[i] =
-								    inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index] ?
-								    memdup(inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field[field_index],
-									   inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index]) : NULL;
-								output->record_set[j]->field_length[i] = inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index];
+								if (OPH_IOSTORE_IS_IMPLICIT_ID(inputs[frag_index], field_index)) {
+									val_l = OPH_IOSTORE_RECORD_ID(inputs[frag_index], inputs[frag_index]->record_set[group_lists[j]->first->elem_index]);
+									if (_oph_ioserver_query_set_output_cell(output, j, i, &val_l, sizeof(unsigned long long)))
+										break;
+									continue;
+								}
+								if (share_cells) {
+									output->record_set[j]->field[i] =
+									    inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index] ?
+									    inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field[field_index] : NULL;
+									output->record_set[j]->field_length[i] = inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index];
+								} else if (_oph_ioserver_query_set_output_cell
+									   (output, j, i, inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field[field_index],
+									    inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index]))
+									break;
 							}
 						}
 					} else {
@@ -2471,11 +2668,21 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 								return OPH_IO_SERVER_MEMORY_ERROR;
 							}
 							val_l = start_id + j;
-							output->record_set[j]->field[i] = memdup(&val_l, sizeof(unsigned long long));
-							output->record_set[j]->field_length[i] = sizeof(unsigned long long);
+							if (_oph_ioserver_query_set_output_cell(output, j, i, &val_l, sizeof(unsigned long long)))
+								break;
 						}
 					}
-					output->field_type[i] = inputs[frag_index]->field_type[field_index];
+					if (j < rows) {
+						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+						if (group_lists) {
+							for (k = 0; k < actual_rows; k++)
+								if (group_lists[k])
+									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
+							free(group_lists);
+						}
+						return OPH_IO_SERVER_MEMORY_ERROR;
+					}
 					break;
 				}
 			case OPH_QUERY_FIELD_TYPE_FUNCTION:
@@ -2599,9 +2806,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 											{
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) &(res->data.double_value), sizeof(double));
-												output->record_set[function_row_number]->field_length[i] = sizeof(double);
+												cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, &(res->data.double_value), sizeof(double));
 												free(res);
 												break;
 											}
@@ -2609,9 +2814,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 											{
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_LONG_TYPE;
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) &(res->data.long_value), sizeof(unsigned long long));
-												output->record_set[function_row_number]->field_length[i] = sizeof(unsigned long long);
+												cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, &(res->data.long_value), sizeof(unsigned long long));
 												free(res);
 												break;
 											}
@@ -2620,12 +2823,16 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
 #ifdef PLUGIN_RES_COPY
-												output->record_set[function_row_number]->field[i] = (void *) res->data.string_value;
+												if (!output->arena && output->layout == OPH_IOSTORE_ROW_LAYOUT) {
+													output->record_set[function_row_number]->field[i] = (void *) res->data.string_value;
+													output->record_set[function_row_number]->field_length[i] = strlen(res->data.string_value) + 1;
+												} else {
+													cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.string_value, strlen(res->data.string_value) + 1);
+													free(res->data.string_value);
+												}
 #else
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) res->data.string_value, strlen(res->data.string_value) + 1);
+												cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.string_value, strlen(res->data.string_value) + 1);
 #endif
-												output->record_set[function_row_number]->field_length[i] = strlen(res->data.string_value) + 1;
 												free(res);
 												break;
 											}
@@ -2634,12 +2841,16 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
 #ifdef PLUGIN_RES_COPY
-												output->record_set[function_row_number]->field[i] = (void *) res->data.binary_value->arg;
+												if (!output->arena && output->layout == OPH_IOSTORE_ROW_LAYOUT) {
+													output->record_set[function_row_number]->field[i] = (void *) res->data.binary_value->arg;
+													output->record_set[function_row_number]->field_length[i] = res->data.binary_value->arg_length;
+												} else {
+													cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.binary_value->arg, res->data.binary_value->arg_length);
+													free(res->data.binary_value->arg);
+												}
 #else
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) res->data.binary_value->arg, res->data.binary_value->arg_length);
+												cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.binary_value->arg, res->data.binary_value->arg_length);
 #endif
-												output->record_set[function_row_number]->field_length[i] = res->data.binary_value->arg_length;
 												free(res->data.binary_value);
 												free(res);
 												break;
@@ -2655,6 +2866,14 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 												return OPH_IO_SERVER_EXEC_ERROR;
 											}
 									}
+									if (cell_error) {
+										pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+										logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+										oph_query_expr_delete_node(e, table);
+										oph_query_expr_destroy_symtable(table);
+										free(var_list);
+										return OPH_IO_SERVER_MEMORY_ERROR;
+									}
 									function_row_number++;
 								} else {
 									free(res);
@@ -2735,9 +2954,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 												{
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) &(res->data.double_value), sizeof(double));
-													output->record_set[function_row_number]->field_length[i] = sizeof(double);
+													cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, &(res->data.double_value), sizeof(double));
 													free(res);
 													break;
 												}
@@ -2745,9 +2962,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 												{
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_LONG_TYPE;
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) &(res->data.long_value), sizeof(unsigned long long));
-													output->record_set[function_row_number]->field_length[i] = sizeof(unsigned long long);
+													cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, &(res->data.long_value), sizeof(unsigned long long));
 													free(res);
 													break;
 												}
@@ -2756,12 +2971,16 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
 #ifdef PLUGIN_RES_COPY
-													output->record_set[function_row_number]->field[i] = (void *) res->data.string_value;
+													if (!output->arena && output->layout == OPH_IOSTORE_ROW_LAYOUT) {
+														output->record_set[function_row_number]->field[i] = (void *) res->data.string_value;
+														output->record_set[function_row_number]->field_length[i] = strlen(res->data.string_value) + 1;
+													} else {
+														cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.string_value, strlen(res->data.string_value) + 1);
+														free(res->data.string_value);
+													}
 #else
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) res->data.string_value, strlen(res->data.string_value) + 1);
+													cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.string_value, strlen(res->data.string_value) + 1);
 #endif
-													output->record_set[function_row_number]->field_length[i] = strlen(res->data.string_value) + 1;
 													free(res);
 													break;
 												}
@@ -2770,13 +2989,16 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
 #ifdef PLUGIN_RES_COPY
-													output->record_set[function_row_number]->field[i] = (void *) res->data.binary_value->arg;
+													if (!output->arena && output->layout == OPH_IOSTORE_ROW_LAYOUT) {
+														output->record_set[function_row_number]->field[i] = (void *) res->data.binary_value->arg;
+														output->record_set[function_row_number]->field_length[i] = res->data.binary_value->arg_length;
+													} else {
+														cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.binary_value->arg, res->data.binary_value->arg_length);
+														free(res->data.binary_value->arg);
+													}
 #else
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) res->data.binary_value->arg,
-															    res->data.binary_value->arg_length);
+													cell_error = _oph_ioserver_query_set_output_cell(output, function_row_number, i, res->data.binary_value->arg, res->data.binary_value->arg_length);
 #endif
-													output->record_set[function_row_number]->field_length[i] = res->data.binary_value->arg_length;
 													free(res->data.binary_value);
 													free(res);
 													break;
@@ -2796,6 +3018,18 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 													return OPH_IO_SERVER_EXEC_ERROR;
 												}
 										}
+										if (cell_error) {
+											pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+											logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+											oph_query_expr_delete_node(e, table);
+											oph_query_expr_destroy_symtable(table);
+											free(var_list);
+											for (k = 0; k < actual_rows; k++)
+												if (group_lists[k])
+													_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
+											free(group_lists);
+											return OPH_IO_SERVER_MEMORY_ERROR;
+										}
 										function_row_number++;
 									} else {
 										free(res);
@@ -2844,10 +3078,17 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 	}
 
 	actual_rows = (actual_rows ? actual_rows : total_row_number);
-	if (actual_rows != total_row_number) {
+	//Columns built directly are cut to the actual number of rows
+	if (output->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+		if (oph_iostore_seal_frag_columns(output, actual_rows)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	} else if (actual_rows != total_row_number) {
 		//Remove unnecessary rows
 		for (j = actual_rows; j < total_row_number; j++) {
-			oph_iostore_destroy_frag_record(&(output->record_set[j]), output->field_num);
+			oph_iostore_release_frag_record(output, &(output->record_set[j]));
 		}
 		//Realloc record set array
 		oph_iostore_frag_record **tmp = (oph_iostore_frag_record **) realloc(output->record_set, (actual_rows + 1) * sizeof(oph_iostore_frag_record *));
@@ -2922,6 +3163,27 @@ int _oph_ioserver_query_store_fragment(oph_metadb_db_row ** meta_db, oph_iostore
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
+	//Convert fragment to the layout used by the device before publishing it
+	if ((*final_result_set)->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+		//Columns built while inserting are shrunk to fit
+		if (oph_iostore_seal_frag_columns(*final_result_set, (*final_result_set)->row_num) || oph_iostore_get_frag_recordset_size(*final_result_set, &frag_size)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	} else if (dev_handle->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+		if (oph_iostore_frag_recordset_to_columns(*final_result_set) || oph_iostore_get_frag_recordset_size(*final_result_set, &frag_size)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	}
+	//Build the zone maps used by selections to skip the fragment
+	if (oph_iostore_compute_frag_stats(*final_result_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
 	//Check current db
 	oph_metadb_db_row *db_row = NULL;
 
@@ -3017,7 +3279,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 	}
 	//Created record struct
 	*new_record = NULL;
-	if (oph_iostore_create_frag_record(new_record, partial_result_set->field_num) == 1) {
+	if (oph_iostore_alloc_frag_record(partial_result_set, new_record)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		return OPH_IO_SERVER_MEMORY_ERROR;
@@ -3042,7 +3304,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 	if (memory_check()) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-		oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+		oph_iostore_release_frag_record(partial_result_set, new_record);
 		return OPH_IO_SERVER_MEMORY_ERROR;
 	}
 
@@ -3051,14 +3313,14 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 		if (STRCMP(field_list[i], partial_result_set->field_name[i]) == 1) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_INSERT_COLUMN_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_INSERT_COLUMN_ERROR);
-			oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+			oph_iostore_release_frag_record(partial_result_set, new_record);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 		//Check for field type
 		if (oph_query_field_type(value_list[i], &field_type)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_TYPE_ERROR, value_list[i]);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_TYPE_ERROR, value_list[i]);
-			oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+			oph_iostore_release_frag_record(partial_result_set, new_record);
 			return OPH_IO_SERVER_PARSE_ERROR;
 		}
 
@@ -3069,7 +3331,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 					if (!args) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
-						oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+						oph_iostore_release_frag_record(partial_result_set, new_record);
 						return OPH_IO_SERVER_NULL_PARAM;
 					}
 
@@ -3077,33 +3339,33 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 					if (binary_index >= arg_count) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, value_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, value_list[i]);
-						oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+						oph_iostore_release_frag_record(partial_result_set, new_record);
 						return OPH_IO_SERVER_PARSE_ERROR;
 					}
 
 					(*new_record)->field_length[i] = args[binary_index]->arg_length;
-					(*new_record)->field[i] = (void *) memdup(args[binary_index]->arg, (*new_record)->field_length[i]);
+					(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, args[binary_index]->arg, (*new_record)->field_length[i]);
 					break;
 				}
 				//No substitution occurs, use directly strings
 			case OPH_QUERY_FIELD_TYPE_STRING:
 				{
 					(*new_record)->field_length[i] = strlen(value_list[i]) + 1;
-					(*new_record)->field[i] = (char *) strndup(value_list[i], (*new_record)->field_length[i]);
+					(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, value_list[i], (*new_record)->field_length[i]);
 					break;
 				}
 			case OPH_QUERY_FIELD_TYPE_DOUBLE:
 				{
 					tmpD = (double) strtod(value_list[i], NULL);
 					(*new_record)->field_length[i] = sizeof(double);
-					(*new_record)->field[i] = (void *) memdup((const void *) &tmpD, (*new_record)->field_length[i]);
+					(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, &tmpD, (*new_record)->field_length[i]);
 					break;
 				}
 			case OPH_QUERY_FIELD_TYPE_LONG:
 				{
 					tmpL = (long long) strtoll(value_list[i], NULL, 10);
 					(*new_record)->field_length[i] = sizeof(long long);
-					(*new_record)->field[i] = (void *) memdup((const void *) &tmpL, (*new_record)->field_length[i]);
+					(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, &tmpL, (*new_record)->field_length[i]);
 					break;
 				}
 			case OPH_QUERY_FIELD_TYPE_FUNCTION:
@@ -3119,7 +3381,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 					if (oph_query_expr_create_symtable(&table, OPH_QUERY_ENGINE_MAX_PLUGIN_NUMBER)) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
-						oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+						oph_iostore_release_frag_record(partial_result_set, new_record);
 						return OPH_IO_SERVER_EXEC_ERROR;
 					}
 
@@ -3127,7 +3389,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
 						oph_query_expr_destroy_symtable(table);
-						oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+						oph_iostore_release_frag_record(partial_result_set, new_record);
 						return OPH_IO_SERVER_EXEC_ERROR;
 					}
 					//Read all variables and link them to input record set fields
@@ -3135,7 +3397,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
 						oph_query_expr_delete_node(e, table);
-						oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+						oph_iostore_release_frag_record(partial_result_set, new_record);
 						oph_query_expr_destroy_symtable(table);
 						return OPH_IO_SERVER_EXEC_ERROR;
 					}
@@ -3153,7 +3415,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 									oph_query_expr_delete_node(e, table);
 									oph_query_expr_destroy_symtable(table);
 									free(var_list);
-									oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+									oph_iostore_release_frag_record(partial_result_set, new_record);
 									return OPH_IO_SERVER_EXEC_ERROR;
 								}
 							}
@@ -3164,7 +3426,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 								oph_query_expr_delete_node(e, table);
 								oph_query_expr_destroy_symtable(table);
 								free(var_list);
-								oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+								oph_iostore_release_frag_record(partial_result_set, new_record);
 								return OPH_IO_SERVER_PARSE_ERROR;
 							}
 						}
@@ -3175,14 +3437,14 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 							case OPH_QUERY_EXPR_TYPE_DOUBLE:
 								{
 									(*new_record)->field_length[i] = sizeof(double);
-									(*new_record)->field[i] = (void *) memdup((const void *) &(res->data.double_value), sizeof(double));
+									(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, &(res->data.double_value), sizeof(double));
 									free(res);
 									break;
 								}
 							case OPH_QUERY_EXPR_TYPE_LONG:
 								{
 									(*new_record)->field_length[i] = sizeof(unsigned long long);
-									(*new_record)->field[i] = (void *) memdup((const void *) &(res->data.long_value), sizeof(unsigned long long));
+									(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, &(res->data.long_value), sizeof(unsigned long long));
 									free(res);
 									break;
 								}
@@ -3190,9 +3452,14 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 								{
 									(*new_record)->field_length[i] = strlen(res->data.string_value) + 1;
 #ifdef PLUGIN_RES_COPY
-									(*new_record)->field[i] = (void *) res->data.string_value;
+									if (!partial_result_set->arena)
+										(*new_record)->field[i] = (void *) res->data.string_value;
+									else {
+										(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, res->data.string_value, (*new_record)->field_length[i]);
+										free(res->data.string_value);
+									}
 #else
-									(*new_record)->field[i] = (void *) memdup((const void *) res->data.string_value, strlen(res->data.string_value) + 1);
+									(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, res->data.string_value, strlen(res->data.string_value) + 1);
 #endif
 									free(res);
 									break;
@@ -3201,9 +3468,14 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 								{
 									(*new_record)->field_length[i] = res->data.binary_value->arg_length;
 #ifdef PLUGIN_RES_COPY
-									(*new_record)->field[i] = (void *) res->data.binary_value->arg;
+									if (!partial_result_set->arena)
+										(*new_record)->field[i] = (void *) res->data.binary_value->arg;
+									else {
+										(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, res->data.binary_value->arg, (*new_record)->field_length[i]);
+										free(res->data.binary_value->arg);
+									}
 #else
-									(*new_record)->field[i] = (void *) memdup((const void *) res->data.binary_value->arg, res->data.binary_value->arg_length);
+									(*new_record)->field[i] = oph_iostore_alloc_frag_cell(partial_result_set, res->data.binary_value->arg, res->data.binary_value->arg_length);
 #endif
 									free(res->data.binary_value);
 									free(res);
@@ -3216,7 +3488,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 									free(res);
 									oph_query_expr_delete_node(e, table);
 									oph_query_expr_destroy_symtable(table);
-									oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+									oph_iostore_release_frag_record(partial_result_set, new_record);
 									free(var_list);
 									return OPH_IO_SERVER_EXEC_ERROR;
 								}
@@ -3227,7 +3499,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 						oph_query_expr_delete_node(e, table);
 						oph_query_expr_destroy_symtable(table);
 						free(var_list);
-						oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+						oph_iostore_release_frag_record(partial_result_set, new_record);
 						return OPH_IO_SERVER_PARSE_ERROR;
 					}
 
@@ -3241,7 +3513,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 				{
 					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_TYPE_ERROR, value_list[i]);
 					logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_TYPE_ERROR, value_list[i]);
-					oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+					oph_iostore_release_frag_record(partial_result_set, new_record);
 					return OPH_IO_SERVER_PARSE_ERROR;
 				}
 		}
@@ -3250,7 +3522,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 		if ((*new_record)->field[i] == NULL) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			oph_iostore_destroy_frag_record(new_record, partial_result_set->field_num);
+			oph_iostore_release_frag_record(partial_result_set, new_record);
 			return OPH_IO_SERVER_MEMORY_ERROR;
 		}
 	}
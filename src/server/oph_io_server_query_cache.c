@@ -0,0 +1,217 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "oph_io_server_query_manager.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <debug.h>
+
+extern int msglevel;
+
+//Parsed statement: entries are linked both in a bucket of the index and in the LRU list (most recently used first)
+typedef struct _oph_io_server_cached_query {
+	char *query;
+	size_t hash;
+	HASHTBL *query_args;
+	struct _oph_io_server_cached_query *next_bucket;
+	struct _oph_io_server_cached_query *prev;
+	struct _oph_io_server_cached_query *next;
+} _oph_io_server_cached_query;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _oph_io_server_cached_query *cache_index[OPH_IO_SERVER_QUERY_CACHE_BUCKETS];
+static _oph_io_server_cached_query *cache_head = NULL;
+static _oph_io_server_cached_query *cache_tail = NULL;
+static unsigned int cache_num = 0;
+static unsigned int cache_size = OPH_IO_SERVER_QUERY_CACHE_SIZE;
+static unsigned long long cache_hits = 0;
+static unsigned long long cache_misses = 0;
+
+//FNV-1a hash of the query text
+static size_t _oph_io_server_query_hash(const char *query)
+{
+	size_t hash = 2166136261u;
+	while (*query) {
+		hash ^= (unsigned char) *query++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+//Argument values are strings, so a copy can be split in place by the query blocks without affecting the cached table
+static HASHTBL *_oph_io_server_copy_query_args(HASHTBL * query_args)
+{
+	HASHTBL *copy = hashtbl_create(query_args->size, NULL);
+	if (!copy)
+		return NULL;
+
+	size_t n;
+	struct hashnode_s *node = NULL;
+	char *value = NULL;
+	for (n = 0; n < query_args->size; n++) {
+		for (node = query_args->nodes[n]; node; node = node->next) {
+			if (!(value = strdup((char *) node->data)) || hashtbl_insert(copy, node->key, value)) {
+				free(value);
+				hashtbl_destroy(copy);
+				return NULL;
+			}
+		}
+	}
+
+	return copy;
+}
+
+static void _oph_io_server_unlink_cached_query(_oph_io_server_cached_query * entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		cache_head = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		cache_tail = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+static void _oph_io_server_push_cached_query(_oph_io_server_cached_query * entry)
+{
+	entry->next = cache_head;
+	if (cache_head)
+		cache_head->prev = entry;
+	else
+		cache_tail = entry;
+	cache_head = entry;
+}
+
+//Remove an entry from the index and the LRU list and release it (cache_mutex must be held)
+static void _oph_io_server_drop_cached_query(_oph_io_server_cached_query * entry)
+{
+	_oph_io_server_cached_query **ptr = &(cache_index[entry->hash % OPH_IO_SERVER_QUERY_CACHE_BUCKETS]);
+	while (*ptr && *ptr != entry)
+		ptr = &((*ptr)->next_bucket);
+	if (*ptr)
+		*ptr = entry->next_bucket;
+	_oph_io_server_unlink_cached_query(entry);
+
+	hashtbl_destroy(entry->query_args);
+	free(entry->query);
+	free(entry);
+	cache_num--;
+}
+
+void oph_io_server_set_query_cache_size(unsigned int size)
+{
+	pthread_mutex_lock(&cache_mutex);
+	cache_size = size;
+	while (cache_num > cache_size)
+		_oph_io_server_drop_cached_query(cache_tail);
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+int oph_io_server_parse_query(char *query, HASHTBL ** query_args)
+{
+	if (!query || !query_args) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+	*query_args = NULL;
+
+	size_t hash = _oph_io_server_query_hash(query);
+	_oph_io_server_cached_query *entry = NULL;
+
+	pthread_mutex_lock(&cache_mutex);
+	if (cache_size) {
+		for (entry = cache_index[hash % OPH_IO_SERVER_QUERY_CACHE_BUCKETS]; entry; entry = entry->next_bucket)
+			if (entry->hash == hash && !strcmp(entry->query, query))
+				break;
+	}
+	if (entry) {
+		cache_hits++;
+		_oph_io_server_unlink_cached_query(entry);
+		_oph_io_server_push_cached_query(entry);
+		*query_args = _oph_io_server_copy_query_args(entry->query_args);
+		pthread_mutex_unlock(&cache_mutex);
+		if (!*query_args) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+		return OPH_IO_SERVER_SUCCESS;
+	}
+	cache_misses++;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query cache: %llu hits, %llu misses\n", cache_hits, cache_misses);
+	pthread_mutex_unlock(&cache_mutex);
+
+	//The parser modifies the query, so the text used as key is saved first
+	char *key = cache_size ? strdup(query) : NULL;
+
+	if (oph_query_parser(query, query_args)) {
+		free(key);
+		return OPH_IO_SERVER_PARSE_ERROR;
+	}
+	if (!key)
+		return OPH_IO_SERVER_SUCCESS;
+
+	//Failing to cache the statement does not affect the current execution
+	entry = (_oph_io_server_cached_query *) calloc(1, sizeof(_oph_io_server_cached_query));
+	if (!entry || !(entry->query_args = _oph_io_server_copy_query_args(*query_args))) {
+		free(entry);
+		free(key);
+		return OPH_IO_SERVER_SUCCESS;
+	}
+	entry->query = key;
+	entry->hash = hash;
+
+	pthread_mutex_lock(&cache_mutex);
+	_oph_io_server_cached_query *other = NULL;
+	for (other = cache_index[hash % OPH_IO_SERVER_QUERY_CACHE_BUCKETS]; other; other = other->next_bucket)
+		if (other->hash == hash && !strcmp(other->query, key))
+			break;
+	//Another worker may have parsed the same statement in the meantime
+	if (other || !cache_size) {
+		pthread_mutex_unlock(&cache_mutex);
+		hashtbl_destroy(entry->query_args);
+		free(entry->query);
+		free(entry);
+		return OPH_IO_SERVER_SUCCESS;
+	}
+	while (cache_num >= cache_size)
+		_oph_io_server_drop_cached_query(cache_tail);
+	entry->next_bucket = cache_index[hash % OPH_IO_SERVER_QUERY_CACHE_BUCKETS];
+	cache_index[hash % OPH_IO_SERVER_QUERY_CACHE_BUCKETS] = entry;
+	_oph_io_server_push_cached_query(entry);
+	cache_num++;
+	pthread_mutex_unlock(&cache_mutex);
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+void oph_io_server_clear_query_cache()
+{
+	pthread_mutex_lock(&cache_mutex);
+	while (cache_tail)
+		_oph_io_server_drop_cached_query(cache_tail);
+	pthread_mutex_unlock(&cache_mutex);
+}
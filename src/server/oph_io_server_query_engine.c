@@ -43,6 +43,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	oph_iostore_frag_record_set **orig_record_sets = NULL;
 	oph_iostore_frag_record_set **record_sets = NULL;
 	long long row_number = 0;
+	int table_num = 0;
 
 	//First check if other mandatory fields are set
 	char *out_frag_name = NULL;
@@ -80,7 +81,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	}
 
 	if (_oph_ioserver_query_build_input_record_set_create
-	    (query_args, args, meta_db, dev_handle, out_db_name, out_frag_name, current_db, &orig_record_sets, &row_number, &record_sets, file_load_flag)) {
+	    (query_args, args, meta_db, dev_handle, out_db_name, out_frag_name, current_db, &orig_record_sets, &row_number, &record_sets, &table_num, file_load_flag)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_SELECTION_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_SELECTION_ERROR);
 		free(frag_components);
@@ -91,7 +92,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	if (fields == NULL) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		free(frag_components);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
@@ -100,7 +101,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	if (oph_query_parse_multivalue_arg(fields, &field_list, &field_list_num)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_MULTIVAL_PARSE_ERROR, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_MULTIVAL_PARSE_ERROR, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		if (field_list)
 			free(field_list);
 		free(frag_components);
@@ -110,7 +111,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	if (field_list_num != 2) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ROW_CREATE_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ROW_CREATE_ERROR);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		if (field_list)
 			free(field_list);
 		free(frag_components);
@@ -121,7 +122,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	if (_oph_io_server_query_compute_limits(query_args, &offset, &limit)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_LIMIT_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_LIMIT_ERROR);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		if (field_list)
 			free(field_list);
 		free(frag_components);
@@ -129,9 +130,11 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	}
 	//Prepare output record set
 	oph_iostore_frag_record_set *rs = NULL;
-	int i = 0;
 	long long j = 0, total_row_number = 0;
 
+	//Fragments of columnar devices are built directly by columns, unless rows have to be sorted
+	char build_columns = dev_handle->layout == OPH_IOSTORE_COLUMN_LAYOUT && !hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_ORDER);
+
 	//If recordset is not empty proceed
 	if (record_sets[0]->record_set[0] != NULL) {
 		//Count number of rows to compute
@@ -143,12 +146,14 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 			}
 		}
 		//Create output record set
-		if (oph_iostore_create_frag_recordset(&rs, total_row_number, field_list_num)) {
+		if (oph_iostore_create_frag_recordset(&rs, build_columns ? 0 : total_row_number, field_list_num) || (build_columns && oph_iostore_create_frag_columns(rs))) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 			if (field_list)
 				free(field_list);
+			if (rs)
+				oph_iostore_destroy_frag_recordset(&rs);
 			free(frag_components);
 			return OPH_IO_SERVER_MEMORY_ERROR;
 		}
@@ -159,7 +164,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 		if (_oph_ioserver_query_set_column_info(query_args, field_list, field_list_num, rs)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELDS_EXEC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELDS_EXEC_ERROR);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 			if (field_list)
 				free(field_list);
 			if (rs)
@@ -171,7 +176,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 		if (_oph_ioserver_query_build_select_columns(query_args, field_list, field_list_num, offset, total_row_number, args, record_sets, rs)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELDS_EXEC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELDS_EXEC_ERROR);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 			if (field_list)
 				free(field_list);
 			if (rs)
@@ -180,10 +185,10 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 		//Order rows
-		if (_oph_io_server_query_order_output(query_args, rs)) {
+		if (!build_columns && _oph_io_server_query_order_output(query_args, rs)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
-			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 			if (field_list)
 				free(field_list);
 			if (rs)
@@ -194,7 +199,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	} else {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_EMPTY_SELECTION);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_EMPTY_SELECTION);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		if (field_list)
 			free(field_list);
 		if (rs)
@@ -205,22 +210,15 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 	if (field_list)
 		free(field_list);
 
-	_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+	_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 
 	rs->frag_name = strndup(out_frag_name, strlen(out_frag_name));
 	free(frag_components);
 
 	//TODO manage fragment struct creation
 	//Compute size of record_set variable
-	unsigned long long tot_size = sizeof(oph_iostore_frag_record *);
-	j = 0;
-	while (rs->record_set[j]) {
-		tot_size += sizeof(oph_iostore_frag_record *) + sizeof(oph_iostore_frag_record);
-		for (i = 0; i < rs->field_num; i++) {
-			tot_size += rs->record_set[j]->field_length[i] + sizeof(rs->record_set[j]->field_length[i]) + sizeof(rs->record_set[j]->field[i]);
-		}
-		j++;
-	}
+	unsigned long long tot_size = 0;
+	oph_iostore_get_frag_recordset_size(rs, &tot_size);
 	int ret = _oph_ioserver_query_store_fragment(meta_db, dev_handle, current_db, tot_size, &rs);
 
 	//Destroy tmp recordset 
@@ -267,8 +265,9 @@ int oph_io_server_run_select(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 	oph_iostore_frag_record_set **record_sets = NULL;
 	*output_rs = NULL;
 	long long row_number = 0;
+	int table_num = 0;
 
-	if (_oph_ioserver_query_build_input_record_set_select(query_args, args, meta_db, dev_handle, current_db, &orig_record_sets, &row_number, &record_sets)) {
+	if (_oph_ioserver_query_build_input_record_set_select(query_args, args, meta_db, dev_handle, current_db, &orig_record_sets, &row_number, &record_sets, &table_num)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_SELECTION_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_SELECTION_ERROR);
 		return OPH_IO_SERVER_EXEC_ERROR;
@@ -281,13 +280,13 @@ int oph_io_server_run_select(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 	if (fields == NULL) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 	if (oph_query_parse_multivalue_arg(fields, &field_list, &field_list_num) || !field_list_num) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_FIELD);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		if (field_list)
 			free(field_list);
 		return OPH_IO_SERVER_EXEC_ERROR;
@@ -297,7 +296,7 @@ int oph_io_server_run_select(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 	if (_oph_io_server_query_compute_limits(query_args, &offset, &limit)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_LIMIT_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_LIMIT_ERROR);
-		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		if (field_list)
 			free(field_list);
 		return OPH_IO_SERVER_EXEC_ERROR;
@@ -369,7 +368,7 @@ int oph_io_server_run_select(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 		}
 	}
 
-	_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+	_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 	if (field_list)
 		free(field_list);
 
@@ -458,8 +457,20 @@ int oph_io_server_run_insert(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 			free(value_list);
 		return OPH_IO_SERVER_MEMORY_ERROR;
 	}
-	//Add record to partial record set
-	rs->record_set[rs_index] = new_record;
+	//Add record to partial record set: rows of a columnar fragment are appended to its columns
+	if (rs->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+		if (rs_index != rs->row_num || oph_iostore_append_frag_record(rs, &new_record)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ROW_CREATE_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ROW_CREATE_ERROR);
+			oph_iostore_release_frag_record(rs, &new_record);
+			if (field_list)
+				free(field_list);
+			if (value_list)
+				free(value_list);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	} else
+		rs->record_set[rs_index] = new_record;
 	//Update current record size
 	*size = row_size;
 
@@ -531,7 +542,8 @@ int oph_io_server_run_multi_insert(oph_metadb_db_row ** meta_db, oph_iostore_han
 	}
 	unsigned int insert_num = (int) value_list_num / field_list_num;
 
-	if (thread_status->curr_stmt->curr_run == 1 || (thread_status->curr_stmt->curr_run == 0 && thread_status->curr_stmt->tot_run == 0)) {
+	//Columnar fragments have no record_set array: rows are appended to the columns
+	if (tmp->layout != OPH_IOSTORE_COLUMN_LAYOUT && (thread_status->curr_stmt->curr_run == 1 || (thread_status->curr_stmt->curr_run == 0 && thread_status->curr_stmt->tot_run == 0))) {
 		//0- For first time: create record_set array - Also executed when it is a single run
 
 		unsigned long long progressive_mi_rows = 0;
@@ -595,7 +607,19 @@ int oph_io_server_run_multi_insert(oph_metadb_db_row ** meta_db, oph_iostore_han
 			return OPH_IO_SERVER_MEMORY_ERROR;
 		}
 		//Add record to partial record set
-		tmp->record_set[curr_start_row + l] = new_record;
+		if (tmp->layout == OPH_IOSTORE_COLUMN_LAYOUT) {
+			if (curr_start_row + l != tmp->row_num || oph_iostore_append_frag_record(tmp, &new_record)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ROW_CREATE_ERROR);
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ROW_CREATE_ERROR);
+				oph_iostore_release_frag_record(tmp, &new_record);
+				if (field_list)
+					free(field_list);
+				if (value_list)
+					free(value_list);
+				return OPH_IO_SERVER_MEMORY_ERROR;
+			}
+		} else
+			tmp->record_set[curr_start_row + l] = new_record;
 		//Update current record size
 		cumulative_size += row_size;
 
@@ -613,6 +637,86 @@ int oph_io_server_run_multi_insert(oph_metadb_db_row ** meta_db, oph_iostore_han
 	return OPH_IO_SERVER_SUCCESS;
 }
 
+int oph_io_server_run_bulk_insert(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, char *frag_name, unsigned long long row_num,
+				  oph_iostore_frag_column * column, char final_stmt)
+{
+	if (!meta_db || !dev_handle || !thread_status || !frag_name || !column) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+	//Check if current DB is setted
+	if (thread_status->current_db == NULL || thread_status->device == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_NO_DB_SELECTED);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_NO_DB_SELECTED);
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	//Rows are appended to the fragment created by the last create fragment query
+	if (thread_status->curr_stmt == NULL || thread_status->curr_stmt->partial_result_set == NULL || thread_status->curr_stmt->frag == NULL || thread_status->curr_stmt->device == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_INSERT_STATUS_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_INSERT_STATUS_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	char **frag_components = NULL;
+	int frag_components_num = 0;
+	if (oph_query_parse_hierarchical_args(frag_name, &frag_components, &frag_components_num)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_HIERARCHY_PARSE_ERROR, frag_name);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_HIERARCHY_PARSE_ERROR, frag_name);
+		return OPH_IO_SERVER_PARSE_ERROR;
+	}
+	//If DB is setted in frag name
+	if (frag_components_num > 1) {
+		//Check if db is the one used by the query
+		if (STRCMP(thread_status->current_db, frag_components[0]) != 0) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_WRONG_DB_SELECTED);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_WRONG_DB_SELECTED);
+			free(frag_components);
+			return OPH_IO_SERVER_METADB_ERROR;
+		}
+		frag_name = frag_components[1];
+	}
+	//Check if fragment corresponds to the one created previously
+	if (STRCMP(frag_name, thread_status->curr_stmt->frag) != 0 || STRCMP(thread_status->curr_stmt->device, thread_status->device) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_INSERT_STATUS_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_INSERT_STATUS_ERROR);
+		free(frag_components);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	free(frag_components);
+
+	//Columns are owned by the fragment from now on
+	if (oph_iostore_append_frag_columns(thread_status->curr_stmt->partial_result_set, row_num, column)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+
+	if (!final_stmt)
+		return OPH_IO_SERVER_SUCCESS;
+
+	unsigned long long frag_size = 0;
+	int ret = OPH_IO_SERVER_MEMORY_ERROR;
+	if (!oph_iostore_get_frag_recordset_size(thread_status->curr_stmt->partial_result_set, &frag_size))
+		ret = _oph_ioserver_query_store_fragment(meta_db, dev_handle, thread_status->current_db, frag_size, &(thread_status->curr_stmt->partial_result_set));
+
+	//Clean global status
+	if (thread_status->curr_stmt->partial_result_set != NULL)
+		oph_iostore_destroy_frag_recordset(&(thread_status->curr_stmt->partial_result_set));
+	free(thread_status->curr_stmt->device);
+	free(thread_status->curr_stmt->frag);
+	free(thread_status->curr_stmt);
+	thread_status->curr_stmt = NULL;
+
+	if (ret) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_FRAG_STORE_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_FRAG_STORE_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
 #ifdef OPH_IO_SERVER_NETCDF
 int oph_io_server_run_insert_from_file(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, char *current_db, HASHTBL * query_args)
 {
@@ -1005,6 +1109,14 @@ int oph_io_server_run_create_empty_frag(oph_metadb_db_row ** meta_db, oph_iostor
 	if (column_type_list)
 		free(column_type_list);
 
+	//Rows inserted into fragments of columnar devices are appended directly to the columns
+	if (dev_handle->layout == OPH_IOSTORE_COLUMN_LAYOUT && oph_iostore_create_frag_columns(new_record_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_destroy_frag_recordset(&new_record_set);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+
 	*output_rs = new_record_set;
 
 	return OPH_IO_SERVER_SUCCESS;
@@ -1089,14 +1201,13 @@ int oph_io_server_run_drop_frag(oph_metadb_db_row ** meta_db, oph_iostore_handle
 
 	oph_metadb_cleanup_db_struct(tmp_db_row);
 
-	//Call API to delete Frag
-	if (oph_iostore_delete_frag(dev_handle, &(frag_id)) != 0) {
+	//Frag is no longer reachable: its memory is released by the reclaimer
+	if (oph_io_server_reclaim_frags(dev_handle, &(frag_id), 1) != 0) {
 		free(frag_id.id);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_frag");
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_frag");
 		return OPH_IO_SERVER_API_ERROR;
 	}
-	free(frag_id.id);
 
 	return OPH_IO_SERVER_SUCCESS;
 }
@@ -1203,6 +1314,8 @@ int oph_io_server_run_drop_db(oph_metadb_db_row ** meta_db, oph_iostore_handler
 	}
 
 	oph_metadb_db_row *db = NULL;
+	oph_iostore_resource_id *frag_ids = NULL;
+	int frag_num = 0;
 
 	//LOCK FROM HERE
 	if (pthread_rwlock_wrlock(&rwlock) != 0) {
@@ -1230,25 +1343,34 @@ int oph_io_server_run_drop_db(oph_metadb_db_row ** meta_db, oph_iostore_handler
 	if (db->frag_number != 0 || db->table != NULL) {
 		oph_metadb_frag_row *curr_frag, *tmp_frag;
 		int i;
+		for (i = 0; i < db->table->size; i++)
+			for (curr_frag = (oph_metadb_frag_row *) db->table->rows[i]; curr_frag; curr_frag = (oph_metadb_frag_row *) curr_frag->next_frag)
+				frag_num++;
+
+		//Collect Frag IDs so that the reclaimer can delete them once the lock is released
+		frag_ids = (oph_iostore_resource_id *) calloc(frag_num + 1, sizeof(oph_iostore_resource_id));
+		if (frag_ids == NULL) {
+			pthread_rwlock_unlock(&rwlock);
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+		frag_num = 0;
 		for (i = 0; i < db->table->size; i++) {
 			curr_frag = (oph_metadb_frag_row *) db->table->rows[i];
 			while (curr_frag) {
 				tmp_frag = (oph_metadb_frag_row *) curr_frag->next_frag;
 
-				//Call API to delete Frag
-				if (oph_iostore_delete_frag(dev_handle, &(curr_frag->frag_id)) != 0) {
-					pthread_rwlock_unlock(&rwlock);
-					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_frag");
-					logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_frag");
-					return OPH_IO_SERVER_API_ERROR;
-				}
 				//Remove Frag from MetaDB
-				if (oph_metadb_remove_frag(db, curr_frag->frag_name, NULL)) {
+				if (oph_metadb_remove_frag(db, curr_frag->frag_name, &(frag_ids[frag_num]))) {
 					pthread_rwlock_unlock(&rwlock);
+					oph_io_server_reclaim_frags(dev_handle, frag_ids, frag_num);
+					free(frag_ids);
 					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag remove");
 					logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag remove");
 					return OPH_IO_SERVER_METADB_ERROR;
 				}
+				frag_num++;
 
 				curr_frag = tmp_frag;
 			}
@@ -1261,6 +1383,10 @@ int oph_io_server_run_drop_db(oph_metadb_db_row ** meta_db, oph_iostore_handler
 	//Call API to delete DB
 	if (oph_iostore_delete_db(dev_handle, &(db->db_id)) != 0) {
 		pthread_rwlock_unlock(&rwlock);
+		if (frag_ids) {
+			oph_io_server_reclaim_frags(dev_handle, frag_ids, frag_num);
+			free(frag_ids);
+		}
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_db");
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_db");
 		return OPH_IO_SERVER_API_ERROR;
@@ -1268,16 +1394,29 @@ int oph_io_server_run_drop_db(oph_metadb_db_row ** meta_db, oph_iostore_handler
 	//Remove DB from MetaDB
 	if (oph_metadb_remove_db(meta_db, db_name, dev_handle->device)) {
 		pthread_rwlock_unlock(&rwlock);
+		if (frag_ids) {
+			oph_io_server_reclaim_frags(dev_handle, frag_ids, frag_num);
+			free(frag_ids);
+		}
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB remove");
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB remove");
 		return OPH_IO_SERVER_METADB_ERROR;
 	}
 	//UNLOCK FROM HERE
 	if (pthread_rwlock_unlock(&rwlock) != 0) {
+		if (frag_ids) {
+			oph_io_server_reclaim_frags(dev_handle, frag_ids, frag_num);
+			free(frag_ids);
+		}
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
+	//Fragment memory is released by the reclaimer, outside the lock
+	if (frag_ids) {
+		oph_io_server_reclaim_frags(dev_handle, frag_ids, frag_num);
+		free(frag_ids);
+	}
 
 	*deleted_db = db_name;
 
@@ -107,6 +107,11 @@
 #define OPH_IO_SERVER_LOG_BINARY_ARRAY_LOAD					"Error in binary array filling\n"
 #define OPH_IO_SERVER_LOG_INVALID_QUERY_VALUE				"%s argument in query is not valid: %s\n"
 #define OPH_IO_SERVER_LOG_MEMORY_NOT_AVAIL_ERROR			"Unable to create fragment in memory. Memory required is: %lld\n"
+#define OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR				"Error %d while accessing snapshot file %s\n"
+#define OPH_IO_SERVER_LOG_SNAPSHOT_CORRUPTED				"Snapshot file %s is corrupted\n"
+#define OPH_IO_SERVER_LOG_SNAPSHOT_RESTORE_ERROR			"Unable to restore fragment %s from snapshot\n"
+#define OPH_IO_SERVER_LOG_RECLAIMER_ERROR					"Unable to start fragment reclaimer: fragments will be deleted synchronously\n"
+#define OPH_IO_SERVER_LOG_RECLAIMER_STOP_ERROR				"Unable to stop fragment reclaimer\n"
 
 #define OPH_IO_SERVER_BUFFER 1024
 
@@ -116,6 +121,38 @@
 #define OPH_IO_SERVER_PROCEDURE_EXPORT "oph_export"
 #define OPH_IO_SERVER_PROCEDURE_SIZE "oph_size"
 
+//prepared statement cache: default number of statements and buckets of the index
+
+#define OPH_IO_SERVER_QUERY_CACHE_SIZE 512
+#define OPH_IO_SERVER_QUERY_CACHE_BUCKETS 1024
+
+//zone maps: largest magnitude of an integer exactly representable as a double
+
+#define OPH_IO_SERVER_ZONE_MAX_EXACT 9007199254740992LL
+
+//snapshot file
+
+#define OPH_IO_SERVER_SNAPSHOT_MAGIC "OPHSNAP1"
+#define OPH_IO_SERVER_SNAPSHOT_MAGIC_LEN 8
+#define OPH_IO_SERVER_SNAPSHOT_TMP "%s.tmp"
+#define OPH_IO_SERVER_SNAPSHOT_ALIGN 4096
+
+/**
+ * \brief               Header of a snapshot file. It is followed by meta_size bytes describing DBs and fragments; fragment images are stored next, aligned to OPH_IO_SERVER_SNAPSHOT_ALIGN bytes
+ * \param magic         Magic string identifying the file format (OPH_IO_SERVER_SNAPSHOT_MAGIC)
+ * \param db_num        Number of DBs in the snapshot
+ * \param frag_num      Number of fragments in the snapshot
+ * \param meta_size     Length of the description of DBs and fragments
+ * \param file_size     Total length of the file
+ */
+typedef struct {
+	char magic[OPH_IO_SERVER_SNAPSHOT_MAGIC_LEN];
+	unsigned long long db_num;
+	unsigned long long frag_num;
+	unsigned long long meta_size;
+	unsigned long long file_size;
+} oph_io_server_snapshot_header;
+
 //Server Main manager function
 /**
  * \brief               Function used to dispatch query and execute the correct operation
@@ -186,13 +223,14 @@ int _oph_io_server_query_compute_limits(HASHTBL * query_args, long long *offset,
 int _oph_io_server_query_order_output(HASHTBL * query_args, oph_iostore_frag_record_set * rs);
 
 /**
- * \brief               Internal function used to release memory for input record sets of a query (FROM and WHERE blocks). Used in case of select and create as select. 
+ * \brief               Internal function used to release memory for input record sets of a query (FROM and WHERE blocks). Used in case of select and create as select; the thread is also allowed to run on any NUMA node again. 
  * \param dev_handle 		Handler to current IO server device
- * \param stored_rs    	Pointer to be freed with list of original stored recordsets (null terminated list)
- * \param input_rs 		Pointer to be freed with list of filtered recordsets (null terminated list)
+ * \param stored_rs    	Pointer to be freed with list of original stored recordsets (some entries may be NULL)
+ * \param input_rs 		Pointer to be freed with list of filtered recordsets (some entries may be NULL)
+ * \param table_num 		Number of entries of both lists
  * \return              0 if successfull, non-0 otherwise
  */
-int _oph_ioserver_query_release_input_record_set(oph_iostore_handler * dev_handle, oph_iostore_frag_record_set ** stored_rs, oph_iostore_frag_record_set ** input_rs);
+int _oph_ioserver_query_release_input_record_set(oph_iostore_handler * dev_handle, oph_iostore_frag_record_set ** stored_rs, oph_iostore_frag_record_set ** input_rs, int table_num);
 
 /**
  * \brief               Internal function used to select and filter input record set of a query (FROM and WHERE blocks). Used in case of create as select. 
@@ -206,12 +244,13 @@ int _oph_ioserver_query_release_input_record_set(oph_iostore_handler * dev_handl
  * \param stored_rs    	Pointer to be filled with list of original stored recordsets (null terminated list)
  * \param input_row_num Arg to be filled with total number of rows in filtered recordset 
  * \param input_rs 		Pointer to be filled with list of filtered recordset (null terminated list)
+ * \param input_table_num Arg to be filled with the number of tables (entries of stored_rs and input_rs)
  * \param file_load_flag Flag set to 1 if query contains also data loading from file 
  * \return              0 if successfull, non-0 otherwise
  */
 int _oph_ioserver_query_build_input_record_set_create(HASHTBL * query_args, oph_query_arg ** args, oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, char *out_db_name,
 						      char *out_frag_name, char *current_db, oph_iostore_frag_record_set *** stored_rs, long long *input_row_num,
-						      oph_iostore_frag_record_set *** input_rs, char file_load_flag);
+						      oph_iostore_frag_record_set *** input_rs, int *input_table_num, char file_load_flag);
 
 /**
  * \brief               Internal function used to select and filter input record set of a query (FROM and WHERE blocks). Used in case of select. 
@@ -223,10 +262,11 @@ int _oph_ioserver_query_build_input_record_set_create(HASHTBL * query_args, oph_
  * \param stored_rs    	Pointer to be filled with list of original stored recordsets (null terminated list)
  * \param input_row_num Arg to be filled with total number of rows in filtered recordset
  * \param input_rs 		Pointer to be filled with list of filtered recordset (null terminated list)
+ * \param input_table_num Arg to be filled with the number of tables (entries of stored_rs and input_rs)
  * \return              0 if successfull, non-0 otherwise
  */
 int _oph_ioserver_query_build_input_record_set_select(HASHTBL * query_args, oph_query_arg ** args, oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, char *current_db,
-						      oph_iostore_frag_record_set *** stored_rs, long long *input_row_num, oph_iostore_frag_record_set *** input_rs);
+						      oph_iostore_frag_record_set *** stored_rs, long long *input_row_num, oph_iostore_frag_record_set *** input_rs, int *input_table_num);
 
 #ifdef OPH_IO_SERVER_NETCDF
 /**
@@ -445,6 +485,20 @@ int oph_io_server_run_insert(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 int oph_io_server_run_multi_insert(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args,
 				   unsigned int *num_insert, unsigned long long *size);
 
+/**
+ * \brief               Internal function used to append a batch of rows, received as columns, to the fragment being created
+ * \param meta_db       Pointer to metadb
+ * \param dev_handle 	Handler to current IO server device
+ * \param thread_status	Pointer to thread structure
+ * \param frag_name 	Name of the fragment (it must be the one of the running statement)
+ * \param row_num 		Number of rows in the batch
+ * \param column 		Array of columns of the batch (allocated as required by oph_iostore_append_frag_columns); entries are reset once owned by the fragment
+ * \param final_stmt 	Flag set to 1 if the batch is the last one: the fragment is then stored
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_run_bulk_insert(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, char *frag_name, unsigned long long row_num,
+				  oph_iostore_frag_column * column, char final_stmt);
+
 #ifdef OPH_IO_SERVER_NETCDF
 /**
  * \brief               Internal function used for creating data structures from NetCDF file 
@@ -553,4 +607,72 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
  */
 int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args);
 
+//Snapshot functions
+
+/**
+ * \brief               Function used to write the fragments stored on transient devices, along with their MetaDB records, to a snapshot file.
+ *                      Fragments are retained while the MetaDB is locked, then written without holding the lock; the file is replaced atomically.
+ * \param meta_db       Pointer to metadb
+ * \param snapshot_file Path of the snapshot file
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_save_snapshot(oph_metadb_db_row ** meta_db, const char *snapshot_file);
+
+/**
+ * \brief               Function used at startup to restore DBs and fragments from a snapshot file (if it exists).
+ *                      Fragment images are mapped in memory and used in place; they are loaded by several threads in parallel.
+ * \param meta_db       Pointer to metadb
+ * \param snapshot_file Path of the snapshot file
+ * \param thread_num    Number of threads used to restore fragments
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_load_snapshot(oph_metadb_db_row ** meta_db, const char *snapshot_file, unsigned short thread_num);
+
+//Reclaimer functions
+
+/**
+ * \brief               Function used to start the thread that deletes dropped fragments in background.
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_start_reclaimer();
+
+/**
+ * \brief               Function used to hand dropped fragments to the reclaimer; they must already be removed from the MetaDB.
+ *                      The reclaimer takes ownership of the ID buffers (not of the array) and deletes the whole batch with a single device call without holding the MetaDB lock.
+ *                      Fragments are deleted immediately if the reclaimer is not running.
+ * \param dev_handle    Handler of the device storing the fragments
+ * \param frag_ids      Array of fragment IDs to be deleted
+ * \param frag_num      Number of fragment IDs
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_reclaim_frags(oph_iostore_handler * dev_handle, oph_iostore_resource_id * frag_ids, int frag_num);
+
+/**
+ * \brief               Function used to stop the reclaimer after deleting every pending fragment. It has to be called before unloading devices.
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_stop_reclaimer();
+
+//Prepared statement cache functions
+
+/**
+ * \brief               Function used to parse a query string into its argument table. Tables of the most recently used statements are kept
+ *                      in a LRU cache keyed by the query text, so repeated statements are not parsed again; each call gets its own copy of the table.
+ * \param query         Query string (it is modified if the query has to be parsed)
+ * \param query_args    Hash table containing args to be created
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_parse_query(char *query, HASHTBL ** query_args);
+
+/**
+ * \brief               Function used to set the max number of statements kept in the cache (0 disables the cache)
+ * \param size          Max number of statements
+ */
+void oph_io_server_set_query_cache_size(unsigned int size);
+
+/**
+ * \brief               Function used to release every statement kept in the cache
+ */
+void oph_io_server_clear_query_cache();
+
 #endif				/* OPH_IO_SERVER_QUERY_MANAGER_H */
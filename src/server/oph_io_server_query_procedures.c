@@ -275,8 +275,9 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
 	oph_iostore_frag_record_set **orig_record_sets = NULL;
 	oph_iostore_frag_record_set **record_sets = NULL;
 	long long row_number = 0;
+	int table_num = 0;
 
-	if (_oph_ioserver_query_build_input_record_set_select(query_args, args, meta_db, dev_handle, thread_status->current_db, &orig_record_sets, &row_number, &record_sets)) {
+	if (_oph_ioserver_query_build_input_record_set_select(query_args, args, meta_db, dev_handle, thread_status->current_db, &orig_record_sets, &row_number, &record_sets, &table_num)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_SELECTION_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_SELECTION_ERROR);
 		return OPH_IO_SERVER_EXEC_ERROR;
@@ -289,7 +290,7 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
 	if (rs->record_set[0] != NULL) {
 
 		//Check number of tables
-		if (record_sets[1] != NULL) {
+		if (table_num > 1) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_TOO_MANY_TABLES);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_TOO_MANY_TABLES);
 			error = OPH_IO_SERVER_EXEC_ERROR;
@@ -307,15 +308,15 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
 		error = OPH_IO_SERVER_EXEC_ERROR;
 	}
 
-	if (dev_handle->is_persistent)
-		oph_iostore_destroy_frag_recordset(&(orig_record_sets[0]));
-	free(orig_record_sets);
-
+	//Output rows belong to the stored fragment: keep it alive until they are sent
+	if (!error && oph_iostore_share_frag_recordset(rs, orig_record_sets[0]))
+		error = OPH_IO_SERVER_MEMORY_ERROR;
 	if (error) {
-		oph_iostore_destroy_frag_recordset_only(&(record_sets[0]));
-		free(record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets, table_num);
 		return error;
 	}
+	oph_iostore_destroy_frag_recordset(&(orig_record_sets[0]));
+	free(orig_record_sets);
 
 	thread_status->last_result_set = rs;
 	thread_status->delete_only_rs = 1;
@@ -462,7 +463,7 @@ int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_h
 	}
 	//Created record struct
 	oph_iostore_frag_record *new_record = NULL;
-	if (oph_iostore_create_frag_record(&new_record, 1) == 1) {
+	if (oph_iostore_alloc_frag_record(rs, &new_record)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		oph_iostore_destroy_frag_recordset(&rs);
@@ -473,7 +474,7 @@ int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_h
 
 	//Fill record
 	new_record->field_length[0] = sizeof(long long);
-	new_record->field[0] = (void *) memdup((const void *) &tot_frag_size, new_record->field_length[0]);
+	new_record->field[0] = oph_iostore_alloc_frag_cell(rs, &tot_frag_size, new_record->field_length[0]);
 	if (new_record->field[0] == NULL) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
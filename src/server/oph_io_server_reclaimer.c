@@ -0,0 +1,190 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "oph_io_server_query_manager.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <debug.h>
+
+extern int msglevel;
+
+//Fragments dropped by a single statement, waiting to be deleted
+typedef struct _oph_io_server_reclaim_job {
+	oph_iostore_handler *dev_handle;
+	oph_iostore_resource_id **frag_ids;
+	int frag_num;
+	struct _oph_io_server_reclaim_job *next;
+} _oph_io_server_reclaim_job;
+
+static pthread_mutex_t reclaim_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reclaim_cond = PTHREAD_COND_INITIALIZER;
+static _oph_io_server_reclaim_job *reclaim_head = NULL;
+static _oph_io_server_reclaim_job *reclaim_tail = NULL;
+static pthread_t reclaim_tid;
+static char reclaim_running = 0;
+static char reclaim_stop = 0;
+
+static void _oph_io_server_reclaim_delete(oph_iostore_handler * dev_handle, oph_iostore_resource_id ** frag_ids, int frag_num)
+{
+	int i;
+
+	if (oph_iostore_delete_frags(dev_handle, frag_ids, frag_num) != 0) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_frags");
+		logging(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "delete_frags");
+	}
+	for (i = 0; i < frag_num; i++) {
+		free(frag_ids[i]->id);
+		frag_ids[i]->id = NULL;
+	}
+}
+
+//Delete queued batches one at a time, so that each job only briefly holds the queue
+static void *_oph_io_server_reclaimer(void *arg)
+{
+	(void) arg;
+	_oph_io_server_reclaim_job *job = NULL;
+
+	for (;;) {
+		pthread_mutex_lock(&reclaim_mutex);
+		while (!reclaim_head && !reclaim_stop)
+			pthread_cond_wait(&reclaim_cond, &reclaim_mutex);
+		job = reclaim_head;
+		if (job) {
+			reclaim_head = job->next;
+			if (!reclaim_head)
+				reclaim_tail = NULL;
+		}
+		pthread_mutex_unlock(&reclaim_mutex);
+
+		//Queue is drained and stop has been requested
+		if (!job)
+			break;
+
+		_oph_io_server_reclaim_delete(job->dev_handle, job->frag_ids, job->frag_num);
+		free(job);
+	}
+
+	return (NULL);
+}
+
+int oph_io_server_start_reclaimer()
+{
+	pthread_mutex_lock(&reclaim_mutex);
+	if (reclaim_running) {
+		pthread_mutex_unlock(&reclaim_mutex);
+		return OPH_IO_SERVER_SUCCESS;
+	}
+	reclaim_stop = 0;
+	if (pthread_create(&reclaim_tid, NULL, &_oph_io_server_reclaimer, NULL) != 0) {
+		pthread_mutex_unlock(&reclaim_mutex);
+		pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_RECLAIMER_ERROR);
+		logging(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_RECLAIMER_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	reclaim_running = 1;
+	pthread_mutex_unlock(&reclaim_mutex);
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int oph_io_server_reclaim_frags(oph_iostore_handler * dev_handle, oph_iostore_resource_id * frag_ids, int frag_num)
+{
+	if (!dev_handle || (!frag_ids && frag_num > 0)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	int i, n = 0;
+	for (i = 0; i < frag_num; i++)
+		if (frag_ids[i].id)
+			n++;
+	if (!n)
+		return OPH_IO_SERVER_SUCCESS;
+
+	//A single job holds the IDs of the whole batch, built before taking the queue lock
+	_oph_io_server_reclaim_job *job = (_oph_io_server_reclaim_job *) malloc(sizeof(_oph_io_server_reclaim_job) + n * (sizeof(oph_iostore_resource_id *) + sizeof(oph_iostore_resource_id)));
+	if (!job) {
+		//Fall back to synchronous deletion, one fragment at a time
+		pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_resource_id *frag_id = NULL;
+		for (i = 0; i < frag_num; i++)
+			if ((frag_id = frag_ids + i)->id)
+				_oph_io_server_reclaim_delete(dev_handle, &frag_id, 1);
+		return OPH_IO_SERVER_SUCCESS;
+	}
+	oph_iostore_resource_id *ids = (oph_iostore_resource_id *) ((char *) job + sizeof(_oph_io_server_reclaim_job) + n * sizeof(oph_iostore_resource_id *));
+	job->dev_handle = dev_handle;
+	job->frag_ids = (oph_iostore_resource_id **) (job + 1);
+	job->frag_num = n;
+	job->next = NULL;
+	for (i = 0, n = 0; i < frag_num; i++) {
+		if (!frag_ids[i].id)
+			continue;
+		ids[n] = frag_ids[i];
+		job->frag_ids[n] = ids + n;
+		frag_ids[i].id = NULL;
+		n++;
+	}
+
+	pthread_mutex_lock(&reclaim_mutex);
+	if (!reclaim_running) {
+		pthread_mutex_unlock(&reclaim_mutex);
+		_oph_io_server_reclaim_delete(job->dev_handle, job->frag_ids, job->frag_num);
+		free(job);
+		return OPH_IO_SERVER_SUCCESS;
+	}
+	if (reclaim_tail)
+		reclaim_tail->next = job;
+	else
+		reclaim_head = job;
+	reclaim_tail = job;
+	pthread_cond_signal(&reclaim_cond);
+	pthread_mutex_unlock(&reclaim_mutex);
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int oph_io_server_stop_reclaimer()
+{
+	pthread_mutex_lock(&reclaim_mutex);
+	if (!reclaim_running) {
+		pthread_mutex_unlock(&reclaim_mutex);
+		return OPH_IO_SERVER_SUCCESS;
+	}
+	//Fragments dropped from now on are deleted synchronously
+	reclaim_running = 0;
+	reclaim_stop = 1;
+	pthread_cond_signal(&reclaim_cond);
+	pthread_mutex_unlock(&reclaim_mutex);
+
+	//Pending fragments are deleted before the thread exits
+	if (pthread_join(reclaim_tid, NULL) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_RECLAIMER_STOP_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_RECLAIMER_STOP_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
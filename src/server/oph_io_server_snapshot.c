@@ -0,0 +1,739 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2022 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "oph_io_server_query_manager.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <debug.h>
+
+#include "oph_server_utility.h"
+
+extern int msglevel;
+extern pthread_rwlock_t rwlock;
+
+//DB described in a snapshot
+typedef struct {
+	char *db_name;
+	char *device;
+	unsigned long long frag_number;
+	oph_iostore_handler *dev_handle;
+	oph_metadb_db_row *db_row;
+	unsigned long long restored;
+} _oph_io_server_snapshot_db;
+
+//Fragment described in a snapshot
+typedef struct {
+	unsigned long long db_index;
+	char *frag_name;
+	unsigned long long frag_size;
+	unsigned long long image_offset;
+	unsigned long long image_size;
+	char saved;
+} _oph_io_server_snapshot_frag;
+
+//Status shared by the threads restoring a snapshot
+typedef struct {
+	int fd;
+	const char *snapshot_file;
+	_oph_io_server_snapshot_db *db;
+	_oph_io_server_snapshot_frag *frag;
+	unsigned long long frag_num;
+	unsigned long long next_frag;
+	int error;
+	pthread_mutex_t mutex;
+} _oph_io_server_snapshot_status;
+
+static char *_oph_io_server_snapshot_write_value(char *ptr, unsigned long long value)
+{
+	memcpy(ptr, &value, sizeof(unsigned long long));
+	return ptr + sizeof(unsigned long long);
+}
+
+static char *_oph_io_server_snapshot_write_string(char *ptr, const char *str)
+{
+	unsigned long long length = strlen(str) + 1;
+	ptr = _oph_io_server_snapshot_write_value(ptr, length);
+	memcpy(ptr, str, length);
+	return ptr + length;
+}
+
+static int _oph_io_server_snapshot_read_value(const char *meta, unsigned long long meta_size, unsigned long long *pos, unsigned long long *value)
+{
+	if (meta_size - *pos < sizeof(unsigned long long))
+		return OPH_IO_SERVER_ERROR;
+	memcpy(value, meta + *pos, sizeof(unsigned long long));
+	*pos += sizeof(unsigned long long);
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+static int _oph_io_server_snapshot_read_string(const char *meta, unsigned long long meta_size, unsigned long long *pos, char **str)
+{
+	unsigned long long length = 0;
+	if (_oph_io_server_snapshot_read_value(meta, meta_size, pos, &length) || !length || length > meta_size - *pos || meta[*pos + length - 1])
+		return OPH_IO_SERVER_ERROR;
+	*str = (char *) strndup(meta + *pos, length - 1);
+	if (*str == NULL)
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	*pos += length;
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+//Open device handles, sharing them among DBs stored on the same device
+static int _oph_io_server_snapshot_setup_devices(_oph_io_server_snapshot_db * db, unsigned long long db_num)
+{
+	unsigned long long i = 0, j = 0;
+	for (i = 0; i < db_num; i++) {
+		for (j = 0; j < i; j++) {
+			if (db[j].dev_handle && !strcasecmp(db[j].device, db[i].device)) {
+				db[i].dev_handle = db[j].dev_handle;
+				break;
+			}
+		}
+		if (db[i].dev_handle == NULL && oph_iostore_setup(db[i].device, &(db[i].dev_handle))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "setup");
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "setup");
+			db[i].dev_handle = NULL;
+			return OPH_IO_SERVER_API_ERROR;
+		}
+	}
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+static void _oph_io_server_snapshot_free(_oph_io_server_snapshot_db * db, unsigned long long db_num, _oph_io_server_snapshot_frag * frag, unsigned long long frag_num)
+{
+	unsigned long long i = 0, j = 0;
+	if (frag) {
+		for (i = 0; i < frag_num; i++)
+			free(frag[i].frag_name);
+		free(frag);
+	}
+	if (db) {
+		for (i = 0; i < db_num; i++) {
+			if (db[i].dev_handle) {
+				for (j = 0; j < i; j++)
+					if (db[j].dev_handle == db[i].dev_handle)
+						break;
+				if (j == i)
+					oph_iostore_cleanup(db[i].dev_handle);
+			}
+			free(db[i].db_name);
+			free(db[i].device);
+		}
+		free(db);
+	}
+}
+
+//List the fragments of transient DBs while MetaDB is locked; fragments are retrieved later, one at a time
+static int _oph_io_server_snapshot_collect(oph_metadb_db_row * meta_db, _oph_io_server_snapshot_db ** db, unsigned long long *db_num, _oph_io_server_snapshot_frag ** frag, unsigned long long *frag_num)
+{
+	oph_metadb_db_row *db_row = NULL;
+	oph_metadb_frag_row *frag_row = NULL;
+	unsigned long long i = 0, j = 0;
+	int k = 0;
+
+	for (db_row = meta_db; db_row; db_row = db_row->next_db) {
+		if (db_row->is_persistent)
+			continue;
+		(*db_num)++;
+		for (k = 0; k < db_row->table->size; k++)
+			for (frag_row = db_row->table->rows[k]; frag_row; frag_row = frag_row->next_frag)
+				(*frag_num)++;
+	}
+
+	if (!*db_num)
+		return OPH_IO_SERVER_SUCCESS;
+
+	*db = (_oph_io_server_snapshot_db *) calloc(*db_num, sizeof(_oph_io_server_snapshot_db));
+	*frag = (_oph_io_server_snapshot_frag *) calloc(*frag_num ? *frag_num : 1, sizeof(_oph_io_server_snapshot_frag));
+	if (*db == NULL || *frag == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+
+	for (db_row = meta_db; db_row; db_row = db_row->next_db) {
+		if (db_row->is_persistent)
+			continue;
+		(*db)[i].db_name = (char *) strdup(db_row->db_name);
+		(*db)[i].device = (char *) strdup(db_row->device);
+		if ((*db)[i].db_name == NULL || (*db)[i].device == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+		(*db)[i].frag_number = db_row->frag_number;
+		if (_oph_io_server_snapshot_setup_devices(*db, i + 1))
+			return OPH_IO_SERVER_API_ERROR;
+
+		for (k = 0; k < db_row->table->size; k++) {
+			for (frag_row = db_row->table->rows[k]; frag_row; frag_row = frag_row->next_frag, j++) {
+				(*frag)[j].db_index = i;
+				(*frag)[j].frag_size = frag_row->frag_size;
+				(*frag)[j].frag_name = (char *) strdup(frag_row->frag_name);
+				if ((*frag)[j].frag_name == NULL) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+					logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+					return OPH_IO_SERVER_MEMORY_ERROR;
+				}
+			}
+		}
+		i++;
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+//Retrieve a fragment while MetaDB is locked; record_set is left NULL if the fragment has been deleted in the meantime
+static int _oph_io_server_snapshot_get_frag(oph_metadb_db_row ** meta_db, _oph_io_server_snapshot_db * db, _oph_io_server_snapshot_frag * frag, oph_iostore_frag_record_set ** record_set)
+{
+	oph_metadb_db_row *db_row = NULL;
+	oph_metadb_frag_row *frag_row = NULL;
+	int res = OPH_IO_SERVER_SUCCESS;
+
+	*record_set = NULL;
+
+	//LOCK FROM HERE
+	if (pthread_rwlock_rdlock(&rwlock) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	if (*meta_db && !oph_metadb_find_db(*meta_db, db->db_name, db->device, &db_row) && db_row && !oph_metadb_find_frag(db_row, frag->frag_name, &frag_row) && frag_row) {
+		//Transient devices return a reference to the fragment: it is kept alive until it is written
+		if (oph_iostore_get_frag(db->dev_handle, &(frag_row->frag_id), record_set) || *record_set == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag");
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag");
+			*record_set = NULL;
+			res = OPH_IO_SERVER_API_ERROR;
+		} else
+			frag->frag_size = frag_row->frag_size;
+	}
+
+	//UNLOCK FROM HERE
+	if (pthread_rwlock_unlock(&rwlock) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
+		if (*record_set)
+			oph_iostore_destroy_frag_recordset(record_set);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	return res;
+}
+
+//Append the image of a fragment to the snapshot file, mapping only the region it is written to
+static int _oph_io_server_snapshot_write_frag(int fd, oph_iostore_frag_record_set * record_set, _oph_io_server_snapshot_frag * frag, unsigned long long *file_size, long page_size)
+{
+	if (oph_iostore_get_frag_image_size(record_set, &(frag->image_size))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag_image_size");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag_image_size");
+		return OPH_IO_SERVER_API_ERROR;
+	}
+	frag->image_offset = (*file_size + OPH_IO_SERVER_SNAPSHOT_ALIGN - 1) / OPH_IO_SERVER_SNAPSHOT_ALIGN * OPH_IO_SERVER_SNAPSHOT_ALIGN;
+	if (ftruncate(fd, frag->image_offset + frag->image_size))
+		return OPH_IO_SERVER_ERROR;
+
+	unsigned long long delta = frag->image_offset % page_size;
+	size_t map_size = delta + frag->image_size;
+	char *map = (char *) mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, frag->image_offset - delta);
+	if (map == MAP_FAILED)
+		return OPH_IO_SERVER_ERROR;
+
+	int res = oph_iostore_write_frag_image(record_set, map + delta, frag->image_size);
+	munmap(map, map_size);
+	if (res) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "write_frag_image");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "write_frag_image");
+		return OPH_IO_SERVER_API_ERROR;
+	}
+
+	*file_size = frag->image_offset + frag->image_size;
+	frag->saved = 1;
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int oph_io_server_save_snapshot(oph_metadb_db_row ** meta_db, const char *snapshot_file)
+{
+	if (!meta_db || !snapshot_file) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	_oph_io_server_snapshot_db *db = NULL;
+	_oph_io_server_snapshot_frag *frag = NULL;
+	unsigned long long db_num = 0, frag_num = 0, i = 0;
+
+	//LOCK FROM HERE
+	if (pthread_rwlock_rdlock(&rwlock) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	int res = _oph_io_server_snapshot_collect(*meta_db, &db, &db_num, &frag, &frag_num);
+
+	//UNLOCK FROM HERE
+	if (pthread_rwlock_unlock(&rwlock) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
+		_oph_io_server_snapshot_free(db, db_num, frag, frag_num);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	if (res) {
+		_oph_io_server_snapshot_free(db, db_num, frag, frag_num);
+		return res;
+	}
+
+	//File layout: header, description of DBs and fragments, images. Room is reserved for the description of every listed fragment
+	unsigned long long meta_size = 0;
+	for (i = 0; i < db_num; i++)
+		meta_size += 3 * sizeof(unsigned long long) + strlen(db[i].db_name) + 1 + strlen(db[i].device) + 1;
+	for (i = 0; i < frag_num; i++)
+		meta_size += 5 * sizeof(unsigned long long) + strlen(frag[i].frag_name) + 1;
+	unsigned long long file_size = sizeof(oph_io_server_snapshot_header) + meta_size;
+
+	//Write a temporary file and replace the previous snapshot only when it is complete
+	size_t tmp_len = strlen(snapshot_file) + strlen(OPH_IO_SERVER_SNAPSHOT_TMP);
+	char tmp_file[tmp_len];
+	snprintf(tmp_file, tmp_len, OPH_IO_SERVER_SNAPSHOT_TMP, snapshot_file);
+
+	int fd = open(tmp_file, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0 || ftruncate(fd, file_size)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, tmp_file);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, tmp_file);
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmp_file);
+		}
+		_oph_io_server_snapshot_free(db, db_num, frag, frag_num);
+		return OPH_IO_SERVER_ERROR;
+	}
+
+	//Only one fragment at a time is retained (and made resident, if it has been spilled) while its image is written
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned long long saved_num = 0;
+	oph_iostore_frag_record_set *record_set = NULL;
+	for (i = 0; i < frag_num; i++) {
+		if ((res = _oph_io_server_snapshot_get_frag(meta_db, &(db[frag[i].db_index]), &(frag[i]), &record_set)))
+			break;
+		//Fragments deleted after the list was built are not saved
+		if (record_set == NULL)
+			continue;
+		res = _oph_io_server_snapshot_write_frag(fd, record_set, &(frag[i]), &file_size, page_size);
+		oph_iostore_destroy_frag_recordset(&record_set);
+		if (res) {
+			if (res == OPH_IO_SERVER_ERROR) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, tmp_file);
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, tmp_file);
+			}
+			break;
+		}
+		saved_num++;
+	}
+	if (res) {
+		close(fd);
+		unlink(tmp_file);
+		_oph_io_server_snapshot_free(db, db_num, frag, frag_num);
+		return res;
+	}
+
+	//Describe the fragments actually saved; DBs whose fragments have all been deleted meanwhile are left out
+	unsigned long long listed[db_num ? db_num : 1], saved[db_num ? db_num : 1], file_index[db_num ? db_num : 1], saved_db_num = 0;
+	memset(listed, 0, sizeof(listed));
+	memset(saved, 0, sizeof(saved));
+	for (i = 0; i < frag_num; i++) {
+		listed[frag[i].db_index]++;
+		if (frag[i].saved)
+			saved[frag[i].db_index]++;
+		else
+			meta_size -= 5 * sizeof(unsigned long long) + strlen(frag[i].frag_name) + 1;
+	}
+	for (i = 0; i < db_num; i++) {
+		if (listed[i] && !saved[i]) {
+			meta_size -= 3 * sizeof(unsigned long long) + strlen(db[i].db_name) + 1 + strlen(db[i].device) + 1;
+			continue;
+		}
+		file_index[i] = saved_db_num++;
+	}
+
+	size_t head_size = sizeof(oph_io_server_snapshot_header) + meta_size;
+	char *map = (char *) mmap(NULL, head_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, tmp_file);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, tmp_file);
+		close(fd);
+		unlink(tmp_file);
+		_oph_io_server_snapshot_free(db, db_num, frag, frag_num);
+		return OPH_IO_SERVER_ERROR;
+	}
+
+	oph_io_server_snapshot_header *header = (oph_io_server_snapshot_header *) map;
+	memcpy(header->magic, OPH_IO_SERVER_SNAPSHOT_MAGIC, OPH_IO_SERVER_SNAPSHOT_MAGIC_LEN);
+	header->db_num = saved_db_num;
+	header->frag_num = saved_num;
+	header->meta_size = meta_size;
+	header->file_size = file_size;
+
+	char *ptr = map + sizeof(oph_io_server_snapshot_header);
+	for (i = 0; i < db_num; i++) {
+		if (listed[i] && !saved[i])
+			continue;
+		ptr = _oph_io_server_snapshot_write_string(ptr, db[i].db_name);
+		ptr = _oph_io_server_snapshot_write_string(ptr, db[i].device);
+		ptr = _oph_io_server_snapshot_write_value(ptr, db[i].frag_number);
+	}
+	for (i = 0; i < frag_num; i++) {
+		if (!frag[i].saved)
+			continue;
+		ptr = _oph_io_server_snapshot_write_value(ptr, file_index[frag[i].db_index]);
+		ptr = _oph_io_server_snapshot_write_string(ptr, frag[i].frag_name);
+		ptr = _oph_io_server_snapshot_write_value(ptr, frag[i].frag_size);
+		ptr = _oph_io_server_snapshot_write_value(ptr, frag[i].image_offset);
+		ptr = _oph_io_server_snapshot_write_value(ptr, frag[i].image_size);
+	}
+	munmap(map, head_size);
+
+	res = fsync(fd);
+	close(fd);
+	if (res || rename(tmp_file, snapshot_file)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, snapshot_file);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, snapshot_file);
+		unlink(tmp_file);
+		_oph_io_server_snapshot_free(db, db_num, frag, frag_num);
+		return OPH_IO_SERVER_ERROR;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Snapshot of %llu fragments written to %s\n", saved_num, snapshot_file);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Snapshot of %llu fragments written to %s\n", saved_num, snapshot_file);
+
+	_oph_io_server_snapshot_free(db, db_num, frag, frag_num);
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+static int _oph_io_server_snapshot_restore_frag(_oph_io_server_snapshot_status * status, unsigned long long index, long page_size)
+{
+	_oph_io_server_snapshot_frag *frag = &(status->frag[index]);
+	_oph_io_server_snapshot_db *db = &(status->db[frag->db_index]);
+	if (db->dev_handle == NULL || db->db_row == NULL)
+		return OPH_IO_SERVER_METADB_ERROR;
+
+	//Map only the image of the fragment, so that it is released along with the fragment
+	unsigned long long delta = frag->image_offset % page_size;
+	size_t map_size = delta + frag->image_size;
+	char *map = (char *) mmap(NULL, map_size, PROT_READ, MAP_SHARED, status->fd, frag->image_offset - delta);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, status->snapshot_file);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, status->snapshot_file);
+		return OPH_IO_SERVER_ERROR;
+	}
+	madvise(map, map_size, MADV_WILLNEED);
+
+	oph_iostore_frag_record_set *record_set = NULL;
+	if (oph_iostore_map_frag_image(map + delta, frag->image_size, map, map_size, &record_set)) {
+		munmap(map, map_size);
+		return OPH_IO_SERVER_API_ERROR;
+	}
+
+	pthread_mutex_lock(&(status->mutex));
+
+	oph_iostore_resource_id *frag_id = NULL;
+	if (oph_iostore_put_frag(db->dev_handle, record_set, &frag_id) != 0) {
+		pthread_mutex_unlock(&(status->mutex));
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "put_frag");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "put_frag");
+		oph_iostore_destroy_frag_recordset(&record_set);
+		return OPH_IO_SERVER_API_ERROR;
+	}
+	if (db->dev_handle->is_persistent)
+		oph_iostore_destroy_frag_recordset(&record_set);
+
+	oph_metadb_frag_row *frag_row = NULL;
+	if (oph_metadb_setup_frag_struct(frag->frag_name, db->dev_handle->device, db->dev_handle->is_persistent, &(db->db_row->db_id), frag_id, frag->frag_size, &frag_row)) {
+		pthread_mutex_unlock(&(status->mutex));
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "frag");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "frag");
+		free(frag_id->id);
+		free(frag_id);
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	free(frag_id->id);
+	free(frag_id);
+
+	if (oph_metadb_add_frag(db->db_row, frag_row)) {
+		pthread_mutex_unlock(&(status->mutex));
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "frag add");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "frag add");
+		oph_metadb_cleanup_frag_struct(frag_row);
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	oph_metadb_cleanup_frag_struct(frag_row);
+	db->restored++;
+
+	pthread_mutex_unlock(&(status->mutex));
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+static void *_oph_io_server_snapshot_restore_worker(void *arg)
+{
+	_oph_io_server_snapshot_status *status = (_oph_io_server_snapshot_status *) arg;
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned long long index = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&(status->mutex));
+		index = status->next_frag++;
+		pthread_mutex_unlock(&(status->mutex));
+		if (index >= status->frag_num)
+			break;
+
+		if (_oph_io_server_snapshot_restore_frag(status, index, page_size)) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_RESTORE_ERROR, status->frag[index].frag_name);
+			logging(LOG_WARNING, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_RESTORE_ERROR, status->frag[index].frag_name);
+			pthread_mutex_lock(&(status->mutex));
+			status->error = 1;
+			pthread_mutex_unlock(&(status->mutex));
+		}
+	}
+
+	return NULL;
+}
+
+//Read and check the description of DBs and fragments
+static int _oph_io_server_snapshot_parse(const char *meta, oph_io_server_snapshot_header * header, _oph_io_server_snapshot_db * db, _oph_io_server_snapshot_frag * frag)
+{
+	unsigned long long pos = 0, i = 0;
+	unsigned long long images_start = sizeof(oph_io_server_snapshot_header) + header->meta_size;
+	int res = OPH_IO_SERVER_SUCCESS;
+
+	for (i = 0; i < header->db_num; i++) {
+		if ((res = _oph_io_server_snapshot_read_string(meta, header->meta_size, &pos, &(db[i].db_name))))
+			return res;
+		if ((res = _oph_io_server_snapshot_read_string(meta, header->meta_size, &pos, &(db[i].device))))
+			return res;
+		if ((res = _oph_io_server_snapshot_read_value(meta, header->meta_size, &pos, &(db[i].frag_number))))
+			return res;
+	}
+	for (i = 0; i < header->frag_num; i++) {
+		if ((res = _oph_io_server_snapshot_read_value(meta, header->meta_size, &pos, &(frag[i].db_index))))
+			return res;
+		if ((res = _oph_io_server_snapshot_read_string(meta, header->meta_size, &pos, &(frag[i].frag_name))))
+			return res;
+		if (_oph_io_server_snapshot_read_value(meta, header->meta_size, &pos, &(frag[i].frag_size))
+		    || _oph_io_server_snapshot_read_value(meta, header->meta_size, &pos, &(frag[i].image_offset))
+		    || _oph_io_server_snapshot_read_value(meta, header->meta_size, &pos, &(frag[i].image_size)))
+			return OPH_IO_SERVER_ERROR;
+		if (frag[i].db_index >= header->db_num || frag[i].image_offset % OPH_IO_SERVER_SNAPSHOT_ALIGN || frag[i].image_offset < images_start || frag[i].image_size > header->file_size
+		    || frag[i].image_offset > header->file_size - frag[i].image_size)
+			return OPH_IO_SERVER_ERROR;
+	}
+
+	return pos == header->meta_size ? OPH_IO_SERVER_SUCCESS : OPH_IO_SERVER_ERROR;
+}
+
+//Find (or create) the DBs the fragments are restored into
+static int _oph_io_server_snapshot_restore_db(oph_metadb_db_row ** meta_db, _oph_io_server_snapshot_db * db)
+{
+	if (*meta_db && oph_metadb_find_db(*meta_db, db->db_name, db->dev_handle->device, &(db->db_row))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB find");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB find");
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	if (db->db_row)
+		return OPH_IO_SERVER_SUCCESS;
+
+	oph_iostore_db_record_set db_record;
+	db_record.db_name = db->db_name;
+
+	oph_iostore_resource_id *db_id = NULL;
+	if (oph_iostore_put_db(db->dev_handle, &db_record, &db_id) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "put_db");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "put_db");
+		return OPH_IO_SERVER_API_ERROR;
+	}
+
+	oph_metadb_db_row *db_row = NULL;
+	if (oph_metadb_setup_db_struct(db->db_name, db->dev_handle->device, db->dev_handle->is_persistent, db_id, 0, &db_row)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "DB");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "DB");
+		free(db_id->id);
+		free(db_id);
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	free(db_id->id);
+	free(db_id);
+
+	if (oph_metadb_add_db(meta_db, db_row)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB add");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB add");
+		oph_metadb_cleanup_db_struct(db_row);
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	oph_metadb_cleanup_db_struct(db_row);
+
+	if (oph_metadb_find_db(*meta_db, db->db_name, db->dev_handle->device, &(db->db_row)) || db->db_row == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB find");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB find");
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+//Account the fragments restored into a DB
+static int _oph_io_server_snapshot_update_db(oph_metadb_db_row ** meta_db, _oph_io_server_snapshot_db * db)
+{
+	oph_metadb_db_row *tmp_db_row = NULL;
+	if (oph_metadb_setup_db_struct(db->db_row->db_name, db->db_row->device, db->db_row->is_persistent, &(db->db_row->db_id), db->db_row->frag_number + db->restored, &tmp_db_row)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "db");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "db");
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	if (oph_metadb_update_db(*meta_db, tmp_db_row)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "db update");
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "db update");
+		oph_metadb_cleanup_db_struct(tmp_db_row);
+		return OPH_IO_SERVER_METADB_ERROR;
+	}
+	oph_metadb_cleanup_db_struct(tmp_db_row);
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int oph_io_server_load_snapshot(oph_metadb_db_row ** meta_db, const char *snapshot_file, unsigned short thread_num)
+{
+	if (!meta_db || !snapshot_file) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	int fd = open(snapshot_file, O_RDONLY);
+	if (fd < 0) {
+		//No snapshot to be restored
+		if (errno == ENOENT)
+			return OPH_IO_SERVER_SUCCESS;
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, snapshot_file);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_FILE_ERROR, errno, snapshot_file);
+		return OPH_IO_SERVER_ERROR;
+	}
+
+	struct stat file_stat;
+	oph_io_server_snapshot_header header;
+	if (fstat(fd, &file_stat) || pread(fd, &header, sizeof(oph_io_server_snapshot_header), 0) != sizeof(oph_io_server_snapshot_header)
+	    || memcmp(header.magic, OPH_IO_SERVER_SNAPSHOT_MAGIC, OPH_IO_SERVER_SNAPSHOT_MAGIC_LEN) || header.file_size != (unsigned long long) file_stat.st_size
+	    || header.meta_size > header.file_size - sizeof(oph_io_server_snapshot_header) || header.db_num > header.meta_size / (3 * sizeof(unsigned long long))
+	    || header.frag_num > header.meta_size / (5 * sizeof(unsigned long long))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_CORRUPTED, snapshot_file);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_CORRUPTED, snapshot_file);
+		close(fd);
+		return OPH_IO_SERVER_ERROR;
+	}
+
+	char *meta = (char *) malloc(header.meta_size ? header.meta_size : 1);
+	_oph_io_server_snapshot_db *db = (_oph_io_server_snapshot_db *) calloc(header.db_num ? header.db_num : 1, sizeof(_oph_io_server_snapshot_db));
+	_oph_io_server_snapshot_frag *frag = (_oph_io_server_snapshot_frag *) calloc(header.frag_num ? header.frag_num : 1, sizeof(_oph_io_server_snapshot_frag));
+	if (meta == NULL || db == NULL || frag == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		free(meta);
+		free(db);
+		free(frag);
+		close(fd);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+
+	if (pread(fd, meta, header.meta_size, sizeof(oph_io_server_snapshot_header)) != (ssize_t) header.meta_size || _oph_io_server_snapshot_parse(meta, &header, db, frag)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_CORRUPTED, snapshot_file);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_SNAPSHOT_CORRUPTED, snapshot_file);
+		free(meta);
+		_oph_io_server_snapshot_free(db, header.db_num, frag, header.frag_num);
+		close(fd);
+		return OPH_IO_SERVER_ERROR;
+	}
+	free(meta);
+
+	int res = OPH_IO_SERVER_SUCCESS;
+	unsigned long long i = 0;
+
+	if (_oph_io_server_snapshot_setup_devices(db, header.db_num))
+		res = OPH_IO_SERVER_API_ERROR;
+	for (i = 0; i < header.db_num; i++)
+		if (db[i].dev_handle && _oph_io_server_snapshot_restore_db(meta_db, &(db[i])))
+			res = OPH_IO_SERVER_METADB_ERROR;
+
+	//Fragments are mapped and published by a pool of threads
+	_oph_io_server_snapshot_status status;
+	status.fd = fd;
+	status.snapshot_file = snapshot_file;
+	status.db = db;
+	status.frag = frag;
+	status.frag_num = header.frag_num;
+	status.next_frag = 0;
+	status.error = 0;
+	pthread_mutex_init(&(status.mutex), NULL);
+
+	unsigned long long worker_num = thread_num < header.frag_num ? thread_num : header.frag_num;
+	pthread_t *workers = NULL;
+	if (worker_num > 1)
+		workers = (pthread_t *) malloc((worker_num - 1) * sizeof(pthread_t));
+	unsigned long long started = 0;
+	if (workers) {
+		for (started = 0; started < worker_num - 1; started++)
+			if (pthread_create(&(workers[started]), NULL, &_oph_io_server_snapshot_restore_worker, &status))
+				break;
+	}
+	_oph_io_server_snapshot_restore_worker(&status);
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+	pthread_mutex_destroy(&(status.mutex));
+	close(fd);
+
+	if (status.error)
+		res = OPH_IO_SERVER_ERROR;
+
+	unsigned long long restored = 0;
+	for (i = 0; i < header.db_num; i++) {
+		if (db[i].db_row && db[i].restored) {
+			restored += db[i].restored;
+			if (_oph_io_server_snapshot_update_db(meta_db, &(db[i])))
+				res = OPH_IO_SERVER_METADB_ERROR;
+		}
+	}
+
+	pmesg(LOG_INFO, __FILE__, __LINE__, "Restored %llu of %llu fragments from %s\n", restored, header.frag_num, snapshot_file);
+	logging(LOG_INFO, __FILE__, __LINE__, "Restored %llu of %llu fragments from %s\n", restored, header.frag_num, snapshot_file);
+
+	_oph_io_server_snapshot_free(db, header.db_num, frag, header.frag_num);
+
+	return res;
+}
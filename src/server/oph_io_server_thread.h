@@ -23,6 +23,9 @@
 
 #include "oph_iostorage_interface.h"
 #include <pthread.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/socket.h>
 
 //Packet codes
 
@@ -32,9 +35,13 @@
 
 #define OPH_IO_SERVER_MSG_PING "PG"
 #define OPH_IO_SERVER_MSG_RESULT "RS"
+#define OPH_IO_SERVER_MSG_RESULT_FRAMES "RF"
 #define OPH_IO_SERVER_MSG_USE_DB "UD"
 #define OPH_IO_SERVER_MSG_SET_QUERY "SQ"
 #define OPH_IO_SERVER_MSG_EXEC_QUERY "EQ"
+#define OPH_IO_SERVER_MSG_PROTOCOL "PO"
+#define OPH_IO_SERVER_MSG_TAG "TG"
+#define OPH_IO_SERVER_MSG_BULK_INSERT "BI"
 
 #define OPH_IO_SERVER_MSG_ARG_DATA_LONG "DL"
 #define OPH_IO_SERVER_MSG_ARG_DATA_DOUBLE "DD"
@@ -44,10 +51,48 @@
 
 #define OPH_IO_SERVER_REQ_ERROR   "ER"
 
+//Protocol options negotiated per connection
+#define OPH_IO_SERVER_PROTOCOL_BINARY_NUMERIC 0x1
+#define OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY 0x2
+#define OPH_IO_SERVER_PROTOCOL_RESULT_FRAMES 0x4
+#define OPH_IO_SERVER_PROTOCOL_SUPPORTED (OPH_IO_SERVER_PROTOCOL_BINARY_NUMERIC | OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY | OPH_IO_SERVER_PROTOCOL_RESULT_FRAMES)
+
+//Field type codes sent with binary numeric result sets
+#define OPH_IO_SERVER_FIELD_LONG 'L'
+#define OPH_IO_SERVER_FIELD_REAL 'R'
+#define OPH_IO_SERVER_FIELD_STRING 'S'
+
+//Result frames: cells of at least OPH_IO_SERVER_DIRECT_CELL_LEN bytes are sent from fragment memory
+//and zero-copy is used for frames referencing at least OPH_IO_SERVER_ZEROCOPY_LEN bytes
+#define OPH_IO_SERVER_FRAME_IOV 64
+#define OPH_IO_SERVER_DIRECT_CELL_LEN 4096
+#define OPH_IO_SERVER_ZEROCOPY_LEN 65536
+
+//Shared-memory ring: the first OPH_IO_SERVER_RING_HEADER_LEN bytes hold the position consumed by the client and frames
+//take at most 1/OPH_IO_SERVER_RING_SLOTS of the ring; when the ring is full the server spins, then sleeps OPH_IO_SERVER_RING_PAUSE ns
+//until the client frees some space or OPH_IO_SERVER_RING_TIMEOUT seconds have elapsed
+#define OPH_IO_SERVER_RING_HEADER_LEN 64
+#define OPH_IO_SERVER_RING_SLOTS 4
+#define OPH_IO_SERVER_RING_SPINS 1024
+#define OPH_IO_SERVER_RING_PAUSE 100000
+#define OPH_IO_SERVER_RING_TIMEOUT 30
+
 // enum and struct
 #define OPH_IO_SERVER_MAX_LONG_LEN 24
 #define OPH_IO_SERVER_MAX_DOUBLE_LEN 32
 
+//Connection handling
+#define OPH_IO_SERVER_DEFAULT_WORKERS 32
+#define OPH_IO_SERVER_EPOLL_EVENTS 64
+#define OPH_IO_SERVER_SWEEP_PERIOD 1
+#define OPH_IO_SERVER_PIPELINE_BATCH 16
+#define OPH_IO_SERVER_DEFAULT_MAX_BULK_LEN 1024
+#ifdef MSG_MORE
+#define OPH_IO_SERVER_SEND_MORE MSG_MORE
+#else
+#define OPH_IO_SERVER_SEND_MORE 0
+#endif
+
 /**
  * \brief			            Structure to contain info about a running statement (query executed in multiple runs)
  * \param tot_run         Total number of times the query should be executed
@@ -67,6 +112,20 @@ typedef struct {
 	unsigned long long mi_prev_rows;
 } oph_io_server_running_stmt;
 
+/**
+ * \brief               Structure describing the SysV shared memory ring used to send result frames to a local client
+ * \param shm_id        Id of the shared memory segment
+ * \param addr          Address of the segment in the server
+ * \param size          Size of the data area of the ring (it follows the header)
+ * \param head          Position of the next frame, as total number of bytes written in the ring
+ */
+typedef struct {
+	int shm_id;
+	char *addr;
+	unsigned long long size;
+	unsigned long long head;
+} oph_io_server_ring;
+
 /**
  * \brief			            Structure to store thread status info
  * \param current_db 	    Pointer to current (default) database, if defined
@@ -74,6 +133,8 @@ typedef struct {
  * \param delete_only_rs	Flag set to 1 if only record set structure should be deleted
  * \param device        	Device selected for operations
  * \param curr_stmt       Current statement being executed, if any
+ * \param protocol        Protocol options enabled on the connection
+ * \param ring            Shared memory ring of the connection, if OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY is enabled
  */
 typedef struct {
 	//oph_metadb_db_row *current_db; 
@@ -82,6 +143,8 @@ typedef struct {
 	char delete_only_rs;
 	char *device;
 	oph_io_server_running_stmt *curr_stmt;
+	unsigned int protocol;
+	oph_io_server_ring *ring;
 } oph_io_server_thread_status;
 
 /**
@@ -92,11 +155,76 @@ typedef struct {
 int oph_io_server_free_status(oph_io_server_thread_status * status);
 
 /**
- * \brief               Thread function used by IO server
- * \param sockfd        Socket descriptor related to thread
- * \param tid        Thread ID
+ * \brief               Function used to send a result set in frames: the header TYPE|NUM_ROWS|NUM_FIELDS is followed by frames
+ *                      FRAME_LEN|DATA of at most size bytes, where DATA is a slice of the sequence of cells FIELD_LEN|FIELD; an empty frame ends the result set.
+ *                      With OPH_IO_SERVER_PROTOCOL_BINARY_NUMERIC the header also carries a type code for each field and numeric cells are 8-byte little-endian values.
+ *                      With OPH_IO_SERVER_PROTOCOL_SHARED_MEMORY frames are written in the ring and the socket only carries FRAME_LEN|RING_POS for each frame
+ * \param sockfd        Socket descriptor of the connection
+ * \param record_set    Result set to be sent
+ * \param buffer        Buffer used to build the frames
+ * \param size          Size of the buffer (it bounds the size of frames)
+ * \param protocol      Protocol options enabled on the connection
+ * \param ring          Shared memory ring of the connection (it can be NULL)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_send_result_frames(int sockfd, oph_iostore_frag_record_set * record_set, char *buffer, unsigned long long size, unsigned int protocol, oph_io_server_ring * ring);
+
+/**
+ * \brief               Function used to receive the columns of a bulk insert TYPE|NUM_ROWS|NUM_FIELDS|FINAL|FRAG_LEN|FRAG|COLUMN_1|...|COLUMN_N.
+ *                      Each column is FIELD_TYPE|DATA_LEN|CELL_LENGTHS|DATA: LONG and REAL columns have no CELL_LENGTHS and DATA holds NUM_ROWS 8-byte values,
+ *                      STRING columns have NUM_ROWS cell lengths followed by the concatenated cells. Data are read straight into fragment memory.
+ *                      Batches whose cell lengths and data exceed max_bulk_length bytes are rejected before allocating their columns.
+ * \param sockfd        Socket descriptor of the connection
+ * \param record_set    Record set the columns will be appended to (it provides types and NUMA node)
+ * \param row_num       Number of rows in the batch
+ * \param column        Array of field_num columns to be filled (on error, columns already received are released)
  * \return              0 if successfull, non-0 otherwise
  */
-void oph_io_server_thread(int sockfd, pthread_t tid);
+int oph_io_server_recv_bulk_columns(int sockfd, oph_iostore_frag_record_set * record_set, unsigned long long row_num, oph_iostore_frag_column * column);
+
+/**
+ * \brief               Structure describing a client connection multiplexed by the reactor
+ * \param sockfd        Socket descriptor of the connection
+ * \param events        Events reported by epoll when the connection has been dispatched
+ * \param busy          Flag set while a worker is serving a request of the connection
+ * \param is_local      Flag set for connections accepted on the Unix domain socket
+ * \param last_activity Time of the end of the last request (used to close idle connections after CLIENT_TTL seconds)
+ * \param status        Status of the connection (current DB, last result set, running statement)
+ * \param prev          Previous connection in the list of open connections
+ * \param next          Next connection in the list of open connections
+ * \param next_ready    Next connection waiting for a worker
+ */
+typedef struct _oph_io_server_connection {
+	int sockfd;
+	uint32_t events;
+	char busy;
+	char is_local;
+	time_t last_activity;
+	oph_io_server_thread_status status;
+	struct _oph_io_server_connection *prev;
+	struct _oph_io_server_connection *next;
+	struct _oph_io_server_connection *next_ready;
+} oph_io_server_connection;
+
+/**
+ * \brief               Function used by workers to read a complete request from a connection, execute it and send the answer
+ * \param conn          Connection with a pending request
+ * \param line          Buffer of max_packet_length bytes owned by the worker
+ * \param result        Buffer of max_packet_length bytes owned by the worker
+ * \return              0 if the connection can be kept open, non-0 otherwise
+ */
+int oph_io_server_serve_request(oph_io_server_connection * conn, char *line, char *result);
+
+/**
+ * \brief               Function used by IO server to accept and multiplex client connections with epoll. Connections with a pending
+ *                      request are dispatched to a fixed pool of workers; idle connections are closed after CLIENT_TTL seconds.
+ * \param listenfd      Listening socket descriptor
+ * \param local_listenfd Listening Unix domain socket descriptor for clients on the same node (-1 if disabled)
+ * \param cliaddr       Buffer for client addresses
+ * \param addrlen       Size of client address buffer
+ * \param worker_num    Number of worker threads
+ * \return              It returns only in case of error (non-0)
+ */
+int oph_io_server_reactor(int listenfd, int local_listenfd, struct sockaddr *cliaddr, socklen_t addrlen, unsigned short worker_num);
 
 #endif				/* OPH_IO_SERVER_THREAD_H */